@@ -0,0 +1,18 @@
+#ifndef ATOMIC_FILE_H
+#define ATOMIC_FILE_H
+
+#include <string>
+
+namespace expense_tracker {
+
+// Moves the finished temporary file `from` over `to`, so that readers and
+// crash recovery see either the old file or the complete new one: `from` is
+// fsynced, renamed, and the directory holding `to` is fsynced so that the
+// rename itself is on disk. Every writer that replaces a file in place (CSV,
+// segment, snapshot, partition manifest) finishes through here. Returns false,
+// leaving `from` in place, if any step fails.
+bool replaceFile(const std::string& from, const std::string& to);
+
+} // namespace expense_tracker
+
+#endif // ATOMIC_FILE_H
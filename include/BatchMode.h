@@ -0,0 +1,42 @@
+#ifndef BATCH_MODE_H
+#define BATCH_MODE_H
+
+namespace expense_tracker {
+
+// Non-interactive entry point of expense_tracker, used when the program is
+// started with arguments (e.g. from cron):
+//
+//   expense_tracker [--format csv|json] [--output FILE] [--script FILE]
+//                   [--threads N] [--stats] [--partitioned] [--text-index]
+//                   [--journal] [--serve SOCKET] [COMMAND ...]
+//   expense_tracker --connect SOCKET [--format csv|json] [--output FILE]
+//                   [--script FILE] [COMMAND ...]
+//
+// Each COMMAND argument is one command line such as "sum-by-month 2024";
+// a script holds one command per line (lines starting with '#' are
+// comments; "-" reads stdin). Script commands run first, then the ones given
+// as arguments, all against one ExpenseManager. File names are relative to
+// data/, as in the interactive menu. The options and commands (load, reload,
+// import, export, add, delete, range, total, sum-by-month, sum-by-category,
+// query, aggregate, explain, group-by, stats) are described by printUsage in
+// BatchMode.cpp, which `expense_tracker --help` prints.
+//
+// Every query writes one result set: in CSV a header line followed by rows
+// (result sets separated by a blank line), in JSON one object per line
+// ({"command": ..., "rows": [...]}). All output goes through a single large
+// buffer, flushed in 1 MiB writes. Diagnostics go to stderr; the first
+// failing command stops the run.
+//
+// With --serve the commands prepare the ledger (e.g. "load FILE"); the
+// process then stays up as a daemon answering commands on a Unix socket (see
+// QueryDaemon.h) against that same resident ledger. --connect is its client:
+// it sends its commands there instead of running them, with the same output
+// as a batch run, and costs a round trip per command rather than a load.
+//
+// Returns the process exit code: 0 on success, 1 if a command failed, 2 for
+// a usage error.
+int runBatch(int argc, char** argv);
+
+} // namespace expense_tracker
+
+#endif // BATCH_MODE_H
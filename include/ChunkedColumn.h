@@ -0,0 +1,171 @@
+#ifndef CHUNKED_COLUMN_H
+#define CHUNKED_COLUMN_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace expense_tracker {
+
+// A growable column of trivially copyable values stored in fixed-size chunks.
+// Unlike std::vector, growing the column never reallocates or copies existing
+// elements, so a multi-GB column has no 2x peak during growth and no capacity
+// slack beyond the last chunk. Element i lives in chunk (i >> kChunkShift).
+//
+// Chunks may also be borrowed from read-only memory (a mapped snapshot). A
+// borrowed chunk is copied into an owned one before its first write.
+//
+// Copying a column copies only the chunk pointers: the copy shares every chunk
+// with the original, and whichever side later overwrites an element of a
+// shared chunk copies that chunk first. Appends write past the end of both
+// copies and so never disturb the other one. This is what makes read
+// snapshots of a store cheap (see ExpenseManager::readSnapshot): one writer
+// may keep mutating its column while other threads read a copy.
+//
+// Sharing is tracked per chunk by the copy itself, which marks every chunk
+// shared on both sides, rather than by reading shared_ptr reference counts
+// (a reader dropping its copy would make that a data race). A chunk stays
+// marked until its first write copies it, even if the other side is gone by
+// then. Copying therefore writes to the source's marks: like any mutation of
+// the source, it must not run concurrently with another copy or write of it.
+template <typename T>
+class ChunkedColumn {
+public:
+    static constexpr size_t kChunkShift = 16;
+    static constexpr size_t kChunkSize = size_t{1} << kChunkShift; // 65536 rows per chunk
+    static constexpr size_t kChunkMask = kChunkSize - 1;
+
+    ChunkedColumn() = default;
+    ChunkedColumn(const ChunkedColumn& other) : chunks_(other.chunks_), state_(other.state_), size_(other.size_) {
+        other.markShared();
+        markShared();
+    }
+    ChunkedColumn& operator=(const ChunkedColumn& other) {
+        if (this != &other) {
+            chunks_ = other.chunks_;
+            state_ = other.state_;
+            size_ = other.size_;
+            other.markShared();
+            markShared();
+        }
+        return *this;
+    }
+    ChunkedColumn(ChunkedColumn&&) = default;
+    ChunkedColumn& operator=(ChunkedColumn&&) = default;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const T& operator[](size_t i) const {
+        return chunks_[i >> kChunkShift][i & kChunkMask];
+    }
+
+    void set(size_t i, const T& value) {
+        writableChunk(i >> kChunkShift)[i & kChunkMask] = value;
+    }
+
+    void push_back(const T& value) {
+        if ((size_ & kChunkMask) == 0 && (size_ >> kChunkShift) == chunks_.size()) {
+            chunks_.emplace_back(new T[kChunkSize]);
+            state_.push_back(kOwned);
+        }
+        const size_t chunk = size_ >> kChunkShift;
+        // The slot lies past the end of every copy sharing this chunk (pop_back
+        // unshares the tail before shrinking), so only borrowed chunks need copying.
+        T* data = state_[chunk] == kBorrowed ? writableChunk(chunk) : chunks_[chunk].get();
+        data[size_ & kChunkMask] = value;
+        ++size_;
+    }
+
+    void pop_back() {
+        --size_;
+        // Release the tail chunk once it is empty so clear()/erase shrink memory too.
+        if ((size_ & kChunkMask) == 0 && (size_ >> kChunkShift) + 1 == chunks_.size()) {
+            chunks_.pop_back();
+            state_.pop_back();
+        } else if (state_[size_ >> kChunkShift] == kShared) {
+            // A later push_back would overwrite the popped slot, which a copy
+            // sharing this chunk may still read.
+            writableChunk(size_ >> kChunkShift);
+        }
+    }
+
+    // Removes element i, shifting later elements down by one (O(n - i)).
+    void erase(size_t i) {
+        size_t chunk = i >> kChunkShift;
+        size_t offset = i & kChunkMask;
+        const size_t lastChunk = (size_ - 1) >> kChunkShift;
+        for (; chunk <= lastChunk; ++chunk, offset = 0) {
+            T* data = writableChunk(chunk);
+            const size_t end = (chunk == lastChunk) ? ((size_ - 1) & kChunkMask) + 1 : kChunkSize;
+            std::copy(data + offset + 1, data + end, data + offset);
+            if (chunk != lastChunk) {
+                data[kChunkSize - 1] = chunks_[chunk + 1][0];
+            }
+        }
+        pop_back();
+    }
+
+    void clear() {
+        chunks_.clear();
+        state_.clear();
+        size_ = 0;
+    }
+
+    // Replaces the contents with `count` elements read in place from `data`,
+    // which `owner` keeps alive (typically a memory mapping).
+    void borrow(const T* data, size_t count, const std::shared_ptr<const void>& owner) {
+        clear();
+        for (size_t offset = 0; offset < count; offset += kChunkSize) {
+            // Aliasing constructor: the chunk shares ownership of the mapping.
+            chunks_.emplace_back(owner, const_cast<T*>(data + offset));
+            state_.push_back(kBorrowed);
+        }
+        size_ = count;
+    }
+
+    // Raw chunk access for tight per-chunk loops (scans, serialization).
+    size_t chunkCount() const { return chunks_.size(); }
+    const T* chunkData(size_t chunk) const { return chunks_[chunk].get(); }
+    size_t chunkLength(size_t chunk) const {
+        return std::min(kChunkSize, size_ - (chunk << kChunkShift));
+    }
+
+    // Heap bytes owned by the column; borrowed chunks are not counted.
+    size_t memoryUsage() const {
+        return static_cast<size_t>(chunks_.size() - std::count(state_.begin(), state_.end(), kBorrowed)) *
+               kChunkSize * sizeof(T);
+    }
+
+private:
+    enum ChunkState : uint8_t {
+        kOwned,    // Held by this column alone: written in place
+        kShared,   // Heap chunk possibly held by a copy: copied before a write
+        kBorrowed, // Read-only memory of another owner: copied before a write
+    };
+
+    void markShared() const {
+        std::replace(state_.begin(), state_.end(), kOwned, kShared);
+    }
+
+    T* writableChunk(size_t chunk) {
+        if (state_[chunk] != kOwned) {
+            std::shared_ptr<T[]> copy(new T[kChunkSize]);
+            const T* source = chunks_[chunk].get();
+            std::copy(source, source + chunkLength(chunk), copy.get());
+            chunks_[chunk] = std::move(copy);
+            state_[chunk] = kOwned;
+        }
+        return chunks_[chunk].get();
+    }
+
+    std::vector<std::shared_ptr<T[]>> chunks_;
+    mutable std::vector<ChunkState> state_; // Per chunk; copies mark the source's chunks shared too
+    size_t size_ = 0;
+};
+
+} // namespace expense_tracker
+
+#endif // CHUNKED_COLUMN_H
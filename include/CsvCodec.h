@@ -0,0 +1,100 @@
+#ifndef CSV_CODEC_H
+#define CSV_CODEC_H
+
+#include "Expense.h"
+#include "ExpenseStore.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace expense_tracker {
+
+// Field codecs for the CSV load/save hot path. Parsers work on string_views
+// and never allocate or throw; writers append to a caller-owned buffer, so a
+// whole file can be serialized through one reused std::string.
+
+// True for a real proleptic Gregorian date (month 1-12, day within the month,
+// leap years included).
+bool isValidCalendarDate(int year, int month, int day);
+
+// Years the ledger can hold: the CSV, journal and partition file names all
+// write a date as "YYYY-MM-DD" with exactly four year digits.
+constexpr int kMinLedgerYear = 0;
+constexpr int kMaxLedgerYear = 9999;
+// True for the undated Date{} or a valid calendar date within those years.
+bool isStorableDate(const Date& date);
+
+// Query bounds for a date that may not exist. They keep the field-by-field
+// (Y,M,D) ordering: a range from 2024-02-30 starts on 2024-03-01, a range to
+// 2024-02-30 ends on 2024-02-29, so an impossible single day is the empty
+// range [first, last] with first > last. Valid dates and the undated Date{}
+// pack as toDayNumber does.
+int32_t firstDayOnOrAfter(const Date& date);
+int32_t lastDayOnOrBefore(const Date& date);
+
+// Parses exactly "YYYY-MM-DD". Returns false, leaving `date` untouched, for any
+// other shape or for a date that does not exist (e.g. 2023-02-29).
+bool parseIsoDate(std::string_view text, Date& date);
+
+// Parses a decimal amount (optional sign, fraction and exponent). The whole
+// view must be consumed; "nan", "inf" and out-of-range values are rejected.
+bool parseAmount(std::string_view text, double& amount);
+
+// Non-negative decimal expense id up to kMaxExpenseId; the whole view must be
+// consumed. Larger ids are rejected, so loaders treat them as missing.
+bool parseExpenseId(std::string_view text, ExpenseId& id);
+
+// "Cash" / "Credit", as written by appendCsvRow.
+bool parseTransactionType(std::string_view text, TransactionType& type);
+const char* transactionTypeName(TransactionType type);
+
+// Writers. appendIsoDate writes "0-00-00" for an undated Date{}, which the
+// loader reads back as undated.
+void appendIsoDate(std::string& out, const Date& date);
+// Shortest representation that reads back to the same double.
+void appendAmount(std::string& out, double amount);
+// Surrounds the field with quotes and doubles any quote inside it. Line breaks
+// are written as they are, so text stored in a ledger goes through
+// singleLineText first (see ExpenseManager::addExpense).
+void appendQuoted(std::string& out, std::string_view field);
+
+// `text` with every CR and LF replaced by a space, built in `scratch` only if
+// there is one to replace. io::CSVReader, the sequential loader, splits
+// records at line ends even inside quotes, so a stored line break would load
+// differently from the record-aware parallel and tail loaders.
+std::string_view singleLineText(std::string_view text, std::string& scratch);
+
+// Appends one data line in the layout of the file header
+// Date,Description,Amount,Category,Type,Id, including the trailing newline.
+void appendCsvRow(std::string& out, const ExpenseRow& row);
+
+// Record-level parsing for loaders that read the file bytes themselves (the
+// parallel and tail loaders), mirroring the io::CSVReader configuration of
+// ExpenseManager::scanCsvFile.
+//
+// Splits one record starting at `p` into raw (still quoted, untrimmed)
+// fields. Returns the position just past the record's newline, or `end` if
+// it has none; `newlines` receives the number of physical lines it spans.
+const char* splitCsvRecord(const char* p, const char* end, std::vector<std::string_view>& fields,
+                           size_t& newlines);
+// Trims spaces, then strips the surrounding quotes and collapses "" escapes.
+void decodeCsvField(std::string_view raw, std::string& out);
+
+// The ledger columns, in header order as written by saveExpenses.
+enum CsvColumn { kCsvDate, kCsvDescription, kCsvAmount, kCsvCategory, kCsvType, kCsvId, kCsvColumnCount };
+const char* csvColumnName(CsvColumn column);
+
+// Where a file's header puts each column. Id may be missing (files written
+// before expense ids existed); the others are required.
+struct CsvLayout {
+    static constexpr size_t kMissing = static_cast<size_t>(-1);
+    size_t column_of[kCsvColumnCount];
+    size_t min_fields = 0; // Fields a data record needs to reach every present column
+};
+// Maps the raw fields of a header record. Returns false, with the first
+// missing required column in `missing`, if the header is incomplete.
+bool mapCsvHeader(const std::vector<std::string_view>& fields, CsvLayout& layout, CsvColumn& missing);
+
+} // namespace expense_tracker
+
+#endif // CSV_CODEC_H
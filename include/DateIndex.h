@@ -0,0 +1,83 @@
+#ifndef DATE_INDEX_H
+#define DATE_INDEX_H
+
+#include "Expense.h"
+#include "ChunkedColumn.h"
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace expense_tracker {
+
+// Sorted permutation of store rows keyed on the packed date (day number).
+// Entries are ordered by (day, row), so rows sharing a date keep insertion order.
+// Any day/month/year/range query is a binary search for the first and last
+// matching position followed by a walk over rows().
+//
+// Appends in date order (the common case for ledgers and imports) extend the
+// sorted arrays directly. Out-of-order inserts are buffered and merged in one
+// pass on the next lookup, so bulk back-dated inserts cost O(n + p log p)
+// instead of O(n) each.
+//
+// Deletes are not applied, as in TextIndex: a tombstoned row keeps its entry
+// until ExpenseStore::compact drops the row (see renumber), so the index holds
+// an entry for every store row and a delete never touches it. Callers walking
+// a range skip entries whose row carries ExpenseStore::kTombstoneDay. Dead
+// entries are reclaimed with the store's own compaction, once deleted rows
+// outnumber live ones (ExpenseManager::compactIfSparse).
+//
+// The sorted arrays are chunked columns, so copying a flushed index shares
+// them copy-on-write: merges and renumbering build fresh columns and appends
+// write past the end of any copy, leaving copies untouched.
+class DateIndex {
+public:
+    void insert(RowId row, int32_t day);
+    // Renumbers every row r to newRows[r] after ExpenseStore::compact and drops
+    // the entries of rows it removed (ExpenseStore::kDroppedRow). The mapping
+    // must preserve row order.
+    void renumber(const std::vector<RowId>& newRows);
+    void rebuild(const ChunkedColumn<int32_t>& days);
+    void clear();
+    // Serves lookups straight from sorted arrays in a mapped snapshot; the first
+    // mutation copies them into owned memory. The borrowed rows are checked
+    // against `count` by the first flush() rather than here, so opening stays
+    // O(1); if any is out of range the index is rebuilt from `days`, the
+    // snapshot's day column.
+    void borrow(const int32_t* keys, const RowId* rows, const int32_t* days, size_t count,
+                std::shared_ptr<const void> owner);
+
+    // Entries, those of deleted rows not yet compacted away included.
+    size_t size() const { return keys_.size() + pending_.size(); }
+
+    // Sorted positions [first, last) whose day lies in [firstDay, lastDay],
+    // including positions of deleted rows (see above).
+    std::pair<size_t, size_t> findRange(int32_t firstDay, int32_t lastDay) const;
+
+    // Rows and days in (day, row) order; valid after findRange() or flush()
+    // until the next mutation.
+    const ChunkedColumn<RowId>& rows() const { return rows_; }
+    const ChunkedColumn<int32_t>& keys() const { return keys_; }
+    size_t sortedSize() const { return keys_.size(); }
+
+    // True while inserts are buffered, i.e. the next lookup will modify the
+    // index.
+    bool hasPending() const { return !pending_.empty() || !unverified_days_.empty(); }
+    // Checks borrowed rows not yet checked and merges buffered out-of-order
+    // inserts into the sorted arrays.
+    void flush() const;
+
+private:
+    // Lookups apply pending inserts lazily, hence mutable.
+    mutable ChunkedColumn<int32_t> keys_;
+    mutable ChunkedColumn<RowId> rows_;
+    mutable std::vector<std::pair<int32_t, RowId>> pending_;
+    // Day column of a borrowed index whose rows flush() has not checked yet.
+    mutable ChunkedColumn<int32_t> unverified_days_;
+
+    void verifyBorrowed() const;
+};
+
+} // namespace expense_tracker
+
+#endif // DATE_INDEX_H
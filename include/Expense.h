@@ -2,6 +2,8 @@
 #define EXPENSE_H
 
 #include <string>
+#include <cstdint>
+#include <limits>
 #include <chrono> // For date handling, will integrate with the 'date' library later
 
 // Forward declaration for the date library type if needed, or include directly
@@ -22,12 +24,69 @@ struct Date {
     int day;
 
     // Basic constructor
-    Date(int y = 0, int m = 0, int d = 0) : year(y), month(m), day(d) {}
+    constexpr Date(int y = 0, int m = 0, int d = 0) : year(y), month(m), day(d) {}
 
     // Friend function for easy output, useful for debugging
     friend std::ostream& operator<<(std::ostream& os, const Date& date);
 };
 
+// Position of an expense within ExpenseStore (and the indexes built over it).
+using RowId = uint32_t;
+// Index into ExpenseStore's category dictionary.
+using CategoryId = uint32_t;
+// Stable identity of an expense. Unlike a RowId it survives deletes and
+// compaction of other rows and is saved with the ledger; ids are never reused
+// within a ledger's lifetime except that a reload may reissue ids above the
+// highest one saved.
+using ExpenseId = uint64_t;
+constexpr ExpenseId kNoExpenseId = std::numeric_limits<ExpenseId>::max();
+// Largest id accepted from a file. Leaves 2^63 ids of headroom, so ids issued
+// after it can never reach kNoExpenseId or wrap to 0.
+constexpr ExpenseId kMaxExpenseId = std::numeric_limits<ExpenseId>::max() / 2;
+
+// Packed date representation used by the storage layer: days since 1970-01-01
+// in the proleptic Gregorian calendar. Packed dates compare in calendar order,
+// so range filters become a pair of integer comparisons.
+// The all-zero Date{} ("no date", accepted by the CSV loader) maps to kNoDayNumber.
+constexpr int32_t kNoDayNumber = std::numeric_limits<int32_t>::min();
+
+// Same algorithm as date::days_from_civil (Howard Hinnant), kept inline because
+// it sits on the load and query hot paths. Out-of-range months/days are not
+// validated here; they normalize the same way the date library would (2024-02-30
+// packs as 2024-03-01), so callers storing a date check it with
+// isValidCalendarDate (CsvCodec.h) first.
+constexpr int32_t toDayNumber(int year, int month, int day) {
+    if (year == 0 && month == 0 && day == 0) {
+        return kNoDayNumber;
+    }
+    const int y = year - (month <= 2 ? 1 : 0);
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;                                            // [0, 399]
+    const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1; // [0, 365]
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;                    // [0, 146096]
+    return static_cast<int32_t>(era * 146097 + doe - 719468);
+}
+
+constexpr int32_t toDayNumber(const Date& date) {
+    return toDayNumber(date.year, date.month, date.day);
+}
+
+// Inverse of toDayNumber (date::civil_from_days).
+constexpr Date fromDayNumber(int32_t days) {
+    if (days == kNoDayNumber) {
+        return Date{};
+    }
+    const int z = days + 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const int doe = z - era * 146097;                                    // [0, 146096]
+    const int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // [0, 399]
+    const int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);             // [0, 365]
+    const int mp = (5 * doy + 2) / 153;                                  // [0, 11]
+    const int d = doy - (153 * mp + 2) / 5 + 1;                          // [1, 31]
+    const int m = mp < 10 ? mp + 3 : mp - 9;                             // [1, 12]
+    return Date(yoe + era * 400 + (m <= 2 ? 1 : 0), m, d);
+}
+
 struct Expense {
     std::string description;
     double amount;
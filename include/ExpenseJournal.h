@@ -0,0 +1,85 @@
+#ifndef EXPENSE_JOURNAL_H
+#define EXPENSE_JOURNAL_H
+
+#include "Expense.h"
+#include "Snapshot.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace expense_tracker {
+
+// Append-only write-ahead log of expense mutations, kept next to a base CSV.
+//
+// File layout: a fixed header naming the base file it applies to (by
+// SourceStamp), followed by records of [uint32 length][uint32 crc32][payload].
+// Each mutation is a single write(2), so a crash can only leave a torn record
+// at the tail; replay stops at the first record whose length or checksum does
+// not verify and truncates the file there.
+//
+// After compaction rewrites the base file, the journal is reset with the new
+// base stamp. If a crash happens between the two steps, the stale journal no
+// longer matches the base and is discarded instead of being applied twice.
+//
+// A background compaction writes the new base from a snapshot while records
+// keep arriving, so the records after the snapshot must survive the swap.
+// Before the new base is moved into place, prepareRebase records its stamp
+// and the offset of the first record it lacks in the header; a journal found
+// next to that base replays only the records from the offset on. rebase then
+// rewrites the journal as just those records.
+class ExpenseJournal {
+public:
+    // Records name expenses by ExpenseId, so replay does not depend on row
+    // positions (which compaction changes).
+    using AddHandler = std::function<void(ExpenseId id, std::string_view description, double amount,
+                                          int32_t dayNumber, std::string_view category, TransactionType type)>;
+    using DeleteHandler = std::function<void(ExpenseId id)>;
+
+    ExpenseJournal() = default;
+    ExpenseJournal(const ExpenseJournal&) = delete;
+    ExpenseJournal& operator=(const ExpenseJournal&) = delete;
+    ~ExpenseJournal();
+
+    // Opens or creates the journal at `path`. If it belongs to `base`, its
+    // records are replayed through the handlers; otherwise it is started afresh.
+    bool open(const std::string& path, const SourceStamp& base, const AddHandler& onAdd,
+              const DeleteHandler& onDelete);
+    void close();
+    bool isOpen() const { return fd_ >= 0; }
+
+    bool appendAdd(ExpenseId id, std::string_view description, double amount, int32_t dayNumber,
+                   std::string_view category, TransactionType type);
+    bool appendDelete(ExpenseId id);
+
+    // fsync()s everything appended so far.
+    bool sync();
+    // Drops all records and rebinds the journal to a freshly written base file.
+    bool reset(const SourceStamp& base);
+    // Offset just past the last record; a snapshot taken now holds the
+    // records before it.
+    uint64_t size() const { return size_; }
+    // Background compaction, around moving the new base `next` into place:
+    // prepareRebase notes in the header that `next` holds every record before
+    // `offset`, and rebase then keeps only the records from `offset` on,
+    // bound to `next`. Both fsync before returning.
+    bool prepareRebase(const SourceStamp& next, uint64_t offset);
+    bool rebase(const SourceStamp& next, uint64_t offset);
+
+    // Bytes of records currently in the journal (excluding the header).
+    uint64_t recordBytes() const { return size_ - headerSize(); }
+    const std::string& path() const { return path_; }
+
+private:
+    static uint64_t headerSize();
+    static bool writeHeader(int fd, const SourceStamp& base);
+    bool appendRecord(const std::string& payload);
+
+    int fd_ = -1;
+    std::string path_;
+    uint64_t size_ = 0;
+};
+
+} // namespace expense_tracker
+
+#endif // EXPENSE_JOURNAL_H
@@ -2,41 +2,498 @@
 #define EXPENSE_MANAGER_H
 
 #include "Expense.h"
+#include "ExpenseStore.h"
+#include "CsvCodec.h"
+#include "DateIndex.h"
+#include "ExpenseRollups.h"
+#include "ExpenseJournal.h"
+#include "ScanKernels.h"
+#include "OperationStats.h"
+#include "ExpenseQuery.h"
+#include "GroupBy.h"
+#include "PartitionCatalog.h"
+#include "ScanExecutor.h"
+#include "TextIndex.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <string>
-#include <functional> // For std::function in more advanced filtering later if needed
+#include <functional>
 
 namespace expense_tracker {
 
+struct SourceStamp;
+
+struct CategoryTotal {
+    std::string category;
+    ExpenseTotal total;
+};
+
 class ExpenseManager {
 public:
     ExpenseManager();
+    // Waits for background saves and stops autosave.
+    ~ExpenseManager();
 
     // Core operations
-    void addExpense(const Expense& expense);
-    bool deleteExpense(size_t index); // Returns true if successful, false if index out of bounds
-    const std::vector<Expense>& getAllExpenses() const;
+    // Every expense gets a stable ExpenseId (saved with the ledger). Deleting
+    // by id is O(1): the row is tombstoned and reclaimed by compact(), which
+    // also runs automatically once deleted rows outnumber live ones.
+    // addExpense returns kNoExpenseId, adding nothing, for a date that does not
+    // exist (e.g. 2024-02-30), a year outside 0..9999, or a NaN/infinite
+    // amount; the all-zero Date{} is kept as an undated row. Line breaks in the
+    // description or category are stored as spaces (see singleLineText).
+    ExpenseId addExpense(const Expense& expense);
+    // Deletes the expense at `index` in getAllExpenses() order. Returns false if index out of bounds.
+    bool deleteExpense(size_t index);
+    bool deleteExpenseById(ExpenseId id); // Returns false if no live expense has this id
+    bool findExpenseById(ExpenseId id, ExpenseRow& expense) const;
+    // Drops tombstoned rows from the store and renumbers the date index.
+    // Ids are unchanged; row positions and outstanding views are not.
+    void compact();
+    // Row view over the live expenses; invalidated by any mutation.
+    ExpenseView getAllExpenses() const;
 
     // Data persistence
+    // A filename ending in ".seg" is saved as a compressed segment (see
+    // ExpenseSegment.h) instead of a CSV; every load and import recognizes
+    // segments by their contents. A segment ledger loads back in the same
+    // getAllExpenses order as a CSV one.
+    // With the snapshot cache enabled (the default), saving a CSV also writes
+    // "<filename>.snap" next to the CSV, and loadExpenses maps that snapshot
+    // instead of parsing the CSV as long as the CSV has not changed since.
     bool loadExpenses(const std::string& filename);
+    // Files are replaced atomically (written to "<file>.tmp", then moved over
+    // the old one by replaceFile in AtomicFile.h, which fsyncs the file and
+    // its directory), so a crash never leaves a partial ledger.
+    // Runs in the background save queue (see saveExpensesAsync) and waits for
+    // it, so it lands after background saves started earlier and never
+    // overlaps one. Must not be called from a save's onComplete callback.
+    // A journaled ledger's own file is the exception: it only fsyncs the
+    // journal, so it does not wait for the queue (see setJournaling).
     bool saveExpenses(const std::string& filename) const;
 
+    // Background saves. saveExpensesAsync takes a read snapshot (cheap, see
+    // readSnapshot) and writes it on another thread, returning at once; the
+    // ledger can be changed meanwhile without affecting what is written.
+    // The future yields saveExpenses' result, and `onComplete`, if given,
+    // is called with it on the saving thread. Saves run one at a time in the
+    // order they were requested.
+    //
+    // A journaled ledger's own file and a partitioned ledger are saved
+    // synchronously instead: the first is only a journal fsync, and the
+    // second writes only changed months through state the writer owns.
+    using SaveCallback = std::function<void(bool saved)>;
+    std::shared_future<bool> saveExpensesAsync(const std::string& filename, SaveCallback onComplete = nullptr) const;
+    // Saves to `filename` in the background every `interval` while there are
+    // unsaved changes, as saveExpensesAsync would; a zero interval stops it.
+    // Ticks that find a journaled or partitioned ledger (see above) skip the
+    // save with a warning. Returns false if autosave could not start.
+    bool setAutosave(const std::string& filename, std::chrono::milliseconds interval);
+    // Incremental reload, for a CSV that another process appends rows to. If
+    // data/<filename> is the CSV last loaded (or reloaded) and is still the
+    // same file (device and inode), has not shrunk and still holds the bytes
+    // read last time, only the complete records appended since are parsed
+    // and added, so the cost follows the new rows rather than the file.
+    // Otherwise (first call, file truncated, replaced or rewritten in place)
+    // it falls back to loadExpenses(filename). A last record still missing
+    // its newline is left for the next reload. Segment files, journaled and
+    // partitioned ledgers always take the full path. While this manager is
+    // saving data/<filename> (e.g. autosave), a reload does nothing: the file
+    // is being replaced with rows the store already has. `rowsAdded` receives
+    // the rows appended, or the rows loaded after a full reload.
+    bool reloadExpenses(const std::string& filename, size_t* rowsAdded = nullptr);
+    // Reloads data/<filename> as above once now and then whenever the file is
+    // written, created or renamed into place (inotify on its directory),
+    // calling onReload(loaded, rowsAdded) after each reload. The reloads run
+    // on a watcher thread, so while watching, every thread, the owner's
+    // included, must read through readSnapshot() and treat the manager as
+    // having a concurrent writer. Returns false if the watch could not be set
+    // up. stopWatching() (also run by the destructor) ends it.
+    using ReloadCallback = std::function<void(bool loaded, size_t rowsAdded)>;
+    bool watchExpenses(const std::string& filename, ReloadCallback onReload = nullptr);
+    void stopWatching();
+    // Appends the rows of a CSV under data/ to the current ledger, journaled
+    // like addExpense, line breaks replaced the same way. Imported rows get
+    // fresh ids. Returns false if the file cannot be read; rows read before an
+    // error stay imported.
+    bool importExpenses(const std::string& filename);
+    void setSnapshotCache(bool enabled) { snapshot_cache_ = enabled; }
+    // CSV parsing threads for loadExpenses: 1 (default) uses the sequential
+    // io::CSVReader path, 0 uses every hardware thread, N uses N workers.
+    void setIngestThreads(unsigned threads) { ingest_threads_ = threads; }
+    // Worker threads for wide scans: query(), aggregate() and groupBy() plans
+    // with many candidates, aggregateDateRange and the getExpensesBy* copies
+    // of large ranges (see ScanExecutor.h). 1 (default) scans on the calling thread,
+    // 0 uses every hardware thread, N uses N. Small scans always stay on the
+    // calling thread. The pool is shared with read snapshots taken from now on.
+    void setScanThreads(unsigned threads);
+    unsigned scanThreads() const { return scan_executor_ ? static_cast<unsigned>(scan_executor_->workers()) : 1; }
+
+    // Journaled persistence (see ExpenseJournal.h). When enabled, loadExpenses
+    // replays "<filename>.journal" on top of the CSV and keeps it open; every
+    // add/delete appends one record, and saveExpenses of the same file only
+    // fsyncs the journal. Once the journal has grown large, that save also
+    // queues a compaction on the save worker (see saveExpensesAsync): it
+    // writes a read snapshot beside the CSV, then, under the writer lock,
+    // moves it into place and cuts the journal down to the records added
+    // since the snapshot. If a record cannot be appended the change is still
+    // made in memory, but the journal takes no further records and the next
+    // save compacts synchronously instead.
+    void setJournaling(bool enabled) { journaling_ = enabled; }
+    // Folds the journal into its base CSV (written atomically) and empties it,
+    // on the calling thread, after waiting for queued saves.
+    bool compactJournal() const;
+
+    // Partitioned storage (see PartitionCatalog.h). When enabled,
+    // loadExpenses(f) opens the ledger kept as one CSV per calendar month
+    // under "data/<f>.parts/" without reading any rows; each query loads the
+    // months its date range touches on first use (queries without a date
+    // range, getAllExpenses and deletes load them all). saveExpenses(f)
+    // rewrites only the months changed since they were loaded, so its cost
+    // follows the number of changed months rather than the ledger size.
+    // If there is no partition directory yet, the single CSV "data/<f>" is
+    // loaded whole and the first save splits it.
+    //
+    // With a budget of N partitions (0, the default, means unlimited), a load
+    // that leaves more than N resident drops the least recently used clean
+    // ones; they are read back when next touched. While partitioned, loading
+    // or dropping a partition counts as a mutation: it invalidates views and
+    // QueryResults like an addExpense would, even when done by a query.
+    // Journaling does not apply to partitioned ledgers, and store() sees only
+    // the resident partitions. So does a read snapshot: it cannot load months
+    // (readers share it), so its queries answer for the months resident when
+    // it was taken and warn if they needed others; call getAllExpenses() on
+    // the manager first to make a snapshot complete. Saving such a snapshot
+    // is refused; save the manager itself.
+    void setPartitionedStorage(bool enabled) { partitioned_ = enabled; }
+    void setPartitionBudget(size_t partitions) { partition_budget_ = partitions; }
+    size_t residentPartitions() const { return partitions_.residentCount(); }
+
+    // Description search index (see TextIndex.h). When enabled, query,
+    // aggregate and groupBy look up descriptionContains/descriptionStartsWith
+    // terms in trigram posting lists and filter only those rows by date,
+    // category and the rest, instead of scanning every description. It is
+    // kept up to date by every add, delete and load. Off by default: the
+    // index takes about four bytes per description byte.
+    void setTextIndex(bool enabled);
+    bool textIndexEnabled() const { return text_index_ != nullptr; }
+
+    // Explicit binary snapshots (see Snapshot.h), also under data/.
+    bool saveSnapshot(const std::string& filename) const;
+    bool loadSnapshot(const std::string& filename);
+
     // Summarization (declarations for now, implementation will follow)
     // These might return a new vector of expenses or directly print them
     // For now, let's assume they print and return void for simplicity in this step
     void viewExpensesSummary() const; // Simple view of all expenses
+    // Date queries are answered from the date index and return rows in date
+    // order (rows sharing a date keep their insertion order).
+    //
+    // The find* variants return a zero-copy view into the store, valid until the
+    // next add/delete/load. The getExpensesBy* variants return owning copies.
+    // A month outside 1..12, or a day that does not exist (2024-02-30), matches
+    // nothing here and in the totals below; such a date as a range bound is
+    // clamped to the nearest real day inside the range.
+    ExpenseView findExpensesByDay(const Date& date) const;
+    ExpenseView findExpensesByMonth(int month, int year) const;
+    ExpenseView findExpensesByYear(int year) const;
+    ExpenseView findExpensesByDateRange(const Date& startDate, const Date& endDate) const;
+
     std::vector<Expense> getExpensesByDay(const Date& date) const;
     std::vector<Expense> getExpensesByMonth(int month, int year) const;
     std::vector<Expense> getExpensesByYear(int year) const;
     std::vector<Expense> getExpensesByDateRange(const Date& startDate, const Date& endDate) const;
 
+    // Totals served from incrementally maintained rollups, without touching rows.
+    ExpenseTotal totalForDay(const Date& date) const;
+    ExpenseTotal totalForMonth(int month, int year) const;
+    ExpenseTotal totalForYear(int year) const;
+    // Combines year, month and day rollups to cover the range: O(years + months + days at the edges).
+    ExpenseTotal totalForDateRange(const Date& startDate, const Date& endDate) const;
+    // Per-category totals over a date range, largest sum first. Whole months come
+    // from the (month, category) rollups; only partial edge months walk rows.
+    std::vector<CategoryTotal> totalsByCategory(const Date& startDate, const Date& endDate) const;
+
+    // Ad-hoc aggregates over a date range, computed by a vectorized scan of the
+    // date and amount columns (see ScanKernels.h) rather than from rollups.
+    // aggregateDateRange returns all four in a single pass; the min/max
+    // variants return false when no expense falls in the range.
+    AmountAggregate aggregateDateRange(const Date& startDate, const Date& endDate) const;
+    double sumForDateRange(const Date& startDate, const Date& endDate) const;
+    size_t countForDateRange(const Date& startDate, const Date& endDate) const;
+    bool minAmountForDateRange(const Date& startDate, const Date& endDate, double& amount) const;
+    bool maxAmountForDateRange(const Date& startDate, const Date& endDate, double& amount) const;
+
+    // Composable queries over any mix of date, category, type, amount and
+    // description predicates (see ExpenseQuery.h). The engine answers the
+    // date range from the date index when that is selective and scans the
+    // columns otherwise; explain() shows the plan without running it.
+    // query() returns the matching rows in date order, valid until the next
+    // mutation; aggregate() folds their amounts without materializing them.
+    QueryResult query(const ExpenseQuery& query) const;
+    AmountAggregate aggregate(const ExpenseQuery& query) const;
+    QueryPlan explain(const ExpenseQuery& query) const;
+    // Pivots the rows matching spec.filter by any mix of year, month, day,
+    // category and type, with sum/count/min/max/average per group and an
+    // optional top-N (see GroupBy.h). Wide ones scan on the setScanThreads pool.
+    std::vector<GroupRow> groupBy(const GroupBySpec& spec) const;
+
+    // Streaming aggregation straight from a CSV under data/, for ledgers too
+    // large to load. One pass over the file in constant memory (the optional
+    // per-category breakdown grows only with the number of categories), with
+    // the same header and row validation as loadExpenses. The loaded ledger is
+    // neither consulted nor modified. Returns false if the file cannot be read.
+    bool streamTotalForDay(const std::string& filename, const Date& date, ExpenseTotal& total) const;
+    bool streamTotalForMonth(const std::string& filename, int month, int year, ExpenseTotal& total) const;
+    bool streamTotalForYear(const std::string& filename, int year, ExpenseTotal& total) const;
+    bool streamTotalForDateRange(const std::string& filename, const Date& startDate, const Date& endDate,
+                                 ExpenseTotal& total, std::vector<CategoryTotal>* byCategory = nullptr) const;
+
+    // Direct access to the columnar storage for scans that want raw columns.
+    const ExpenseStore& store() const { return store_; }
+
+    // Concurrent readers (snapshot isolation). One thread owns the manager and
+    // calls the mutating methods; any number of other threads call
+    // readSnapshot() and run their queries on the immutable manager it returns.
+    // Queries on a snapshot take no locks and see exactly the ledger as of one
+    // completed mutation; views into it stay valid while the pointer is held.
+    //
+    // Taking a snapshot is an atomic load when nothing changed since the last
+    // one. Otherwise a fresh one is built in O(chunks + categories + rollup
+    // keys) by sharing the store's column chunks copy-on-write; if the writer
+    // is mid-mutation (or mid-load), the previous snapshot is returned instead,
+    // so readers never wait for the writer. The writer waits at most for one
+    // snapshot build, and pays for copying a shared chunk the first time it
+    // overwrites it (deletes and compaction; plain appends copy nothing).
+    std::shared_ptr<const ExpenseManager> readSnapshot() const;
+
+    // Instrumentation (see OperationStats.h): per-operation call counts,
+    // latency histograms, rows scanned vs returned and bytes read/written for
+    // load, save, add, delete and every query type. Always on; read snapshots
+    // share the counters, so queries run on them are counted here too.
+    const OperationStats& stats() const { return *stats_; }
+    void resetStats() { stats_->reset(); }
 
 private:
-    std::vector<Expense> expenses_;
+    struct SnapshotTag {};
+    // Builds a read snapshot of `source`; the caller holds source's writer lock.
+    ExpenseManager(const ExpenseManager& source, SnapshotTag);
+    // The published snapshot, rebuilt first if stale; the caller holds the
+    // writer lock.
+    std::shared_ptr<const ExpenseManager> publishSnapshot() const;
+    // True unless saving `filepath` needs the writer's own state (journal,
+    // partition catalog); also answers correctly on a snapshot.
+    bool canSaveFromSnapshot(const std::string& filepath) const;
+    std::shared_future<bool> queueSave(std::shared_ptr<const ExpenseManager> snapshot, const std::string& filename,
+                                       SaveCallback onComplete) const;
+    // Runs `task` on a new thread once every save queued before it is done.
+    std::shared_future<bool> enqueueSave(std::function<bool()> task) const;
+    // Background journal compaction (see setJournaling). The caller holds the
+    // writer lock: the snapshot and the journal offset it covers are taken
+    // together. runJournalCompaction, on the save worker, writes the snapshot
+    // to "<base>.compact" and swaps it in under the lock, unless the ledger
+    // was reloaded since (`generation`) or the journal broke meanwhile.
+    void queueJournalCompaction() const;
+    bool runJournalCompaction(const std::shared_ptr<const ExpenseManager>& snapshot, uint64_t generation,
+                              uint64_t offset) const;
+    void waitForSaves() const;
+    void stopAutosave();
+
+    // Held by every mutating method: excludes snapshot builds, and marks the
+    // published snapshot stale on the way out.
+    class WriteLock {
+    public:
+        explicit WriteLock(ExpenseManager& manager) : manager_(manager), lock_(manager.writer_mutex_) {}
+        ~WriteLock() { manager_.version_.fetch_add(1, std::memory_order_release); }
+
+    private:
+        ExpenseManager& manager_;
+        std::lock_guard<std::mutex> lock_;
+    };
+
+    ExpenseStore store_;
+    DateIndex date_index_; // Kept in sync by add/delete/load
+    ExpenseRollups rollups_;  // Kept in sync by add/delete/load
+    // Null unless setTextIndex(true). Shared with read snapshots, which is
+    // safe because the writer only ever appends rows to it.
+    std::shared_ptr<TextIndex> text_index_;
+    // Null for serial scans (setScanThreads(1)). Shared with read snapshots;
+    // concurrent scans on it never wait for one another (see run()).
+    std::shared_ptr<ScanExecutor> scan_executor_;
     std::string data_filename_; // To store the default filename
+    bool snapshot_cache_ = true;
+    unsigned ingest_threads_ = 1;
+    bool journaling_ = false;
+    std::unique_ptr<ExpenseJournal> journal_; // Open while journaling a loaded file
+    std::string journal_base_path_;           // CSV the open journal applies to
+    mutable bool journal_broken_ = false;     // Missed a record; cleared by compactJournal
+    // Guarded by writer_mutex_: a background compaction is queued, and the
+    // count of journals opened so far, so it can tell its journal was closed.
+    mutable bool compaction_queued_ = false;
+    uint64_t journal_generation_ = 0;
+    bool partitioned_ = false;
+    size_t partition_budget_ = 0;
+    // Residency and dirty state of the loaded partitioned ledger. Owned by the
+    // writer thread and never copied into snapshots; mutable because queries
+    // record use and saves record what they wrote.
+    mutable PartitionCatalog partitions_;
+    std::string partition_dir_; // "data/<filename>.parts" of the loaded partitioned ledger
+    // Live rows in order, only needed (and built lazily) while the store has
+    // tombstones; see getAllExpenses().
+    mutable std::vector<RowId> live_rows_;
+    mutable bool live_rows_valid_ = false;
+
+    // Concurrent reader state (see readSnapshot()).
+    mutable std::mutex writer_mutex_;
+    std::atomic<uint64_t> version_{0};   // Completed mutations
+    mutable std::shared_ptr<const ExpenseManager> published_; // Only via std::atomic_load/atomic_store
+    uint64_t snapshot_version_ = 0;      // In a snapshot: the source's version_ when built
+    bool is_snapshot_ = false;
+    mutable std::once_flag live_rows_once_; // Builds live_rows_ of a snapshot shared by readers
+    // In a snapshot of a partitioned ledger: the months on disk but not
+    // resident when it was taken, and the one-time warning that a query
+    // needed them.
+    std::vector<PartitionCatalog::Key> missing_partitions_;
+    mutable std::once_flag missing_warning_once_;
+    std::shared_ptr<OperationStats> stats_ = std::make_shared<OperationStats>(); // Shared with snapshots
+
+    // Background saves (see saveExpensesAsync): the latest queued save, which
+    // waits for the one before it.
+    mutable std::mutex save_mutex_;
+    mutable std::shared_future<bool> pending_save_;
+    std::thread autosave_thread_;
+    std::mutex autosave_mutex_;
+    std::condition_variable autosave_wake_;
+    bool autosave_stop_ = false;
+
+    // Incremental reload (see reloadExpenses): how far the followed CSV has
+    // been read. Guarded by writer_mutex_, since saves on other threads
+    // update it too; never copied into snapshots.
+    struct TailPosition {
+        std::string path;        // CSV last loaded; empty for other kinds of ledger
+        bool following = false;  // The fields below are valid; otherwise reload fully
+        uint64_t device = 0;
+        uint64_t inode = 0;
+        uint64_t offset = 0;     // Just past the last complete record consumed
+        std::string fingerprint; // The bytes right before offset, to detect rewrites
+        bool has_layout = false; // layout is read from the header on first use
+        CsvLayout layout;
+    };
+    mutable TailPosition tail_;
+    // Saves queued but not yet finished, by file path. Guarded by
+    // writer_mutex_; a reload of such a file waits for followSavedFile.
+    mutable std::unordered_map<std::string, unsigned> saves_in_flight_;
+    std::thread watch_thread_;
+    int watch_stop_fd_ = -1; // Write end of a pipe that wakes the watcher to exit
 
     // Helper for parsing date strings if needed, or can be part of loadExpenses
-    Date parseDateString(const std::string& dateStr) const;
+    Date parseDateString(std::string_view dateStr) const;
+    // Row validation shared by both CSV loaders; returns the warning text or "".
+    std::string validateRow(std::string_view dateStr, std::string_view typeStr,
+                            Date& date, TransactionType& type) const;
+    // Reads a CSV with io::CSVReader, calling `onRow` for every row that
+    // passes validateRow; invalid rows are reported and skipped. A missing file
+    // counts as empty when `missingIsEmpty` is set, and as an error otherwise.
+    // `id` is kNoExpenseId for files without an Id column.
+    using RowHandler = std::function<void(std::string_view description, double amount, int32_t dayNumber,
+                                          std::string_view category, TransactionType type, ExpenseId id)>;
+    bool scanCsvFile(const std::string& filepath, const RowHandler& onRow, bool missingIsEmpty) const;
+    // scanCsvFile, or scanSegment over every row if `filepath` is a segment.
+    bool scanLedgerFile(const std::string& filepath, const RowHandler& onRow, bool missingIsEmpty) const;
+    bool loadSegmentFile(const std::string& filepath);
+    bool streamDayRange(const std::string& filename, int32_t firstDay, int32_t lastDay, ExpenseTotal& total,
+                        std::vector<CategoryTotal>* byCategory) const;
+    // Multi-threaded CSV ingest (ParallelIngest.cpp).
+    bool loadExpensesParallel(const std::string& filepath, unsigned threads);
+    // Tail reload (TailReload.cpp). followFile points tail_ at the end of
+    // tail_.path, whose whole content is now in the store (just loaded, or
+    // saved from it); `loadedAs` is the file's stamp from before the load,
+    // null after a save. The caller holds writer_mutex_. followSavedFile
+    // ends a save counted in saves_in_flight_ and, if it succeeded, follows
+    // the new file; it takes the lock itself. loadTail appends the records
+    // added since, returning false if the file must be reloaded whole instead.
+    void followFile(const SourceStamp* loadedAs) const;
+    void followSavedFile(const std::string& filepath, bool saved) const;
+    bool loadTail(size_t& rowsAdded, uint64_t& bytesRead, bool& ok);
+
+    // Row mutations shared by the public API and journal replay; they keep
+    // the store, date index and rollups in sync but do not journal.
+    ExpenseId appendRow(std::string_view description, double amount, int32_t dayNumber,
+                        std::string_view category, TransactionType type, ExpenseId id);
+    // appendRow for a row read back from a partition, keeping its saved id.
+    void restoreRow(std::string_view description, double amount, int32_t dayNumber,
+                    std::string_view category, TransactionType type, ExpenseId id);
+    void indexLastRow();
+    void tombstoneRow(size_t row);
+    // Journals and tombstones a live row; the caller holds the WriteLock.
+    void deleteRow(size_t row);
+    // Append one record to the open journal, if any. A record that cannot be
+    // written marks the journal broken: later records would replay without
+    // it, so none are appended until a save rewrites the base file in full.
+    void journalAdd(ExpenseId id, std::string_view description, double amount, int32_t dayNumber,
+                    std::string_view category, TransactionType type);
+    void journalDelete(ExpenseId id);
+    void markJournalBroken();
+    void compactRows();
+    void compactIfSparse();
+    void ensureLiveRows() const;
+    void buildLiveRows() const;
+    // Applies buffered date index updates under the writer lock, so a lookup
+    // on the writer thread never modifies the index while a snapshot of it
+    // is being taken.
+    void flushDateIndex() const;
+
+    // loadExpenses without the journal: snapshot cache, then CSV.
+    bool loadBaseFile(const std::string& filepath);
+    bool attachJournal(const std::string& filepath);
+    // Partitioned storage: opens the manifest (or splits the single CSV).
+    bool loadPartitionedLedger(const std::string& filepath);
+    // Makes every partition overlapping [firstDay, lastDay] resident, then
+    // applies the partition budget. No-op unless partitioned, and on
+    // snapshots. Takes the writer lock only when it has to load.
+    void ensureResident(int32_t firstDay, int32_t lastDay) const;
+    void ensureAllResident() const;
+    // Loads `keys` (from PartitionCatalog::touch) and evicts over budget;
+    // the caller holds the WriteLock.
+    void loadPartitions(const std::vector<PartitionCatalog::Key>& keys);
+    bool loadPartition(PartitionCatalog::Key key);
+    void evictPartition(PartitionCatalog::Key key);
+    // Writes partitions `keys` into `directory` (removing those left without
+    // rows), then its manifest. With `record`, the catalog marks them saved
+    // and the manifest lists the catalog; otherwise it lists just `keys`.
+    // Adds the rows and bytes written to the counters.
+    bool writePartitions(const std::string& directory, const std::vector<PartitionCatalog::Key>& keys,
+                         bool record, size_t& rowsWritten, uint64_t& bytesWritten) const;
+    // Writes the full CSV (and snapshot cache). With `atomic`, writes to a
+    // temporary file and moves it over `filepath` with replaceFile.
+    bool writeCsvFile(const std::string& filepath, bool atomic) const;
+    // The CSV writer behind writeCsvFile, for any set of rows.
+    bool writeCsvRows(const std::string& filepath, bool atomic, const ExpenseView& rows) const;
+    // writeCsvFile, or a segment (always written atomically) for a ".seg" name.
+    bool writeLedgerFile(const std::string& filepath, bool atomic) const;
+    // The rows writeLedgerFile(basePath) would write, in basePath's format,
+    // written to `stagedPath` instead and without a snapshot cache.
+    bool writeStagedLedger(const std::string& basePath, const std::string& stagedPath) const;
+
+    // Rebuilds every derived structure (date index, rollups) from the store.
+    void rebuildIndexes();
+
+    // Narrows [firstDay, lastDay] to the days actually present in the ledger.
+    // Returns false if no expense falls inside the range.
+    bool clampDayRange(int32_t& firstDay, int32_t& lastDay) const;
+
+    // View of every row whose packed date lies in [firstDay, lastDay].
+    ExpenseView viewDayRange(int32_t firstDay, int32_t lastDay) const;
+    // viewDayRange / its owning copy, recorded as a query of kind `op`.
+    ExpenseView timedDayRange(Operation op, int32_t firstDay, int32_t lastDay) const;
+    std::vector<Expense> copyDayRange(Operation op, int32_t firstDay, int32_t lastDay) const;
 };
 
 } // namespace expense_tracker
@@ -0,0 +1,176 @@
+#ifndef EXPENSE_QUERY_H
+#define EXPENSE_QUERY_H
+
+#include "Expense.h"
+#include "ExpenseStore.h"
+#include "ScanKernels.h"
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace expense_tracker {
+
+class DateIndex;
+class ScanExecutor;
+class TextIndex;
+
+// A conjunction of column predicates, built fluently and run by
+// ExpenseManager::query / aggregate:
+//
+//   ExpenseQuery().between({2024, 7, 1}, {2024, 9, 30})
+//                 .category("Travel")
+//                 .type(TransactionType::CREDIT)
+//                 .amountAbove(100);
+//
+// A query is plain data (ranges, sets and substrings), never a callback, so
+// the engine can pick an index for it and evaluate the rest column by column.
+// Repeating a predicate narrows it: date and amount ranges intersect, and
+// every descriptionContains() substring and descriptionStartsWith() prefix
+// must be present (a multi-term search). category() and type() are the
+// exception: repeated calls accept any of the values given.
+class ExpenseQuery {
+public:
+    // Inclusive date ranges.
+    ExpenseQuery& between(const Date& first, const Date& last);
+    ExpenseQuery& onOrAfter(const Date& first);
+    ExpenseQuery& onOrBefore(const Date& last);
+    ExpenseQuery& onDay(const Date& date) { return between(date, date); }
+    ExpenseQuery& inMonth(int month, int year);
+    ExpenseQuery& inYear(int year);
+
+    ExpenseQuery& category(std::string name);
+    ExpenseQuery& type(TransactionType type);
+
+    ExpenseQuery& amountAtLeast(double amount);
+    ExpenseQuery& amountAbove(double amount); // Strictly greater
+    ExpenseQuery& amountAtMost(double amount);
+    ExpenseQuery& amountBelow(double amount); // Strictly less
+    ExpenseQuery& amountBetween(double min, double max) { return amountAtLeast(min).amountAtMost(max); }
+
+    // Case-sensitive substring match on the description.
+    ExpenseQuery& descriptionContains(std::string text);
+    // Case-sensitive prefix match on the description.
+    ExpenseQuery& descriptionStartsWith(std::string text);
+
+    bool hasDateRange() const { return has_days_; }
+    int32_t firstDay() const { return first_day_; }
+    int32_t lastDay() const { return last_day_; }
+    const std::vector<std::string>& categories() const { return categories_; }
+    // Bit (1 << TransactionType) per accepted type; kAllTypes when unrestricted.
+    uint8_t typeMask() const { return type_mask_; }
+    bool hasAmountRange() const { return has_amounts_; }
+    double minAmount() const { return min_amount_; }
+    double maxAmount() const { return max_amount_; }
+    const std::vector<std::string>& descriptionSubstrings() const { return substrings_; }
+    const std::vector<std::string>& descriptionPrefixes() const { return prefixes_; }
+    bool hasDescriptionTerms() const { return !substrings_.empty() || !prefixes_.empty(); }
+
+    static constexpr uint8_t kAllTypes = (1u << static_cast<int>(TransactionType::CASH)) |
+                                         (1u << static_cast<int>(TransactionType::CREDIT));
+
+private:
+    bool has_days_ = false;
+    // Tombstoned rows carry ExpenseStore::kTombstoneDay, which lies above
+    // every range a query can express; undated rows (kNoDayNumber) only match
+    // a query without a date range, as every date predicate raises first_day_
+    // above kNoDayNumber.
+    int32_t first_day_ = std::numeric_limits<int32_t>::min();
+    int32_t last_day_ = ExpenseStore::kTombstoneDay - 1;
+    std::vector<std::string> categories_;
+    uint8_t type_mask_ = kAllTypes;
+    bool types_restricted_ = false;
+    bool has_amounts_ = false;
+    double min_amount_ = -std::numeric_limits<double>::infinity();
+    double max_amount_ = std::numeric_limits<double>::infinity();
+    std::vector<std::string> substrings_;
+    std::vector<std::string> prefixes_;
+};
+
+// How a query is answered: an access path that yields candidate rows, then
+// the remaining predicates in the order they are evaluated on them.
+struct QueryPlan {
+    enum class Access {
+        kEmpty,     // A predicate can never match (e.g. unknown category); no rows are read
+        kDateIndex, // The date index slice for the date range
+        kTextIndex, // The posting list of the description terms (see TextIndex)
+        kFullScan,  // Every row, column chunk by column chunk
+    };
+    enum class Filter { kDate, kType, kCategory, kAmount, kDescription };
+
+    Access access = Access::kEmpty;
+    size_t candidate_rows = 0; // Rows the access path produces
+    std::vector<Filter> filters;
+    // kTextIndex: the candidate rows, ascending. The description filter
+    // still checks each of them.
+    std::vector<RowId> postings;
+
+    // One line, e.g. "date-index(4210 rows) -> category -> amount".
+    std::string describe() const;
+};
+
+// Rows selected by a query, in date order (rows sharing a date in insertion
+// order), like the find* date queries. Owns the row ids; the rows are views
+// into the store, valid until the next mutation of the manager.
+class QueryResult {
+public:
+    QueryResult() = default;
+    QueryResult(const ExpenseStore* store, std::vector<RowId> rows, QueryPlan plan)
+        : store_(store), rows_(std::move(rows)), plan_(std::move(plan)) {}
+
+    size_t size() const { return rows_.size(); }
+    bool empty() const { return rows_.empty(); }
+    ExpenseRow operator[](size_t i) const { return store_->row(rows_[i]); }
+    ExpenseView rows() const { return ExpenseView(store_, rows_.data(), rows_.size()); }
+    std::vector<Expense> toVector() const { return rows().toVector(); }
+    const QueryPlan& plan() const { return plan_; }
+
+private:
+    const ExpenseStore* store_ = nullptr;
+    std::vector<RowId> rows_;
+    QueryPlan plan_;
+};
+
+// The engine behind ExpenseManager::query. `index` must be flushed.
+//
+// Planning: a date range is answered from the date index when its slice is
+// small enough that fetching the other columns row by row beats a sequential
+// scan; otherwise, and for queries without a date range, every row is
+// scanned. Given a text index, description terms are looked up first, and
+// their posting list is the access path when it is smaller still; the date
+// and category predicates then filter it like an index slice. Predicates
+// that cannot match anything are caught here from the category dictionary
+// and the indexes, before any row is read.
+//
+// Execution never calls back per row. The query is compiled to flat values
+// (a day range, a per-CategoryId accept table, a type bit mask, an amount
+// range, substrings) and applied by inline comparisons, a block of index
+// candidates or one column chunk at a time: each predicate narrows a
+// selection vector of rows, so later (dearer) predicates see only the
+// survivors. Given a ScanExecutor, a plan with enough candidates runs morsel
+// by morsel on its workers and yields the rows a serial run would, in the
+// same order (sums are added up per morsel, so may differ in the last bits).
+QueryPlan planQuery(const ExpenseQuery& query, const ExpenseStore& store, const DateIndex& index,
+                    const TextIndex* text = nullptr);
+// Appends the matching rows, in date order, to `rows`; returns rows scanned.
+size_t selectRows(const ExpenseQuery& query, const QueryPlan& plan, const ExpenseStore& store,
+                  const DateIndex& index, std::vector<RowId>& rows, ScanExecutor* executor = nullptr);
+// Folds the amounts of the matching rows into `acc`; returns rows scanned. A
+// date-only query goes straight to the aggregateDayRange kernel.
+size_t aggregateRows(const ExpenseQuery& query, const QueryPlan& plan, const ExpenseStore& store,
+                     const DateIndex& index, AmountAggregate& acc, ScanExecutor* executor = nullptr);
+// For callers that split a query across threads: runs share `part` of
+// `parts` contiguous shares of the plan's candidates (index positions,
+// postings or store chunks), calling `sink` once per non-empty block of matching row ids.
+// Shares may run concurrently. Returns rows scanned.
+using RowBlockSink = std::function<void(const RowId* rows, size_t count)>;
+size_t scanMatchingRows(const ExpenseQuery& query, const QueryPlan& plan, const ExpenseStore& store,
+                        const DateIndex& index, size_t part, size_t parts, const RowBlockSink& sink);
+// Parts a plan is cut into on a ScanExecutor: one per store chunk for a scan,
+// ScanExecutor::kMorselRows candidates each on an index path.
+size_t morselCount(const QueryPlan& plan, const ExpenseStore& store);
+
+} // namespace expense_tracker
+
+#endif // EXPENSE_QUERY_H
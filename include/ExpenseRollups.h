@@ -0,0 +1,63 @@
+#ifndef EXPENSE_ROLLUPS_H
+#define EXPENSE_ROLLUPS_H
+
+#include "Expense.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace expense_tracker {
+
+class ExpenseStore;
+struct ExpenseTotal {
+    double sum = 0.0;
+    size_t count = 0;
+};
+
+// Flat record used to persist rollups in a snapshot file.
+struct RollupEntry {
+    enum Kind : int32_t { kDay = 0, kMonth = 1, kYear = 2, kMonthCategory = 3 };
+    int32_t kind;
+    int32_t key;
+    uint32_t category; // kMonthCategory only
+    uint32_t reserved;
+    double sum;
+    uint64_t count;
+};
+
+// Incrementally maintained sums and counts per day, month, year and
+// (month, category). add()/remove() are O(1) hash updates, so totals never
+// require fetching rows. Undated expenses (kNoDayNumber) are only counted in
+// the per-day map so they never leak into a real month or year.
+class ExpenseRollups {
+public:
+    void add(int32_t day, CategoryId category, double amount);
+    void remove(int32_t day, CategoryId category, double amount);
+    // One pass over the store's date, category and amount columns.
+    void rebuild(const ExpenseStore& store);
+    void clear();
+
+    ExpenseTotal forDay(int32_t day) const;
+    ExpenseTotal forMonth(int month, int year) const;
+    ExpenseTotal forYear(int year) const;
+    // Per-category totals for one month, indexed by CategoryId (may be shorter
+    // than the category dictionary); nullptr if the month has no expenses.
+    const std::vector<ExpenseTotal>* forMonthByCategory(int month, int year) const;
+
+    // Snapshot persistence: a few entries per day/month, independent of row count.
+    std::vector<RollupEntry> exportEntries() const;
+    void importEntries(const RollupEntry* entries, size_t count);
+
+private:
+    static int32_t monthKey(int year, int month) { return year * 100 + month; }
+    void apply(int32_t day, CategoryId category, double amount, int delta);
+
+    std::unordered_map<int32_t, ExpenseTotal> days_;
+    std::unordered_map<int32_t, ExpenseTotal> months_;
+    std::unordered_map<int32_t, ExpenseTotal> years_;
+    std::unordered_map<int32_t, std::vector<ExpenseTotal>> month_categories_;
+};
+
+} // namespace expense_tracker
+
+#endif // EXPENSE_ROLLUPS_H
@@ -0,0 +1,69 @@
+#ifndef EXPENSE_SEGMENT_H
+#define EXPENSE_SEGMENT_H
+
+#include "Expense.h"
+#include "ExpenseStore.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace expense_tracker {
+
+// Compressed columnar ledger file ("segment"), an alternative to the CSV for
+// ledgers saved under a name ending in ".seg" (see ExpenseManager).
+//
+// Rows are stored in date order and cut into blocks of kSegmentBlockRows.
+// Within a block every column is encoded on its own:
+//   - dates: first day, then day-to-day deltas (non-negative, dates being
+//     sorted), as LEB128 varints; a run of same-day rows costs a byte each
+//   - ids: zigzag varint deltas from the previous row's id
+//   - types: one bit per row
+//   - categories: file-wide dictionary ids, bit-packed at the width of the
+//     largest id
+//   - amounts: integer cents, frame-of-reference (block minimum, then
+//     bit-packed offsets). A block holding any amount that is not a whole
+//     number of cents stores raw doubles instead, so nothing is rounded.
+//   - descriptions: a block dictionary of the distinct strings, sorted and
+//     front coded (shared prefix length, then the rest), and one bit-packed
+//     dictionary index per row
+//
+// File layout (integers little-endian, whatever the host):
+//   "EXPSEG\0\0" | u32 version | category dictionary | blocks...
+//   | block directory (per block: offset, bytes, rows, first and last day)
+//   | u64 directory offset | u64 row count | u64 next id | "EXPSEG\0\0"
+// The directory is read on open, so a reader decodes only the blocks whose
+// date range overlaps its query. Files are written to a temporary name and
+// moved into place with replaceFile (AtomicFile.h).
+constexpr uint32_t kSegmentVersion = 1;
+constexpr size_t kSegmentBlockRows = 8192;
+
+// Writes the live rows of `store`, in the order of `rowsByDate`, which must
+// be sorted by date (e.g. the date index); the rows' ids are kept.
+bool writeSegment(const std::string& path, const ExpenseStore& store, const ExpenseView& rowsByDate);
+
+// True for file names that saveExpenses writes as segments.
+bool hasSegmentExtension(const std::string& path);
+
+// True if `path` starts with the segment magic.
+bool isSegmentFile(const std::string& path);
+
+struct SegmentScanStats {
+    size_t blocks = 0;         // In the file
+    size_t blocks_read = 0;    // Decoded; the rest were skipped by date
+    uint64_t bytes_read = 0;   // Block bytes decoded, plus header and directory
+    ExpenseId next_id = 0;     // Recorded when the file was written
+};
+
+// Calls `onRow` for every row dated within [firstDay, lastDay], in date
+// order. Blocks entirely outside the range are not read. Returns false (with
+// an error printed) if the file cannot be opened or is malformed; rows of
+// blocks decoded before the error have been delivered.
+using SegmentRowHandler = std::function<void(std::string_view description, double amount, int32_t dayNumber,
+                                             std::string_view category, TransactionType type, ExpenseId id)>;
+bool scanSegment(const std::string& path, int32_t firstDay, int32_t lastDay, const SegmentRowHandler& onRow,
+                 SegmentScanStats* stats = nullptr);
+
+} // namespace expense_tracker
+
+#endif // EXPENSE_SEGMENT_H
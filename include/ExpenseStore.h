@@ -0,0 +1,259 @@
+#ifndef EXPENSE_STORE_H
+#define EXPENSE_STORE_H
+
+#include "Expense.h"
+#include "ChunkedColumn.h"
+#include "StringArena.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace expense_tracker {
+
+// A single expense read back from the columnar store. Strings are views into the
+// store, so a row is cheap to produce but must not outlive the next mutation.
+// Field names mirror Expense so row-oriented call sites read the same.
+struct ExpenseRow {
+    std::string_view description;
+    double amount;
+    Date date;
+    std::string_view category;
+    TransactionType transaction_type;
+    ExpenseId id;
+
+    Expense toExpense() const {
+        return Expense(std::string(description), amount, date, std::string(category), transaction_type);
+    }
+};
+
+class ExpenseStore;
+
+// Non-owning, random-access view over rows of an ExpenseStore: either a
+// contiguous run of rows or a span of row ids (an array, or a slice of a
+// chunked row-id column such as the date index).
+// Iterating yields ExpenseRow values without copying any strings; use toVector()
+// for an owning copy. A view is invalidated by any mutation of the store.
+class ExpenseView {
+public:
+    class Iterator {
+    public:
+        Iterator(const ExpenseView* view, size_t pos) : view_(view), pos_(pos) {}
+        ExpenseRow operator*() const { return (*view_)[pos_]; }
+        Iterator& operator++() { ++pos_; return *this; }
+        bool operator==(const Iterator& other) const { return pos_ == other.pos_; }
+        bool operator!=(const Iterator& other) const { return pos_ != other.pos_; }
+
+    private:
+        const ExpenseView* view_;
+        size_t pos_;
+    };
+
+    // Rows [first, last) of the store.
+    ExpenseView(const ExpenseStore* store, size_t first, size_t last)
+        : store_(store), rows_(nullptr), first_(first), last_(last) {}
+    // The rows named by rows[0..count); the id array must outlive the view.
+    ExpenseView(const ExpenseStore* store, const RowId* rows, size_t count)
+        : store_(store), rows_(rows), first_(0), last_(count) {}
+    // The rows named by rows[first..last); the column must outlive the view.
+    ExpenseView(const ExpenseStore* store, const ChunkedColumn<RowId>* rows, size_t first, size_t last)
+        : store_(store), rows_(nullptr), chunked_rows_(rows), first_(first), last_(last) {}
+    // The rows named by *rows, which the view (and its copies) keep alive.
+    ExpenseView(const ExpenseStore* store, std::shared_ptr<const std::vector<RowId>> rows)
+        : store_(store), rows_(rows->data()), first_(0), last_(rows->size()), owned_rows_(std::move(rows)) {}
+
+    size_t size() const { return last_ - first_; }
+    bool empty() const { return first_ == last_; }
+    // Store row backing position i of the view.
+    size_t rowId(size_t i) const {
+        if (rows_) {
+            return rows_[first_ + i];
+        }
+        return chunked_rows_ ? (*chunked_rows_)[first_ + i] : first_ + i;
+    }
+    ExpenseRow operator[](size_t i) const;
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, size()); }
+
+    std::vector<Expense> toVector() const;
+
+private:
+    const ExpenseStore* store_;
+    const RowId* rows_; // nullptr for a contiguous run of rows or a chunked span
+    const ChunkedColumn<RowId>* chunked_rows_ = nullptr;
+    size_t first_;
+    size_t last_;
+    std::shared_ptr<const std::vector<RowId>> owned_rows_;
+};
+
+// Column-oriented storage for expenses. Each field lives in its own column so
+// scans touch only the bytes they filter on:
+//   - dates as packed day numbers (int32, see toDayNumber)
+//   - amounts (double)
+//   - categories and transaction types dictionary-encoded as small integers
+//   - descriptions out of line in a StringArena, referenced by 8-byte handles
+//   - stable expense ids (see ExpenseId), ascending in row order unless rows
+//     were added with restore()
+//
+// Deleting a row only tombstones it: its day number is overwritten with
+// kTombstoneDay, which no date range contains, so date scans skip dead rows
+// without a separate liveness check. compact() later drops tombstoned rows in
+// one pass. size() counts physical rows, dead ones included.
+class ExpenseStore {
+public:
+    static constexpr int32_t kTombstoneDay = std::numeric_limits<int32_t>::max();
+    // New number compact() reports for a row it dropped.
+    static constexpr RowId kDroppedRow = std::numeric_limits<RowId>::max();
+
+    // Copies go through share(); the category map points into the names.
+    ExpenseStore() = default;
+    ExpenseStore(const ExpenseStore&) = delete;
+    ExpenseStore& operator=(const ExpenseStore&) = delete;
+    ExpenseStore(ExpenseStore&&) = default;
+    ExpenseStore& operator=(ExpenseStore&&) = default;
+
+    size_t size() const { return days_.size(); }
+    bool empty() const { return days_.empty(); }
+    size_t liveCount() const { return days_.size() - dead_; }
+    size_t deadCount() const { return dead_; }
+    bool isLive(size_t row) const { return days_[row] != kTombstoneDay; }
+
+    // Both return the id of the new row. An explicit `id` (e.g. read back from
+    // a file) is kept if it is larger than every id issued so far; otherwise,
+    // or if it is kNoExpenseId, the next free id is assigned.
+    ExpenseId append(const Expense& expense);
+    ExpenseId append(std::string_view description, double amount, int32_t dayNumber,
+                     std::string_view category, TransactionType type, ExpenseId id = kNoExpenseId);
+    // Appends a row under exactly `id`, which the caller guarantees is not
+    // used by any other row (e.g. a row of a ledger partition loaded after
+    // rows with larger ids). Ids issued later still exceed it. Returns `id`.
+    ExpenseId restore(std::string_view description, double amount, int32_t dayNumber,
+                      std::string_view category, TransactionType type, ExpenseId id);
+    // Makes the next issued id at least `id`, for ids held by rows that are
+    // not loaded.
+    void reserveIds(ExpenseId id) { next_id_ = std::max(next_id_, id); }
+    // Marks a live row deleted in O(1). Row numbers do not change.
+    void tombstone(size_t row);
+    // Drops tombstoned rows, keeping the order of the rest. If `newRows` is
+    // given it receives the new number of every old row (kDroppedRow for dead
+    // ones). Description bytes of dropped rows stay in
+    // the arena until the next clear().
+    void compact(std::vector<RowId>* newRows = nullptr);
+    void clear();
+
+    // Row of a live expense by id, in O(1) expected time. The id map is built
+    // on first use and then maintained by append/tombstone. On a shared copy
+    // (see share()) it is a binary search over the ascending id column instead,
+    // so concurrent lookups never write; after restore() has put ids out of
+    // order, a miss there falls back to a linear scan.
+    bool findRow(ExpenseId id, size_t& row) const;
+
+    // Returns a copy that shares every column chunk and arena block with this
+    // store (copy-on-write, see ChunkedColumn) in O(chunks + categories). The
+    // copy is never modified by later mutations of this store, so one writer
+    // may keep appending, tombstoning and compacting here while other threads
+    // read the copy. Must not run concurrently with a mutation of this store.
+    ExpenseStore share() const;
+    ExpenseId nextId() const { return next_id_; }
+    // True while ids ascend in row order, so id lookups are binary searches.
+    bool idsAscending() const { return ids_ascending_; }
+
+    // Column accessors.
+    ExpenseId idAt(size_t row) const { return ids_[row]; }
+    int32_t dayNumberAt(size_t row) const { return days_[row]; }
+    double amountAt(size_t row) const { return amounts_[row]; }
+    // Ids in a column borrowed from a snapshot are not scanned on open; one past
+    // the dictionary reads as category 0 rather than indexing out of bounds.
+    CategoryId categoryIdAt(size_t row) const {
+        const CategoryId id = categories_[row];
+        return id < category_names_.size() ? id : 0;
+    }
+    TransactionType typeAt(size_t row) const { return static_cast<TransactionType>(types_[row]); }
+    std::string_view descriptionAt(size_t row) const { return descriptions_.get(description_handles_[row]); }
+    std::string_view categoryAt(size_t row) const { return category_names_[categoryIdAt(row)]; }
+
+    ExpenseRow row(size_t row) const;
+    // Every physical row, tombstoned ones included (see ExpenseManager::getAllExpenses).
+    ExpenseView rows() const { return ExpenseView(this, size_t{0}, size()); }
+
+    const ChunkedColumn<int32_t>& dayNumbers() const { return days_; }
+    const ChunkedColumn<double>& amounts() const { return amounts_; }
+    const ChunkedColumn<CategoryId>& categoryIds() const { return categories_; }
+    const ChunkedColumn<uint8_t>& types() const { return types_; }
+    const ChunkedColumn<ExpenseId>& ids() const { return ids_; }
+
+    // Category dictionary.
+    size_t categoryCount() const { return category_names_.size(); }
+    const std::string& categoryName(CategoryId id) const { return category_names_[id]; }
+    // Returns false if the category has never been stored.
+    bool findCategory(const std::string& name, CategoryId& id) const;
+
+    const std::vector<std::string>& categoryNames() const { return category_names_; }
+
+    // Approximate resident bytes held by the columns, arena and dictionary.
+    // Columns borrowed from a mapped snapshot are not counted.
+    size_t memoryUsage() const;
+
+    // Column arrays laid out by a snapshot file (see Snapshot.h).
+    struct MappedColumns {
+        size_t rows = 0;
+        const int32_t* days = nullptr;
+        const double* amounts = nullptr;
+        const CategoryId* categories = nullptr;
+        const uint8_t* types = nullptr;
+        const StringArena::Handle* description_handles = nullptr;
+        const ExpenseId* ids = nullptr;
+        size_t dead = 0;          // Rows whose day is kTombstoneDay
+        ExpenseId next_id = 0;
+        bool ids_ascending = false; // As recorded by the writer
+        // Encoded StringArena blocks, in handle order: (data, size).
+        std::vector<std::pair<const char*, size_t>> description_blocks;
+        std::vector<std::string> category_names;
+    };
+
+    // Replaces the contents with columns read in place from mapped memory kept
+    // alive by `owner`. Queries run directly on the mapping; a mutation copies
+    // only the chunks it touches.
+    void borrowColumns(const MappedColumns& columns, const std::shared_ptr<const void>& owner);
+
+private:
+    CategoryId internCategory(std::string_view name);
+    void pushRow(std::string_view description, double amount, int32_t dayNumber, std::string_view category,
+                 TransactionType type, ExpenseId id);
+
+    ChunkedColumn<int32_t> days_;
+    ChunkedColumn<double> amounts_;
+    ChunkedColumn<CategoryId> categories_;
+    ChunkedColumn<uint8_t> types_;
+    ChunkedColumn<StringArena::Handle> description_handles_;
+    ChunkedColumn<ExpenseId> ids_;
+    StringArena descriptions_;
+    ExpenseId next_id_ = 0;
+    // False once restore() appended an id below an earlier row's (and, not
+    // knowing, for borrowed columns); see findRow.
+    bool ids_ascending_ = true;
+    size_t dead_ = 0;
+    // id -> row for live rows; built lazily by findRow.
+    mutable std::unordered_map<ExpenseId, RowId> rows_by_id_;
+    mutable bool rows_by_id_valid_ = false;
+    bool shared_copy_ = false; // Set by share(): findRow never builds the map
+
+    void indexCategories();
+
+    std::vector<std::string> category_names_;
+    // Keyed by views into category_names_, so appending a row looks its
+    // category up without building a string. Rebuilt whenever the names move.
+    std::unordered_map<std::string_view, CategoryId> category_ids_;
+};
+
+inline ExpenseRow ExpenseView::operator[](size_t i) const {
+    return store_->row(rowId(i));
+}
+
+} // namespace expense_tracker
+
+#endif // EXPENSE_STORE_H
@@ -0,0 +1,72 @@
+#ifndef GROUP_BY_H
+#define GROUP_BY_H
+
+#include "Expense.h"
+#include "ExpenseQuery.h"
+#include "ScanKernels.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace expense_tracker {
+
+class DateIndex;
+class ExpenseStore;
+class ScanExecutor;
+
+// Fields a group-by can key on; combine with |. Each date field is the
+// calendar component on its own, so kGroupMonth alone puts every January
+// together while kGroupYear | kGroupMonth gives calendar months.
+enum GroupField : unsigned {
+    kGroupYear = 1u << 0,
+    kGroupMonth = 1u << 1,
+    kGroupDay = 1u << 2,
+    kGroupCategory = 1u << 3,
+    kGroupType = 1u << 4,
+};
+
+struct GroupBySpec {
+    unsigned fields = kGroupCategory; // GroupField bits; 0 folds everything into one group
+    ExpenseQuery filter;              // Rows to aggregate (every live row by default)
+    enum class Order {
+        kKey,            // Year, month, day, category name, type
+        kSumDescending,
+        kCountDescending,
+    };
+    Order order = Order::kKey;
+    size_t limit = 0; // Keep the first `limit` groups under `order` (top-N); 0 keeps all
+};
+
+// One group of a group-by. Fields not grouped on are zero / empty, as are
+// the date fields of undated expenses.
+struct GroupRow {
+    int year = 0;
+    int month = 0;
+    int day = 0;
+    std::string category;
+    TransactionType type = TransactionType::CASH; // Meaningful only with kGroupType
+    AmountAggregate amounts;
+
+    double average() const { return amounts.count ? amounts.sum / static_cast<double>(amounts.count) : 0.0; }
+};
+
+// The engine behind ExpenseManager::groupBy; `index` must be flushed and
+// `plan` must come from planQuery(spec.filter, ...).
+//
+// Partitioned hash aggregation. Every row's group key packs into one 64-bit
+// integer (date components, category id, type). On `executor` (serially if
+// it is null or the plan is small) the plan's rows are scanned morsel by
+// morsel (see scanMatchingRows); each worker aggregates the morsels it runs
+// into private open-addressing hash tables, one per partition of the key
+// hash, so the scan shares nothing. Then partition p of every worker is
+// merged as one more morsel: each group lands in exactly one partition, so
+// the merge needs no locks either. Top-N is a partial sort of the merged
+// groups. Since a worker's tables add up whichever morsels it ran, sums may
+// differ in the last bits from run to run. `scanned` receives the number of
+// rows read.
+std::vector<GroupRow> groupRows(const GroupBySpec& spec, const QueryPlan& plan, const ExpenseStore& store,
+                                const DateIndex& index, ScanExecutor* executor, size_t& scanned);
+
+} // namespace expense_tracker
+
+#endif // GROUP_BY_H
@@ -0,0 +1,54 @@
+#ifndef LEDGER_GENERATOR_H
+#define LEDGER_GENERATOR_H
+
+#include "Expense.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace expense_tracker {
+
+// Shape of a synthetic ledger (see LedgerGenerator).
+struct LedgerSpec {
+    size_t rows = 100000;
+    Date first_date{2015, 1, 1};
+    int span_days = 3650;              // Dates cover [first_date, first_date + span_days)
+    size_t categories = 16;            // Distinct category names
+    size_t description_length = 24;   // Characters per description
+    uint64_t seed = 42;
+};
+
+// Deterministic synthetic ledgers for benchmarks. Row i depends only on the
+// spec and i (a counter-based hash, no shared RNG state), so any row can be
+// regenerated on its own and the same spec always yields byte-identical
+// files on every platform.
+//
+// Dates are non-decreasing in row order, like a ledger that is appended to
+// day by day; amounts, categories, types and descriptions (words from a
+// small fixed vocabulary) are uniformly random.
+class LedgerGenerator {
+public:
+    explicit LedgerGenerator(const LedgerSpec& spec) : spec_(spec) {}
+
+    const LedgerSpec& spec() const { return spec_; }
+
+    // Row i of the ledger, with ExpenseId i when written by writeCsv.
+    Expense expense(size_t i) const;
+    int32_t dayNumber(size_t i) const;
+
+    // Writes the whole ledger in the saveExpenses layout. Returns false if
+    // the file cannot be written.
+    bool writeCsv(const std::string& path) const;
+
+    // SplitMix64 finalizer: a well-mixed 64-bit hash of `x`.
+    static uint64_t mix(uint64_t x);
+
+private:
+    uint64_t rowHash(size_t i, uint64_t field) const { return mix(spec_.seed ^ mix(i * 8 + field)); }
+
+    LedgerSpec spec_;
+};
+
+} // namespace expense_tracker
+
+#endif // LEDGER_GENERATOR_H
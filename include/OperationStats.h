@@ -0,0 +1,127 @@
+#ifndef OPERATION_STATS_H
+#define OPERATION_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+namespace expense_tracker {
+
+// Operations instrumented by ExpenseManager. Each find*/getExpensesBy* pair
+// shares one query entry; every total* rollup lookup counts as kTotal.
+enum class Operation {
+    kLoad,
+    kSave,
+    kImport,
+    kReload, // reloadExpenses' incremental attempt; a fallback also records a kLoad
+    kAdd,
+    kDelete,
+    kCompact,
+    kQueryDay,
+    kQueryMonth,
+    kQueryYear,
+    kQueryRange,
+    kQuery, // ExpenseQuery selections; their aggregates count as kAggregate
+    kTotal,
+    kTotalsByCategory,
+    kAggregate,
+    kGroupBy,
+    kStream,
+    kSnapshot,
+    kCount
+};
+
+const char* operationName(Operation op);
+
+// Point-in-time summary of one operation's counters.
+struct OperationSummary {
+    uint64_t calls = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p90_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t rows_scanned = 0;
+    uint64_t rows_returned = 0;
+    uint64_t bytes_read = 0;
+    uint64_t bytes_written = 0;
+};
+
+// Always-on counters and latency histograms per Operation. Recording is a
+// handful of relaxed atomic adds, so the same object can be shared by a
+// manager and all of its read snapshots and updated from any thread.
+//
+// Latencies go into log-linear buckets: four per power of two of nanoseconds,
+// so a percentile is reported within 25% of the true value over the whole
+// range from nanoseconds to hours. Percentiles report the bucket's upper
+// bound, capped at the largest latency seen.
+class OperationStats {
+public:
+    static constexpr size_t kBuckets = 252; // Covers every uint64_t nanosecond value
+
+    void record(Operation op, uint64_t ns, uint64_t rowsScanned, uint64_t rowsReturned,
+                uint64_t bytesRead, uint64_t bytesWritten);
+
+    OperationSummary summary(Operation op) const;
+    // Latency below which a fraction `p` (0..1) of the calls completed.
+    uint64_t percentileNs(Operation op, double p) const;
+    void reset();
+
+    // One line per operation that has been called, either as aligned text or
+    // as a single JSON object ({"load": {...}, ...}).
+    void dump(std::ostream& out, bool json = false) const;
+
+    static size_t bucketFor(uint64_t ns);
+    static uint64_t bucketUpperBound(size_t bucket);
+
+private:
+    struct alignas(64) Counters {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> max_ns{0};
+        std::atomic<uint64_t> rows_scanned{0};
+        std::atomic<uint64_t> rows_returned{0};
+        std::atomic<uint64_t> bytes_read{0};
+        std::atomic<uint64_t> bytes_written{0};
+        std::atomic<uint64_t> buckets[kBuckets] = {};
+    };
+
+    Counters counters_[static_cast<size_t>(Operation::kCount)];
+};
+
+// Times one operation from construction to destruction and records it, with
+// whatever row and byte counts were reported in between.
+class OperationTimer {
+public:
+    OperationTimer(OperationStats& stats, Operation op)
+        : stats_(stats), op_(op), start_(std::chrono::steady_clock::now()) {}
+    ~OperationTimer() {
+        const auto elapsed = std::chrono::steady_clock::now() - start_;
+        stats_.record(op_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()),
+                      rows_scanned_, rows_returned_, bytes_read_, bytes_written_);
+    }
+    OperationTimer(const OperationTimer&) = delete;
+    OperationTimer& operator=(const OperationTimer&) = delete;
+
+    void rows(uint64_t scanned, uint64_t returned) {
+        rows_scanned_ = scanned;
+        rows_returned_ = returned;
+    }
+    void bytesRead(uint64_t bytes) { bytes_read_ = bytes; }
+    void bytesWritten(uint64_t bytes) { bytes_written_ = bytes; }
+
+private:
+    OperationStats& stats_;
+    Operation op_;
+    std::chrono::steady_clock::time_point start_;
+    uint64_t rows_scanned_ = 0;
+    uint64_t rows_returned_ = 0;
+    uint64_t bytes_read_ = 0;
+    uint64_t bytes_written_ = 0;
+};
+
+} // namespace expense_tracker
+
+#endif // OPERATION_STATS_H
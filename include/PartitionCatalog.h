@@ -0,0 +1,87 @@
+#ifndef PARTITION_CATALOG_H
+#define PARTITION_CATALOG_H
+
+#include "Expense.h"
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace expense_tracker {
+
+// Bookkeeping for a ledger stored as one CSV segment per calendar month (see
+// ExpenseManager::setPartitionedStorage):
+//
+//   data/<ledger>.parts/manifest      "expense-partitions 1", "next-id N",
+//                                     then one segment file name per line
+//   data/<ledger>.parts/2024-07.csv   rows dated July 2024, same columns as
+//                                     the single-file CSV, ids included
+//   data/<ledger>.parts/undated.csv   rows without a date
+//
+// The catalog knows which months exist on disk, which are loaded (resident)
+// and which have unsaved changes (dirty), and when each was last used. It
+// does no file I/O on rows; ExpenseManager loads, evicts and writes them.
+class PartitionCatalog {
+public:
+    // Months since year 0 (year * 12 + month - 1); kUndated sorts first.
+    using Key = int32_t;
+    static constexpr Key kUndated = std::numeric_limits<Key>::min();
+
+    struct Partition {
+        bool on_disk = false;  // Listed in the manifest
+        bool resident = false; // Rows are in the store
+        bool dirty = false;    // Store differs from the file
+        uint64_t last_used = 0;
+    };
+
+    static Key keyForDay(int32_t dayNumber);
+    // Inclusive packed-day range covered by a partition.
+    static void dayRange(Key key, int32_t& firstDay, int32_t& lastDay);
+    // "YYYY-MM.csv" or "undated.csv", relative to the partition directory.
+    // The year is signed and takes as many digits as it needs, so every key
+    // has a name that parseFileName reads back.
+    static std::string fileName(Key key);
+    static bool parseFileName(std::string_view name, Key& key);
+
+    void clear();
+    // Replaces the catalog with the manifest's partitions, all on disk and
+    // none resident. Returns false (with an error printed) if the manifest
+    // exists but is malformed; `exists` tells the two failures apart.
+    bool readManifest(const std::string& path, ExpenseId& nextId, bool& exists);
+    // The on-disk partitions after a save, in manifest format.
+    void writeManifest(std::ostream& out, ExpenseId nextId) const;
+
+    // Marks every partition overlapping [firstDay, lastDay] as just used and
+    // returns those that are on disk but not resident, in key order.
+    std::vector<Key> touch(int32_t firstDay, int32_t lastDay);
+    // Clean resident partitions to drop so that at most `budget` stay
+    // resident, least recently used first. Partitions used by the latest
+    // touch() are never offered, nor are dirty ones, so the result may fall
+    // short of the budget.
+    std::vector<Key> evictionCandidates(size_t budget) const;
+
+    // A row dated `dayNumber` was added or deleted: its partition must be
+    // resident (see touch) and is rewritten by the next save.
+    void markDirty(int32_t dayNumber);
+    void setResident(Key key, bool resident);
+    // Every row in the store is resident and unsaved (a ledger just loaded
+    // from a single CSV, which the next save splits into partitions).
+    void adoptAll(const std::vector<Key>& keys);
+    // After `key` was written (or removed, when it had no rows left).
+    void markSaved(Key key, bool hasRows);
+
+    std::vector<Key> dirtyKeys() const;
+    size_t residentCount() const;
+    const std::map<Key, Partition>& partitions() const { return partitions_; }
+
+private:
+    std::map<Key, Partition> partitions_;
+    uint64_t clock_ = 0; // Bumped by every touch()
+};
+
+} // namespace expense_tracker
+
+#endif // PARTITION_CATALOG_H
@@ -0,0 +1,64 @@
+#ifndef QUERY_DAEMON_H
+#define QUERY_DAEMON_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace expense_tracker {
+
+// Transport of `expense_tracker --serve` / `--connect` (see BatchMode.h): a
+// resident process answers command lines sent over a local Unix domain
+// stream socket, so a query costs a round trip instead of a ledger load.
+//
+// Wire format, integers in host byte order (both ends run on one machine):
+//
+//   request:  u32 command length, u8 format, command bytes
+//   response: u8 status (0 ok, 1 failed), u32 output length,
+//             u32 diagnostics length, output bytes, diagnostics bytes
+//
+// The command is one batch-mode command line; `format` is opaque here and
+// passed to the handler. Output is the command's result set, diagnostics are
+// the messages it printed. A connection may pipeline any number of requests;
+// they run in order and are answered in order.
+//
+// The daemon is one thread around epoll. Every request read in a wakeup is
+// run and its response queued; the queue then goes out in as few writes as
+// the socket takes. A client that stops reading stops being read from once
+// kMaxQueuedBytes are waiting for it.
+
+constexpr size_t kMaxRequestBytes = size_t{1} << 20;
+constexpr size_t kMaxQueuedBytes = size_t{4} << 20;
+
+struct DaemonReply {
+    bool ok = false;
+    std::string output;
+    std::string diagnostics;
+};
+
+// Runs one command; fills in reply.output and reply.diagnostics.
+using RequestHandler = std::function<void(uint8_t format, std::string_view command, DaemonReply& reply)>;
+
+// Listens on `socketPath` and serves until SIGINT, SIGTERM or a "shutdown"
+// request, then removes the socket. A stale socket file left by a daemon
+// that died is replaced; a live one, or a path that is not a socket, is an
+// error. SIGINT and SIGTERM must already be blocked in every thread (see
+// blockStopSignals). Returns false if the socket could not be set up.
+bool serveRequests(const std::string& socketPath, const RequestHandler& handler);
+
+// Blocks SIGINT and SIGTERM in the calling thread and the threads it starts
+// from now on, so that serveRequests receives them. Call before starting any.
+void blockStopSignals();
+
+// Client side: sends every command to the daemon at `socketPath` at once,
+// then calls onReply for each response, in order. Returns false, after
+// printing why, if the daemon cannot be reached or hangs up early.
+using ReplySink = std::function<void(const DaemonReply& reply)>;
+bool sendRequests(const std::string& socketPath, uint8_t format, const std::vector<std::string>& commands,
+                  const ReplySink& onReply);
+
+} // namespace expense_tracker
+
+#endif // QUERY_DAEMON_H
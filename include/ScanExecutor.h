@@ -0,0 +1,86 @@
+#ifndef SCAN_EXECUTOR_H
+#define SCAN_EXECUTOR_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace expense_tracker {
+
+// Work-stealing thread pool for wide scans (see ExpenseManager::setScanThreads).
+// A scan is cut into morsels, numbered in scan order: one store chunk, or
+// about kMorselRows index entries. run() hands every worker a contiguous
+// share of the morsels; each works through its own share front to back, and
+// a worker that runs dry steals the back half of another's remaining share.
+// Skewed morsels (a chunk where every row matches next to one where none do,
+// a description filter that is dear on some rows) therefore even out without
+// any coordination on the common path.
+//
+// The threads are started once and sleep between runs; the calling thread
+// works as worker 0. Callers give each morsel its own result slot and merge
+// the slots in morsel order, so results come out in scan order whichever
+// thread ran what.
+class ScanExecutor {
+public:
+    // Candidate rows per morsel on index access paths; scans use one chunk.
+    static constexpr size_t kMorselRows = size_t{1} << 16;
+    // Below this many rows a scan is over before the workers are awake.
+    static constexpr size_t kMinParallelRows = size_t{1} << 17;
+
+    using MorselTask = std::function<void(size_t morsel, size_t worker)>;
+
+    // `threads` workers, the calling thread included; 0 uses every hardware
+    // thread.
+    explicit ScanExecutor(unsigned threads);
+    ~ScanExecutor();
+    ScanExecutor(const ScanExecutor&) = delete;
+    ScanExecutor& operator=(const ScanExecutor&) = delete;
+
+    size_t workers() const { return workers_; }
+    // True if a scan over `rows` rows is worth splitting.
+    bool shouldSplit(size_t rows) const { return workers_ > 1 && rows >= kMinParallelRows; }
+
+    // Calls task(morsel, worker) once for every morsel in [0, morsels), with
+    // worker < workers(), and returns when all calls have. Calls on the same
+    // worker never overlap. One run at a time: if another thread's run is in
+    // progress (two snapshot readers scanning at once), this one runs every
+    // morsel on the calling thread as worker 0 rather than wait.
+    void run(size_t morsels, const MorselTask& task);
+
+private:
+    // Morsels [next, end) not yet taken. The owner takes from the front,
+    // thieves from the back.
+    struct alignas(64) Share {
+        std::mutex mutex;
+        size_t next = 0;
+        size_t end = 0;
+    };
+
+    void workerLoop(size_t worker);
+    // Runs morsels of the current task until none are left anywhere.
+    void work(size_t worker);
+    bool takeOwn(size_t worker, size_t& morsel);
+    bool steal(size_t worker, size_t& morsel);
+
+    size_t workers_;
+    std::unique_ptr<Share[]> shares_;
+    std::vector<std::thread> threads_;
+    std::mutex run_mutex_; // Held for the whole of a run
+
+    std::mutex mutex_; // Guards the fields below
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint64_t generation_ = 0; // Bumped to start a run
+    const MorselTask* task_ = nullptr;
+    size_t busy_ = 0; // Pool threads still working on the current run
+    bool stopping_ = false;
+};
+
+} // namespace expense_tracker
+
+#endif // SCAN_EXECUTOR_H
@@ -0,0 +1,41 @@
+#ifndef SCAN_KERNELS_H
+#define SCAN_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace expense_tracker {
+
+// Sum, min, max and count of the amounts selected by a scan. With count == 0
+// min and max keep their identity values (+inf / -inf).
+struct AmountAggregate {
+    double sum = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    size_t count = 0;
+
+    void merge(const AmountAggregate& other) {
+        sum += other.sum;
+        min = other.min < min ? other.min : min;
+        max = other.max > max ? other.max : max;
+        count += other.count;
+    }
+};
+
+// Filter-and-aggregate kernel over a packed date column and its amounts:
+// folds every amounts[i] with firstDay <= days[i] <= lastDay into `acc`.
+//
+// The loop is branch-free; on x86-64 it runs 8 rows per step with AVX2 or 4
+// with SSE2, picked once at runtime from the CPU's features, with a scalar
+// fallback elsewhere. Vector lanes keep separate partial sums, so the result
+// can differ from a sequential sum in the last bits.
+void aggregateDayRange(const int32_t* days, const double* amounts, size_t count, int32_t firstDay,
+                       int32_t lastDay, AmountAggregate& acc);
+
+// Name of the kernel aggregateDayRange dispatches to ("avx2", "sse2" or "scalar").
+const char* scanKernelName();
+
+} // namespace expense_tracker
+
+#endif // SCAN_KERNELS_H
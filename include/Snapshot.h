@@ -0,0 +1,63 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "ExpenseStore.h"
+#include "DateIndex.h"
+#include "ExpenseRollups.h"
+#include <cstdint>
+#include <string>
+
+namespace expense_tracker {
+
+// Binary snapshot of an ExpenseManager: the store's columns, the sorted date
+// index and the rollups, laid out as 64-byte aligned arrays so they can be used
+// in place after mmap. Opening a snapshot costs O(1) in the row count; pages are
+// faulted in by the queries that touch them. The CSV stays the import/export
+// format; a snapshot is a cache written next to it.
+//
+// Open validates the header only: its checksum, the section table against the
+// file size, and the bounds the writer recorded for each column holding
+// subscripts (category ids, types, index rows) against the dictionary and row
+// counts. Column bytes are not read there; instead the subscripts in them are
+// checked where they are resolved, so a damaged cache gives wrong rows at
+// worst, never an out-of-bounds read:
+//   - description handles by StringArena::get, against their arena block;
+//   - category ids by ExpenseStore::categoryIdAt, against the dictionary;
+//   - index rows by the index's first flush, which rebuilds the index from
+//     the day column if any is out of range (see DateIndex::borrow).
+// A torn file cannot occur, since snapshots are only ever replaced whole.
+//
+// File layout (native byte order, checked on open):
+//   SnapshotHeader | section 0 | section 1 | ... (see SnapshotSection ids in Snapshot.cpp)
+// Bump kSnapshotVersion whenever the layout changes; older files are rejected.
+constexpr uint32_t kSnapshotVersion = 1;
+
+// Identity of the CSV a snapshot was produced from. A cached snapshot is only
+// used while the CSV still has the same size and modification time.
+struct SourceStamp {
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+
+    bool operator==(const SourceStamp& other) const {
+        return size == other.size && mtime_ns == other.mtime_ns;
+    }
+};
+
+// Returns false if the file cannot be stat'ed (e.g. does not exist).
+bool statSource(const std::string& path, SourceStamp& stamp);
+
+// Writes to `path` via a temporary file moved into place with replaceFile
+// (AtomicFile.h), so a snapshot that is currently mapped is never modified in
+// place.
+bool writeSnapshot(const std::string& path, const ExpenseStore& store, const DateIndex& index,
+                   const ExpenseRollups& rollups, const SourceStamp& source);
+
+// Maps `path` and points store, index and rollups at it. If `expectedSource`
+// is given and does not match the stamp recorded in the file, or the file
+// fails validation, nothing is modified and false is returned.
+bool openSnapshot(const std::string& path, ExpenseStore& store, DateIndex& index,
+                  ExpenseRollups& rollups, const SourceStamp* expectedSource = nullptr);
+
+} // namespace expense_tracker
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,57 @@
+#ifndef STRING_ARENA_H
+#define STRING_ARENA_H
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace expense_tracker {
+
+// Append-only storage for variable-length strings (expense descriptions).
+// Strings are packed back to back in large blocks, each prefixed with a varint
+// length, and referenced by a 64-bit handle (block index << 32 | byte offset).
+// Blocks never move, so views returned by get() stay valid until clear().
+class StringArena {
+public:
+    using Handle = uint64_t;
+
+    Handle append(std::string_view text);
+    std::string_view get(Handle handle) const;
+
+    void clear();
+
+    // Appends a block of already-encoded entries read in place from `data`
+    // (a mapped snapshot kept alive by `owner`). The block is treated as full,
+    // so later appends never write into it.
+    void borrowBlock(const char* data, size_t size, const std::shared_ptr<const void>& owner);
+
+    // Encoding helpers for writers that lay out arena blocks themselves.
+    static Handle makeHandle(size_t block, size_t offset) {
+        return (static_cast<Handle>(block) << 32) | offset;
+    }
+    static size_t encodedSize(std::string_view text);
+    // Writes one entry (varint length + bytes) to `out`; returns bytes written.
+    static size_t encode(char* out, std::string_view text);
+
+    // Heap bytes allocated for blocks (including unused tail space); borrowed
+    // blocks are not counted.
+    size_t memoryUsage() const;
+
+private:
+    static constexpr size_t kBlockSize = size_t{1} << 20; // 1 MiB
+
+    struct Block {
+        std::shared_ptr<char[]> data;
+        size_t capacity = 0;
+        size_t used = 0;
+        bool borrowed = false;
+    };
+
+    std::vector<Block> blocks_;
+};
+
+} // namespace expense_tracker
+
+#endif // STRING_ARENA_H
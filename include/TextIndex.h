@@ -0,0 +1,70 @@
+#ifndef TEXT_INDEX_H
+#define TEXT_INDEX_H
+
+#include "Expense.h"
+#include "ExpenseStore.h"
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace expense_tracker {
+
+// Inverted trigram index over expense descriptions (see
+// ExpenseManager::setTextIndex). Every description is cut into its
+// overlapping 3-byte grams, with two start-of-text markers in front so that
+// short prefixes have grams too ("Sbux" yields "^^S", "^Sb", "Sbu", "bux").
+// Each gram maps to a posting list: the ascending store rows whose
+// description contains it.
+//
+// A search term is looked up as the intersection of its grams' postings.
+// That is a superset of the real matches ("abc bcd" has both grams of
+// "abcd" without containing it), so callers still compare the description
+// of each candidate; the index only makes the candidates few.
+// Matching is on bytes, i.e. case-sensitive like ExpenseQuery.
+//
+// Rows enter in store order, so postings stay sorted by plain appends.
+// Deletes are not applied: a tombstoned row stays in its postings until the
+// store is compacted, and callers drop it with the tombstone day like every
+// other scan does. One index is shared by the manager and its read
+// snapshots; the writer appends under an exclusive lock, and each reader
+// ignores rows past the end of its own copy of the store. Rebuilds and
+// compactions produce a new index, leaving older snapshots the old one.
+class TextIndex {
+public:
+    // Indexes every row of `store`, tombstoned ones included.
+    static std::shared_ptr<TextIndex> build(const ExpenseStore& store);
+
+    // `row` must be above every row indexed so far.
+    void add(RowId row, std::string_view description);
+
+    // An index of the live rows of `store`, numbered the way store.compact()
+    // is about to number them. Call it from the writer, before compacting.
+    std::shared_ptr<TextIndex> compacted(const ExpenseStore& store) const;
+
+    // Rows below `rowLimit`, ascending, whose description may contain every
+    // one of `substrings` and start with every one of `prefixes`. Returns
+    // false, leaving `rows` untouched, if no term narrows the search: only
+    // substrings of three or more bytes and non-empty prefixes have grams.
+    bool candidates(const std::vector<std::string>& substrings, const std::vector<std::string>& prefixes,
+                    size_t rowLimit, std::vector<RowId>& rows) const;
+
+    // Heap bytes held by the posting lists.
+    size_t memoryUsage() const;
+
+private:
+    using Posting = std::vector<RowId>;
+
+    void addLocked(RowId row, std::string_view description);
+
+    mutable std::shared_mutex mutex_;
+    std::unordered_map<uint32_t, Posting> postings_;
+    std::vector<uint32_t> scratch_; // Grams of the row being added
+};
+
+} // namespace expense_tracker
+
+#endif // TEXT_INDEX_H
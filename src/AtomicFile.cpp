@@ -0,0 +1,30 @@
+#include "AtomicFile.h"
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace expense_tracker {
+
+namespace {
+
+bool syncPath(const std::string& path, int flags) {
+    const int fd = open(path.c_str(), flags | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool synced = fsync(fd) == 0;
+    close(fd);
+    return synced;
+}
+
+} // namespace
+
+bool replaceFile(const std::string& from, const std::string& to) {
+    const size_t slash = to.rfind('/');
+    const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : to.substr(0, slash);
+    return syncPath(from, O_RDONLY) && std::rename(from.c_str(), to.c_str()) == 0 &&
+           syncPath(directory, O_RDONLY | O_DIRECTORY);
+}
+
+} // namespace expense_tracker
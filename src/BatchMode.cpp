@@ -0,0 +1,864 @@
+#include "BatchMode.h"
+#include "ExpenseManager.h"
+#include "CsvCodec.h"
+#include "QueryDaemon.h"
+#include "Snapshot.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace expense_tracker {
+
+namespace {
+
+constexpr size_t kFlushBytes = size_t{1} << 20;
+
+// The numeric values are the format byte of daemon requests.
+enum class OutputFormat : uint8_t { kCsv = 0, kJson = 1 };
+
+// The one output buffer of a batch run. Results are encoded straight into it
+// and handed to stdio in large writes instead of a flush per line. Without a
+// file it only collects, for the daemon to send a whole result set as one reply.
+class OutputWriter {
+public:
+    explicit OutputWriter(std::FILE* out) : out_(out) { buffer_.reserve(kFlushBytes + 4096); }
+
+    std::string& buffer() { return buffer_; }
+    void maybeFlush() {
+        if (out_ && buffer_.size() >= kFlushBytes) {
+            flush();
+        }
+    }
+    bool flush() {
+        if (!out_) {
+            return true;
+        }
+        if (!buffer_.empty()) {
+            std::fwrite(buffer_.data(), 1, buffer_.size(), out_);
+            buffer_.clear();
+        }
+        return std::fflush(out_) == 0 && !std::ferror(out_);
+    }
+
+private:
+    std::FILE* out_;
+    std::string buffer_;
+};
+
+void appendJsonString(std::string& out, std::string_view text) {
+    static const char kHex[] = "0123456789abcdef";
+    out += '"';
+    for (const char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out += "\\u00";
+                    out += kHex[(c >> 4) & 0xF];
+                    out += kHex[c & 0xF];
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+// Writes result sets in the selected format. A result set has fixed columns;
+// fields are written in column order, one row at a time.
+class ResultWriter {
+public:
+    ResultWriter(OutputWriter& out, OutputFormat format) : out_(out), format_(format) {}
+
+    void begin(std::string_view command, std::vector<const char*> columns) {
+        std::string& buffer = out_.buffer();
+        columns_ = std::move(columns);
+        rows_ = 0;
+        if (format_ == OutputFormat::kJson) {
+            buffer += "{\"command\":";
+            appendJsonString(buffer, command);
+            buffer += ",\"rows\":[";
+            return;
+        }
+        if (result_sets_ > 0) {
+            buffer += '\n';
+        }
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            buffer += i ? "," : "";
+            buffer += columns_[i];
+        }
+        buffer += '\n';
+    }
+
+    void field(std::string_view text) {
+        std::string& buffer = nextField();
+        if (format_ == OutputFormat::kJson) {
+            appendJsonString(buffer, text);
+        } else {
+            appendQuoted(buffer, text);
+        }
+    }
+    void field(double amount) {
+        std::string& buffer = nextField();
+        if (format_ == OutputFormat::kJson && !std::isfinite(amount)) {
+            buffer += "null"; // JSON has no inf/nan
+        } else {
+            appendAmount(buffer, amount);
+        }
+    }
+    void field(uint64_t count) {
+        std::string& buffer = nextField();
+        char digits[24];
+        buffer.append(digits, static_cast<size_t>(std::to_chars(digits, digits + sizeof(digits), count).ptr - digits));
+    }
+    void field(const Date& date) {
+        std::string& buffer = nextField();
+        const bool quote = format_ == OutputFormat::kJson;
+        buffer += quote ? "\"" : "";
+        appendIsoDate(buffer, date);
+        buffer += quote ? "\"" : "";
+    }
+    // "YYYY-MM" month label.
+    void monthField(int year, int month) {
+        char label[16];
+        std::snprintf(label, sizeof(label), "%04d-%02d", year, month);
+        std::string& buffer = nextField();
+        const bool quote = format_ == OutputFormat::kJson;
+        buffer += quote ? "\"" : "";
+        buffer += label;
+        buffer += quote ? "\"" : "";
+    }
+
+    void endRow() {
+        out_.buffer() += format_ == OutputFormat::kJson ? "}" : "\n";
+        column_ = 0;
+        ++rows_;
+        out_.maybeFlush();
+    }
+
+    void end() {
+        if (format_ == OutputFormat::kJson) {
+            out_.buffer() += "]}\n";
+        }
+        ++result_sets_;
+        out_.maybeFlush();
+    }
+
+private:
+    // Separator (and JSON key) for the next field of the current row.
+    std::string& nextField() {
+        std::string& buffer = out_.buffer();
+        if (format_ == OutputFormat::kJson) {
+            if (column_ == 0) {
+                buffer += rows_ ? ",{" : "{";
+            } else {
+                buffer += ',';
+            }
+            appendJsonString(buffer, columns_[column_]);
+            buffer += ':';
+        } else if (column_ > 0) {
+            buffer += ',';
+        }
+        ++column_;
+        return buffer;
+    }
+
+    OutputWriter& out_;
+    OutputFormat format_;
+    std::vector<const char*> columns_;
+    size_t column_ = 0;
+    size_t rows_ = 0;
+    size_t result_sets_ = 0;
+};
+
+// Splits a command line on spaces; double quotes group words ("Coffee shop")
+// and "" inside quotes is a literal quote.
+std::vector<std::string> tokenize(std::string_view line) {
+    std::vector<std::string> words;
+    size_t i = 0;
+    while (i < line.size()) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t')) {
+            ++i;
+        }
+        if (i == line.size()) {
+            break;
+        }
+        std::string word;
+        bool inQuotes = false;
+        for (; i < line.size() && (inQuotes || (line[i] != ' ' && line[i] != '\t')); ++i) {
+            if (line[i] != '"') {
+                word += line[i];
+            } else if (inQuotes && i + 1 < line.size() && line[i + 1] == '"') {
+                word += '"';
+                ++i;
+            } else {
+                inQuotes = !inQuotes;
+            }
+        }
+        words.push_back(std::move(word));
+    }
+    return words;
+}
+
+bool parseInt(std::string_view text, int& value) {
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+class BatchSession {
+public:
+    BatchSession(ResultWriter& results, unsigned threads, bool partitioned, bool textIndex, bool journaling)
+        : results_(&results) {
+        manager_.setIngestThreads(threads);
+        manager_.setScanThreads(threads);
+        manager_.setPartitionedStorage(partitioned);
+        manager_.setTextIndex(textIndex);
+        manager_.setJournaling(journaling);
+    }
+
+    // Where the following commands write their result sets.
+    void setResults(ResultWriter& results) { results_ = &results; }
+
+    // Runs one tokenized command; reports its own errors.
+    bool run(const std::vector<std::string>& words) {
+        const std::string& command = words[0];
+        const size_t args = words.size() - 1;
+        if (command == "load" && args == 1) {
+            return load(words[1]);
+        }
+        if (command == "reload" && args == 1) {
+            return manager_.reloadExpenses(words[1]);
+        }
+        if (command == "import" && args == 1) {
+            return manager_.importExpenses(words[1]);
+        }
+        if (command == "export" && args == 1) {
+            return manager_.saveExpenses(words[1]);
+        }
+        if (command == "add" && args == 5) {
+            return add(words);
+        }
+        if (command == "delete" && args == 1) {
+            ExpenseId id;
+            if (!parseExpenseId(words[1], id)) {
+                std::cerr << "Error: Invalid expense id: " << words[1] << std::endl;
+                return false;
+            }
+            if (!manager_.deleteExpenseById(id)) {
+                std::cerr << "Error: No expense with id " << id << std::endl;
+                return false;
+            }
+            return true;
+        }
+        Date start, end;
+        if ((command == "range" || command == "total" || command == "sum-by-category") && args == 2) {
+            if (!parseDate(words[1], start) || !parseDate(words[2], end)) {
+                return false;
+            }
+            if (command == "range") {
+                range(start, end);
+            } else if (command == "total") {
+                total(start, end);
+            } else {
+                sumByCategory(start, end);
+            }
+            return true;
+        }
+        if (command == "sum-by-month" && (args == 1 || args == 2)) {
+            int year, month = 0;
+            if (!parseInt(words[1], year) || (args == 2 && (!parseInt(words[2], month) || month < 1 || month > 12))) {
+                std::cerr << "Error: sum-by-month expects YEAR [MONTH]" << std::endl;
+                return false;
+            }
+            sumByMonth(year, month);
+            return true;
+        }
+        if (((command == "query" || command == "explain") && args >= 1) || command == "aggregate") {
+            ExpenseQuery query;
+            for (size_t i = 1; i <= args; ++i) {
+                if (!parsePredicate(words[i], query)) {
+                    return false;
+                }
+            }
+            if (command == "query") {
+                writeRows("query", manager_.query(query).rows());
+            } else if (command == "aggregate") {
+                aggregate(query);
+            } else {
+                results_->begin("explain", {"Plan"});
+                results_->field(std::string_view(manager_.explain(query).describe()));
+                results_->endRow();
+                results_->end();
+            }
+            return true;
+        }
+        if (command == "group-by" && args >= 1) {
+            GroupBySpec spec;
+            if (!parseGroupFields(words[1], spec.fields)) {
+                return false;
+            }
+            for (size_t i = 2; i <= args; ++i) {
+                if (!parseGroupOption(words[i], spec) && !parsePredicate(words[i], spec.filter)) {
+                    return false;
+                }
+            }
+            groupBy(spec);
+            return true;
+        }
+        if (command == "stats" && args == 0) {
+            stats();
+            return true;
+        }
+        std::cerr << "Error: Unknown command or wrong number of arguments: " << command << std::endl;
+        return false;
+    }
+
+    const ExpenseManager& manager() const { return manager_; }
+
+private:
+    bool parseDate(const std::string& text, Date& date) {
+        if (!parseIsoDate(text, date)) {
+            std::cerr << "Error: Invalid date '" << text << "', expected YYYY-MM-DD" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // One query predicate: from=DATE, to=DATE, category=NAME, type=cash|credit,
+    // text=SUBSTRING, prefix=PREFIX, or amount followed by >, >=, < or <= and
+    // a number.
+    bool parsePredicate(const std::string& word, ExpenseQuery& query) {
+        const size_t eq = word.find('=');
+        const std::string_view key = std::string_view(word).substr(0, eq);
+        const std::string value = eq == std::string::npos ? std::string() : word.substr(eq + 1);
+        Date date;
+        if (key == "from" || key == "to") {
+            if (!parseDate(value, date)) {
+                return false;
+            }
+            key == "from" ? query.onOrAfter(date) : query.onOrBefore(date);
+            return true;
+        }
+        if (key == "category" && eq != std::string::npos) {
+            query.category(value);
+            return true;
+        }
+        if (key == "type" && (value == "cash" || value == "credit")) {
+            query.type(value == "cash" ? TransactionType::CASH : TransactionType::CREDIT);
+            return true;
+        }
+        if (key == "text" && !value.empty()) {
+            query.descriptionContains(value);
+            return true;
+        }
+        if (key == "prefix" && !value.empty()) {
+            query.descriptionStartsWith(value);
+            return true;
+        }
+        if (word.compare(0, 6, "amount") == 0) {
+            std::string_view op = std::string_view(word).substr(6);
+            const size_t opLength = op.size() > 1 && op[1] == '=' ? 2 : 1;
+            double amount;
+            if (!op.empty() && parseAmount(op.substr(opLength), amount)) {
+                op = op.substr(0, opLength);
+                if (op == ">") {
+                    query.amountAbove(amount);
+                } else if (op == ">=") {
+                    query.amountAtLeast(amount);
+                } else if (op == "<") {
+                    query.amountBelow(amount);
+                } else if (op == "<=") {
+                    query.amountAtMost(amount);
+                } else {
+                    op = {};
+                }
+                if (!op.empty()) {
+                    return true;
+                }
+            }
+        }
+        std::cerr << "Error: Invalid query predicate: " << word << std::endl;
+        return false;
+    }
+
+    // add DATE AMOUNT CATEGORY cash|credit DESCRIPTION; answers with the new id.
+    bool add(const std::vector<std::string>& words) {
+        Date date;
+        double amount;
+        if (!parseDate(words[1], date)) {
+            return false;
+        }
+        if (!parseAmount(words[2], amount)) {
+            std::cerr << "Error: Invalid amount: " << words[2] << std::endl;
+            return false;
+        }
+        if (words[4] != "cash" && words[4] != "credit") {
+            std::cerr << "Error: Invalid type '" << words[4] << "', expected cash or credit" << std::endl;
+            return false;
+        }
+        const TransactionType type = words[4] == "cash" ? TransactionType::CASH : TransactionType::CREDIT;
+        const ExpenseId id = manager_.addExpense(Expense(words[5], amount, date, words[3], type));
+        results_->begin("add", {"Id"});
+        results_->field(static_cast<uint64_t>(id));
+        results_->endRow();
+        results_->end();
+        return true;
+    }
+
+    bool load(const std::string& filename) {
+        // A missing ledger is fine for the interactive first run, but in a
+        // script it is almost certainly a typo.
+        SourceStamp stamp;
+        if (!statSource("data/" + filename, stamp)) {
+            std::cerr << "Error: Could not open file for reading: data/" << filename << std::endl;
+            return false;
+        }
+        return manager_.loadExpenses(filename);
+    }
+
+    void range(const Date& start, const Date& end) {
+        writeRows("range", manager_.findExpensesByDateRange(start, end));
+    }
+
+    void writeRows(const char* name, const ExpenseView& rows) {
+        results_->begin(name, {"Date", "Description", "Amount", "Category", "Type", "Id"});
+        for (const ExpenseRow row : rows) {
+            results_->field(row.date);
+            results_->field(row.description);
+            results_->field(row.amount);
+            results_->field(row.category);
+            results_->field(std::string_view(transactionTypeName(row.transaction_type)));
+            results_->field(static_cast<uint64_t>(row.id));
+            results_->endRow();
+        }
+        results_->end();
+    }
+
+    void total(const Date& start, const Date& end) {
+        const ExpenseTotal sum = manager_.totalForDateRange(start, end);
+        results_->begin("total", {"Start", "End", "Sum", "Count"});
+        results_->field(start);
+        results_->field(end);
+        results_->field(sum.sum);
+        results_->field(static_cast<uint64_t>(sum.count));
+        results_->endRow();
+        results_->end();
+    }
+
+    void aggregate(const ExpenseQuery& query) {
+        const AmountAggregate amounts = manager_.aggregate(query);
+        results_->begin("aggregate", {"Sum", "Count", "Min", "Max"});
+        results_->field(amounts.sum);
+        results_->field(static_cast<uint64_t>(amounts.count));
+        results_->field(amounts.min);
+        results_->field(amounts.max);
+        results_->endRow();
+        results_->end();
+    }
+
+    // month == 0 lists all twelve months of the year.
+    void sumByMonth(int year, int month) {
+        results_->begin("sum-by-month", {"Month", "Sum", "Count"});
+        for (int m = month ? month : 1; m <= (month ? month : 12); ++m) {
+            const ExpenseTotal sum = manager_.totalForMonth(m, year);
+            results_->monthField(year, m);
+            results_->field(sum.sum);
+            results_->field(static_cast<uint64_t>(sum.count));
+            results_->endRow();
+        }
+        results_->end();
+    }
+
+    void sumByCategory(const Date& start, const Date& end) {
+        results_->begin("sum-by-category", {"Category", "Sum", "Count"});
+        for (const CategoryTotal& entry : manager_.totalsByCategory(start, end)) {
+            results_->field(std::string_view(entry.category));
+            results_->field(entry.total.sum);
+            results_->field(static_cast<uint64_t>(entry.total.count));
+            results_->endRow();
+        }
+        results_->end();
+    }
+
+    // Counters of every operation run so far, one row per operation called.
+    void stats() {
+        results_->begin("stats", {"Operation", "Calls", "TotalNs", "P50Ns", "P90Ns", "P99Ns", "MaxNs",
+                                 "RowsScanned", "RowsReturned", "BytesRead", "BytesWritten"});
+        for (size_t i = 0; i < static_cast<size_t>(Operation::kCount); ++i) {
+            const Operation op = static_cast<Operation>(i);
+            const OperationSummary s = manager_.stats().summary(op);
+            if (s.calls == 0) {
+                continue;
+            }
+            results_->field(std::string_view(operationName(op)));
+            for (uint64_t value : {s.calls, s.total_ns, s.p50_ns, s.p90_ns, s.p99_ns, s.max_ns, s.rows_scanned,
+                                   s.rows_returned, s.bytes_read, s.bytes_written}) {
+                results_->field(value);
+            }
+            results_->endRow();
+        }
+        results_->end();
+    }
+
+    // Comma-separated group-by fields, or "none" for a single total.
+    bool parseGroupFields(const std::string& list, unsigned& fields) {
+        fields = 0;
+        if (list == "none") {
+            return true;
+        }
+        size_t start = 0;
+        while (start <= list.size()) {
+            const size_t comma = std::min(list.find(',', start), list.size());
+            const std::string_view name = std::string_view(list).substr(start, comma - start);
+            if (name == "year") {
+                fields |= kGroupYear;
+            } else if (name == "month") {
+                fields |= kGroupMonth;
+            } else if (name == "day") {
+                fields |= kGroupDay;
+            } else if (name == "category") {
+                fields |= kGroupCategory;
+            } else if (name == "type") {
+                fields |= kGroupType;
+            } else {
+                std::cerr << "Error: Unknown group-by field '" << name
+                          << "', expected year, month, day, category, type or none" << std::endl;
+                return false;
+            }
+            start = comma + 1;
+        }
+        return true;
+    }
+
+    // top=N and order=key|sum|count; anything else is left to parsePredicate.
+    bool parseGroupOption(const std::string& word, GroupBySpec& spec) {
+        int limit;
+        if (word.compare(0, 4, "top=") == 0 && parseInt(std::string_view(word).substr(4), limit) && limit > 0) {
+            spec.limit = static_cast<size_t>(limit);
+            if (spec.order == GroupBySpec::Order::kKey) {
+                spec.order = GroupBySpec::Order::kSumDescending; // "Top" means largest unless ordered otherwise
+            }
+            return true;
+        }
+        if (word == "order=key" || word == "order=sum" || word == "order=count") {
+            spec.order = word == "order=key"   ? GroupBySpec::Order::kKey
+                         : word == "order=sum" ? GroupBySpec::Order::kSumDescending
+                                               : GroupBySpec::Order::kCountDescending;
+            return true;
+        }
+        return false;
+    }
+
+    void groupBy(const GroupBySpec& spec) {
+        static const std::pair<unsigned, const char*> kFieldColumns[] = {
+            {kGroupYear, "Year"}, {kGroupMonth, "Month"}, {kGroupDay, "Day"},
+            {kGroupCategory, "Category"}, {kGroupType, "Type"},
+        };
+        std::vector<const char*> columns;
+        for (const auto& column : kFieldColumns) {
+            if (spec.fields & column.first) {
+                columns.push_back(column.second);
+            }
+        }
+        columns.insert(columns.end(), {"Sum", "Count", "Min", "Max", "Average"});
+        results_->begin("group-by", std::move(columns));
+        for (const GroupRow& group : manager_.groupBy(spec)) {
+            for (const auto& column : kFieldColumns) {
+                switch (spec.fields & column.first) {
+                case kGroupYear: results_->field(static_cast<uint64_t>(std::max(0, group.year))); break;
+                case kGroupMonth: results_->field(static_cast<uint64_t>(group.month)); break;
+                case kGroupDay: results_->field(static_cast<uint64_t>(group.day)); break;
+                case kGroupCategory: results_->field(std::string_view(group.category)); break;
+                case kGroupType: results_->field(std::string_view(transactionTypeName(group.type))); break;
+                default: break;
+                }
+            }
+            results_->field(group.amounts.sum);
+            results_->field(static_cast<uint64_t>(group.amounts.count));
+            results_->field(group.amounts.min);
+            results_->field(group.amounts.max);
+            results_->field(group.average());
+            results_->endRow();
+        }
+        results_->end();
+    }
+
+    ExpenseManager manager_;
+    ResultWriter* results_;
+};
+
+void printUsage(std::ostream& out) {
+    out << "Usage: expense_tracker [--format csv|json] [--output FILE] [--script FILE] [--threads N] [--stats]\n"
+           "                       [--partitioned] [--text-index] [--journal] [--serve SOCKET] [COMMAND ...]\n"
+           "       expense_tracker --connect SOCKET [--format csv|json] [--output FILE] [--script FILE]\n"
+           "                       [COMMAND ...]\n"
+           "Runs commands without the interactive menu. Each COMMAND is one quoted argument.\n"
+           "--serve runs the commands, then keeps the ledger in memory and answers commands\n"
+           "sent with --connect over the Unix socket SOCKET until SIGINT, SIGTERM or a\n"
+           "\"shutdown\" command. --connect sends its commands to that daemon all at once and\n"
+           "prints the results; a failed command does not stop the ones sent after it.\n"
+           "--journal journals add/delete next to the loaded file (see export).\n"
+           "--threads N loads, scans and groups on N threads (0: every core; default 1).\n"
+           "--stats prints per-operation latency and row/byte counters to stderr on exit.\n"
+           "--partitioned keeps ledgers as one CSV per month under data/FILE.parts/, loaded\n"
+           "as commands need them; export then rewrites only the changed months.\n"
+           "--text-index answers text= and prefix= predicates from a trigram index over\n"
+           "descriptions instead of reading every description.\n"
+           "Commands (file names are relative to data/):\n"
+           "  load FILE                  replace the ledger with FILE\n"
+           "  reload FILE                bring the ledger up to date with FILE, parsing only the\n"
+           "                             rows appended since it was last loaded when possible\n"
+           "  import FILE                append the rows of FILE\n"
+           "  export FILE                write the ledger to FILE (a compressed segment if FILE\n"
+           "                             ends in .seg; load and import read either format)\n"
+           "  add DATE AMOUNT CATEGORY cash|credit DESCRIPTION\n"
+           "                             add an expense; prints its id\n"
+           "  delete ID                  delete the expense with that id\n"
+           "  range START END            list expenses dated START..END (YYYY-MM-DD)\n"
+           "  total START END            sum and count over START..END\n"
+           "  sum-by-month YEAR [MONTH]  per-month sums and counts\n"
+           "  sum-by-category START END  per-category sums and counts\n"
+           "  query PREDICATE...         list expenses matching every predicate:\n"
+           "                             from=DATE to=DATE category=NAME type=cash|credit\n"
+           "                             text=SUBSTRING prefix=PREFIX\n"
+           "                             amount>N amount>=N amount<N amount<=N\n"
+           "                             (repeated category= or type= accept any of the values)\n"
+           "  aggregate [PREDICATE...]   sum, count, min and max of the amounts query would list\n"
+           "  explain PREDICATE...       how query would run, without running it\n"
+           "  group-by FIELDS [PREDICATE...] [top=N] [order=key|sum|count]\n"
+           "                             sum/count/min/max/average per group; FIELDS is a comma list\n"
+           "                             of year, month, day, category, type, or none. top=N keeps\n"
+           "                             the N largest groups (by sum unless order= says otherwise)\n"
+           "  stats                      per-operation counters so far, as a result set\n";
+}
+
+using CommandLines = std::vector<std::pair<std::string, std::string>>; // (source label, line)
+
+bool isCommand(const std::vector<std::string>& words) {
+    return !words.empty() && words[0][0] != '#'; // Not a blank or comment line
+}
+
+// Runs every line; the first failing command stops the run.
+int runLines(BatchSession& session, const CommandLines& lines) {
+    for (const auto& entry : lines) {
+        const std::vector<std::string> words = tokenize(entry.second);
+        if (isCommand(words) && !session.run(words)) {
+            std::cerr << "Error: Command failed (" << entry.first << "): " << entry.second << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Daemon mode: every request runs on `session` with its own result writer,
+// and whatever the command prints (errors, warnings, info) is captured into
+// the reply instead of the daemon's own streams.
+int serve(BatchSession& session, const std::string& socketPath) {
+    OutputWriter capture(nullptr);
+    const RequestHandler handler = [&](uint8_t format, std::string_view command, DaemonReply& reply) {
+        std::ostringstream messages;
+        std::streambuf* const cerrBuffer = std::cerr.rdbuf(messages.rdbuf());
+        std::streambuf* const coutBuffer = std::cout.rdbuf(messages.rdbuf());
+        if (format > static_cast<uint8_t>(OutputFormat::kJson)) {
+            std::cerr << "Error: Unknown output format " << static_cast<int>(format) << std::endl;
+            reply.ok = false;
+        } else {
+            ResultWriter results(capture, static_cast<OutputFormat>(format));
+            session.setResults(results);
+            const std::vector<std::string> words = tokenize(command);
+            reply.ok = !isCommand(words) || session.run(words);
+        }
+        std::cout.rdbuf(coutBuffer);
+        std::cerr.rdbuf(cerrBuffer);
+        reply.output.swap(capture.buffer());
+        capture.buffer().clear();
+        reply.diagnostics = messages.str();
+    };
+    return serveRequests(socketPath, handler) ? 0 : 1;
+}
+
+// Client mode: the output matches a batch run of the same commands, except
+// that every command runs.
+int runClient(const std::string& socketPath, OutputFormat format, const CommandLines& lines, OutputWriter& writer) {
+    CommandLines sent;
+    std::vector<std::string> commands;
+    for (const auto& entry : lines) {
+        if (isCommand(tokenize(entry.second))) {
+            sent.push_back(entry);
+            commands.push_back(entry.second);
+        }
+    }
+    int status = 0;
+    size_t answered = 0;
+    bool wroteResults = false;
+    const bool connected = sendRequests(socketPath, static_cast<uint8_t>(format), commands,
+                                        [&](const DaemonReply& reply) {
+        if (!reply.output.empty()) {
+            // Replies are result sets written on their own, so the blank line
+            // between CSV result sets is added here.
+            if (format == OutputFormat::kCsv && wroteResults) {
+                writer.buffer() += '\n';
+            }
+            writer.buffer() += reply.output;
+            writer.maybeFlush();
+            wroteResults = true;
+        }
+        if (!reply.diagnostics.empty()) {
+            writer.flush(); // Keep the messages next to the results they belong to
+            std::cerr << reply.diagnostics << std::flush;
+        }
+        if (!reply.ok) {
+            std::cerr << "Error: Command failed (" << sent[answered].first << "): " << sent[answered].second
+                      << std::endl;
+            status = 1;
+        }
+        ++answered;
+    });
+    return connected ? status : 1;
+}
+
+} // namespace
+
+int runBatch(int argc, char** argv) {
+    OutputFormat format = OutputFormat::kCsv;
+    std::string outputPath, scriptPath;
+    unsigned threads = 1;
+    bool dumpStats = false;
+    bool partitioned = false;
+    bool textIndex = false;
+    bool journaling = false;
+    std::string serveSocket, connectSocket;
+    std::vector<std::string> commands;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--help" || arg == "-h") {
+            printUsage(std::cout);
+            return 0;
+        } else if (arg == "--format" && hasValue) {
+            const std::string_view value = argv[++i];
+            if (value != "csv" && value != "json") {
+                std::cerr << "Error: Unknown output format: " << value << std::endl;
+                return 2;
+            }
+            format = value == "json" ? OutputFormat::kJson : OutputFormat::kCsv;
+        } else if (arg == "--output" && hasValue) {
+            outputPath = argv[++i];
+        } else if (arg == "--script" && hasValue) {
+            scriptPath = argv[++i];
+        } else if (arg == "--threads" && hasValue) {
+            int value;
+            if (!parseInt(argv[++i], value) || value < 0) {
+                std::cerr << "Error: --threads expects a non-negative number" << std::endl;
+                return 2;
+            }
+            threads = static_cast<unsigned>(value);
+        } else if (arg == "--stats") {
+            dumpStats = true;
+        } else if (arg == "--partitioned") {
+            partitioned = true;
+        } else if (arg == "--text-index") {
+            textIndex = true;
+        } else if (arg == "--journal") {
+            journaling = true;
+        } else if (arg == "--serve" && hasValue) {
+            serveSocket = argv[++i];
+        } else if (arg == "--connect" && hasValue) {
+            connectSocket = argv[++i];
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Error: Unknown or incomplete option: " << arg << std::endl;
+            printUsage(std::cerr);
+            return 2;
+        } else {
+            commands.emplace_back(arg);
+        }
+    }
+
+    if (!connectSocket.empty() && (!serveSocket.empty() || threads != 1 || dumpStats || partitioned || textIndex ||
+                                   journaling)) {
+        std::cerr << "Error: --connect takes only --format, --output and --script; the daemon has the other options"
+                  << std::endl;
+        return 2;
+    }
+
+    // Script lines run before the commands given as arguments. They are
+    // labelled with their source for error messages.
+    CommandLines lines;
+    if (!scriptPath.empty()) {
+        std::ifstream file;
+        if (scriptPath != "-") {
+            file.open(scriptPath);
+            if (!file.is_open()) {
+                std::cerr << "Error: Could not open script: " << scriptPath << std::endl;
+                return 1;
+            }
+        }
+        std::istream& script = scriptPath == "-" ? std::cin : file;
+        std::string line;
+        for (size_t number = 1; std::getline(script, line); ++number) {
+            lines.emplace_back(scriptPath + ":" + std::to_string(number), line);
+        }
+    }
+    for (size_t i = 0; i < commands.size(); ++i) {
+        lines.emplace_back("argument " + std::to_string(i + 1), commands[i]);
+    }
+    if (lines.empty() && serveSocket.empty()) {
+        printUsage(std::cerr);
+        return 2;
+    }
+
+    std::FILE* out = stdout;
+    if (!outputPath.empty()) {
+        out = std::fopen(outputPath.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Error: Could not open output file: " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    OutputWriter writer(out);
+    int status = 0;
+    if (!connectSocket.empty()) {
+        status = runClient(connectSocket, format, lines, writer);
+        if (!writer.flush()) {
+            std::cerr << "Error: Could not write output" << std::endl;
+            status = 1;
+        }
+    } else {
+        if (!serveSocket.empty()) {
+            blockStopSignals(); // Before the session starts any threads
+        }
+        ResultWriter results(writer, format);
+        BatchSession session(results, threads, partitioned, textIndex, journaling);
+        status = runLines(session, lines);
+        if (!writer.flush()) {
+            std::cerr << "Error: Could not write output" << std::endl;
+            status = 1;
+        }
+        // The daemon starts only once its startup commands (typically a load)
+        // have all succeeded.
+        if (status == 0 && !serveSocket.empty()) {
+            status = serve(session, serveSocket);
+        }
+        if (dumpStats) {
+            session.manager().stats().dump(std::cerr, format == OutputFormat::kJson);
+        }
+    }
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return status;
+}
+
+} // namespace expense_tracker
@@ -0,0 +1,294 @@
+#include "CsvCodec.h"
+#include "fmt/format.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+namespace expense_tracker {
+
+namespace {
+
+// Value of `count` ASCII digits starting at `text`, or -1 if any is not a digit.
+int parseDigits(const char* text, int count) {
+    int value = 0;
+    for (int i = 0; i < count; ++i) {
+        const unsigned digit = static_cast<unsigned char>(text[i]) - '0';
+        if (digit > 9) {
+            return -1;
+        }
+        value = value * 10 + static_cast<int>(digit);
+    }
+    return value;
+}
+
+// Writes `value` as exactly `width` digits (value must fit).
+char* writeDigits(char* out, unsigned value, int width) {
+    for (int i = width - 1; i >= 0; --i) {
+        out[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    return out + width;
+}
+
+} // namespace
+
+bool isValidCalendarDate(int year, int month, int day) {
+    static constexpr int kDaysInMonth[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (month < 1 || month > 12 || day < 1) {
+        return false;
+    }
+    const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return day <= kDaysInMonth[month - 1] + (month == 2 && leap ? 1 : 0);
+}
+
+bool isStorableDate(const Date& date) {
+    if (date.year == 0 && date.month == 0 && date.day == 0) {
+        return true;
+    }
+    return date.year >= kMinLedgerYear && date.year <= kMaxLedgerYear &&
+           isValidCalendarDate(date.year, date.month, date.day);
+}
+
+int32_t firstDayOnOrAfter(const Date& date) {
+    if ((date.year == 0 && date.month == 0 && date.day == 0) ||
+        isValidCalendarDate(date.year, date.month, date.day)) {
+        return toDayNumber(date);
+    }
+    if (date.month < 1) {
+        return toDayNumber(date.year, 1, 1);
+    }
+    if (date.month > 12) {
+        return toDayNumber(date.year + 1, 1, 1);
+    }
+    if (date.day < 1) {
+        return toDayNumber(date.year, date.month, 1);
+    }
+    return date.month == 12 ? toDayNumber(date.year + 1, 1, 1) : toDayNumber(date.year, date.month + 1, 1);
+}
+
+int32_t lastDayOnOrBefore(const Date& date) {
+    if ((date.year == 0 && date.month == 0 && date.day == 0) ||
+        isValidCalendarDate(date.year, date.month, date.day)) {
+        return toDayNumber(date);
+    }
+    if (date.month < 1) {
+        return toDayNumber(date.year, 1, 1) - 1;
+    }
+    if (date.month > 12) {
+        return toDayNumber(date.year + 1, 1, 1) - 1;
+    }
+    if (date.day < 1) {
+        return toDayNumber(date.year, date.month, 1) - 1;
+    }
+    return firstDayOnOrAfter(date) - 1; // Past the month's end: its last day
+}
+
+bool parseIsoDate(std::string_view text, Date& date) {
+    if (text.size() != 10 || text[4] != '-' || text[7] != '-') {
+        return false;
+    }
+    const int year = parseDigits(text.data(), 4);
+    const int month = parseDigits(text.data() + 5, 2);
+    const int day = parseDigits(text.data() + 8, 2);
+    if (year < 0 || month < 0 || day < 0 || !isValidCalendarDate(year, month, day)) {
+        return false;
+    }
+    date = Date(year, month, day);
+    return true;
+}
+
+bool parseAmount(std::string_view text, double& amount) {
+    if (!text.empty() && text.front() == '+') {
+        text.remove_prefix(1); // from_chars does not accept an explicit plus sign
+    }
+    if (text.empty()) {
+        return false;
+    }
+#if defined(__cpp_lib_to_chars)
+    double value = 0.0;
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec != std::errc() || result.ptr != text.data() + text.size() || !std::isfinite(value)) {
+        return false; // from_chars also spells out "nan" and "inf"; no ledger amount is either
+    }
+    amount = value;
+    return true;
+#else
+    // Standard libraries without floating-point from_chars: strtod on a
+    // NUL-terminated stack copy (amounts are short; longer text is rejected).
+    char buffer[64];
+    if (text.size() >= sizeof(buffer)) {
+        return false;
+    }
+    text.copy(buffer, text.size());
+    buffer[text.size()] = '\0';
+    char* end = nullptr;
+    const double value = std::strtod(buffer, &end);
+    if (end != buffer + text.size() || !std::isfinite(value)) {
+        return false;
+    }
+    amount = value;
+    return true;
+#endif
+}
+
+bool parseExpenseId(std::string_view text, ExpenseId& id) {
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), id);
+    return !text.empty() && result.ec == std::errc() && result.ptr == text.data() + text.size() &&
+           id <= kMaxExpenseId;
+}
+
+bool parseTransactionType(std::string_view text, TransactionType& type) {
+    if (text == "Credit") {
+        type = TransactionType::CREDIT;
+    } else if (text == "Cash") {
+        type = TransactionType::CASH;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* transactionTypeName(TransactionType type) {
+    return type == TransactionType::CREDIT ? "Credit" : "Cash";
+}
+
+void appendIsoDate(std::string& out, const Date& date) {
+    if (date.year == 0 && date.month == 0 && date.day == 0) {
+        out += "0-00-00";
+        return;
+    }
+    char buffer[24];
+    char* end = buffer;
+    if (date.year < 0 || date.year > 9999) {
+        end = std::to_chars(buffer, buffer + 12, date.year).ptr; // Not readable back; keep the value visible
+    } else {
+        end = writeDigits(end, static_cast<unsigned>(date.year), 4);
+    }
+    *end++ = '-';
+    end = writeDigits(end, static_cast<unsigned>(date.month) % 100, 2);
+    *end++ = '-';
+    end = writeDigits(end, static_cast<unsigned>(date.day) % 100, 2);
+    out.append(buffer, static_cast<size_t>(end - buffer));
+}
+
+void appendAmount(std::string& out, double amount) {
+    // fmt's default double format: shortest round-trip digits, same text the
+    // previous fmt::format based writer produced.
+    char buffer[32];
+    const char* end = fmt::format_to(buffer, FMT_STRING("{}"), amount);
+    out.append(buffer, static_cast<size_t>(end - buffer));
+}
+
+void appendQuoted(std::string& out, std::string_view field) {
+    out += '"';
+    for (size_t quote; (quote = field.find('"')) != std::string_view::npos; field.remove_prefix(quote + 1)) {
+        out.append(field.data(), quote + 1);
+        out += '"';
+    }
+    out.append(field.data(), field.size());
+    out += '"';
+}
+
+std::string_view singleLineText(std::string_view text, std::string& scratch) {
+    if (text.find_first_of("\r\n") == std::string_view::npos) {
+        return text;
+    }
+    scratch.assign(text.data(), text.size());
+    std::replace_if(scratch.begin(), scratch.end(), [](char c) { return c == '\r' || c == '\n'; }, ' ');
+    return scratch;
+}
+
+void appendCsvRow(std::string& out, const ExpenseRow& row) {
+    out += '"';
+    appendIsoDate(out, row.date);
+    out += "\",";
+    appendQuoted(out, row.description);
+    out += ',';
+    appendAmount(out, row.amount);
+    out += ',';
+    appendQuoted(out, row.category);
+    out += ",\"";
+    out += transactionTypeName(row.transaction_type);
+    out += "\",";
+    char buffer[24];
+    out.append(buffer, static_cast<size_t>(std::to_chars(buffer, buffer + sizeof(buffer), row.id).ptr - buffer));
+    out += '\n';
+}
+
+const char* splitCsvRecord(const char* p, const char* end, std::vector<std::string_view>& fields,
+                           size_t& newlines) {
+    fields.clear();
+    newlines = 0;
+    const char* fieldStart = p;
+    bool inQuotes = false;
+    for (; p < end; ++p) {
+        const char c = *p;
+        if (c == '"') {
+            inQuotes = !inQuotes;
+        } else if (c == '\n') {
+            ++newlines;
+            if (!inQuotes) {
+                const char* fieldEnd = (p > fieldStart && p[-1] == '\r') ? p - 1 : p;
+                fields.emplace_back(fieldStart, static_cast<size_t>(fieldEnd - fieldStart));
+                return p + 1;
+            }
+        } else if (c == ',' && !inQuotes) {
+            fields.emplace_back(fieldStart, static_cast<size_t>(p - fieldStart));
+            fieldStart = p + 1;
+        }
+    }
+    const char* fieldEnd = (p > fieldStart && p[-1] == '\r') ? p - 1 : p;
+    fields.emplace_back(fieldStart, static_cast<size_t>(fieldEnd - fieldStart));
+    return end;
+}
+
+void decodeCsvField(std::string_view raw, std::string& out) {
+    while (!raw.empty() && raw.front() == ' ') {
+        raw.remove_prefix(1);
+    }
+    while (!raw.empty() && raw.back() == ' ') {
+        raw.remove_suffix(1);
+    }
+    out.clear();
+    if (raw.size() >= 2 && raw.front() == '"' && raw.back() == '"') {
+        raw = raw.substr(1, raw.size() - 2);
+        for (size_t i = 0; i < raw.size(); ++i) {
+            out.push_back(raw[i]);
+            if (raw[i] == '"' && i + 1 < raw.size() && raw[i + 1] == '"') {
+                ++i;
+            }
+        }
+    } else {
+        out.assign(raw.data(), raw.size());
+    }
+}
+
+const char* csvColumnName(CsvColumn column) {
+    static const char* const kNames[kCsvColumnCount] = {"Date", "Description", "Amount", "Category", "Type", "Id"};
+    return kNames[column];
+}
+
+bool mapCsvHeader(const std::vector<std::string_view>& fields, CsvLayout& layout, CsvColumn& missing) {
+    std::string name;
+    layout.min_fields = 0;
+    for (int c = 0; c < kCsvColumnCount; ++c) {
+        const CsvColumn column = static_cast<CsvColumn>(c);
+        layout.column_of[column] = CsvLayout::kMissing;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            decodeCsvField(fields[i], name);
+            if (name == csvColumnName(column)) {
+                layout.column_of[column] = i;
+                layout.min_fields = std::max(layout.min_fields, i + 1);
+                break;
+            }
+        }
+        if (layout.column_of[column] == CsvLayout::kMissing && column != kCsvId) {
+            missing = column;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace expense_tracker
@@ -0,0 +1,198 @@
+#include "DateIndex.h"
+#include "ExpenseStore.h"
+#include <algorithm>
+#include <iostream>
+
+namespace expense_tracker {
+
+namespace {
+
+// (day, row) packed into one unsigned key that sorts in the same order;
+// the sign bit is flipped so negative day numbers sort before positive ones.
+inline uint64_t packEntry(int32_t day, RowId row) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(day) ^ 0x80000000u) << 32) | row;
+}
+
+inline int32_t entryDay(uint64_t entry) {
+    return static_cast<int32_t>(static_cast<uint32_t>(entry >> 32) ^ 0x80000000u);
+}
+
+// First position in [first, size) whose key is not below `day` (or, with
+// `upper`, above it). Searches the chunk boundaries before one chunk, so the
+// pointer chasing through the chunk table happens O(log chunks) times.
+size_t keyBound(const ChunkedColumn<int32_t>& keys, size_t first, int32_t day, bool upper) {
+    auto before = [day, upper](int32_t key) { return upper ? key <= day : key < day; };
+    using Column = ChunkedColumn<int32_t>;
+    size_t lowChunk = first >> Column::kChunkShift;
+    size_t highChunk = keys.chunkCount();
+    // Find the last chunk whose first key still sorts before `day`.
+    while (highChunk - lowChunk > 1) {
+        const size_t mid = lowChunk + (highChunk - lowChunk) / 2;
+        if (before(keys.chunkData(mid)[0])) {
+            lowChunk = mid;
+        } else {
+            highChunk = mid;
+        }
+    }
+    if (lowChunk >= keys.chunkCount()) {
+        return keys.size();
+    }
+    const int32_t* data = keys.chunkData(lowChunk);
+    const size_t base = lowChunk << Column::kChunkShift;
+    const int32_t* begin = data + (first > base ? first - base : 0);
+    const int32_t* end = data + keys.chunkLength(lowChunk);
+    const int32_t* bound = std::partition_point(begin, end, before);
+    return base + static_cast<size_t>(bound - data);
+}
+
+} // namespace
+
+void DateIndex::insert(RowId row, int32_t day) {
+    // New rows always carry the largest row id, so appending keeps (day, row)
+    // order whenever the date is not earlier than the current maximum.
+    if (pending_.empty() && (keys_.empty() || day >= keys_[keys_.size() - 1])) {
+        keys_.push_back(day);
+        rows_.push_back(row);
+    } else {
+        pending_.emplace_back(day, row);
+    }
+}
+
+void DateIndex::renumber(const std::vector<RowId>& newRows) {
+    flush();
+    // Dropping entries shifts the rest, so the survivors go to fresh columns
+    // rather than being rewritten in place (which would copy every chunk
+    // shared with a copy of this index anyway).
+    ChunkedColumn<int32_t> keys;
+    ChunkedColumn<RowId> rows;
+    for (size_t i = 0; i < rows_.size(); ++i) {
+        const RowId row = newRows[rows_[i]];
+        if (row != ExpenseStore::kDroppedRow) {
+            keys.push_back(keys_[i]);
+            rows.push_back(row);
+        }
+    }
+    keys_ = std::move(keys);
+    rows_ = std::move(rows);
+}
+
+void DateIndex::rebuild(const ChunkedColumn<int32_t>& days) {
+    clear();
+    const size_t n = days.size();
+
+    // Ledgers are usually written chronologically; detect that and skip the sort.
+    bool sorted = true;
+    for (size_t i = 1; i < n; ++i) {
+        if (days[i] < days[i - 1]) {
+            sorted = false;
+            break;
+        }
+    }
+    if (sorted) {
+        for (size_t i = 0; i < n; ++i) {
+            keys_.push_back(days[i]);
+            rows_.push_back(static_cast<RowId>(i));
+        }
+        return;
+    }
+
+    std::vector<uint64_t> entries;
+    entries.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        entries.push_back(packEntry(days[i], static_cast<RowId>(i)));
+    }
+    std::sort(entries.begin(), entries.end());
+    for (uint64_t entry : entries) {
+        keys_.push_back(entryDay(entry));
+        rows_.push_back(static_cast<RowId>(entry & 0xFFFFFFFFu));
+    }
+}
+
+void DateIndex::clear() {
+    keys_.clear();
+    rows_.clear();
+    pending_.clear();
+    unverified_days_.clear();
+}
+
+void DateIndex::borrow(const int32_t* keys, const RowId* rows, const int32_t* days, size_t count,
+                       std::shared_ptr<const void> owner) {
+    pending_.clear();
+    keys_.borrow(keys, count, owner);
+    rows_.borrow(rows, count, owner);
+    unverified_days_.borrow(days, count, owner);
+}
+
+// One pass over the borrowed row column, on the first lookup rather than on
+// open. Entries appended since (rows past the borrowed ones) are kept.
+void DateIndex::verifyBorrowed() const {
+    const size_t count = unverified_days_.size();
+    bool valid = true;
+    for (size_t chunk = 0; chunk < rows_.chunkCount() && valid; ++chunk) {
+        const RowId* rows = rows_.chunkData(chunk);
+        const size_t base = chunk << ChunkedColumn<RowId>::kChunkShift;
+        const size_t length = std::min(rows_.chunkLength(chunk), count > base ? count - base : 0);
+        for (size_t i = 0; i < length; ++i) {
+            if (rows[i] >= count) {
+                valid = false;
+                break;
+            }
+        }
+    }
+    if (!valid) {
+        std::cerr << "Warning: Snapshot date index is corrupt; rebuilding it from the date column" << std::endl;
+        for (size_t i = count; i < keys_.size(); ++i) {
+            pending_.emplace_back(keys_[i], rows_[i]);
+        }
+        std::vector<std::pair<int32_t, RowId>> pending;
+        pending.swap(pending_);
+        DateIndex rebuilt;
+        rebuilt.rebuild(unverified_days_);
+        keys_ = std::move(rebuilt.keys_);
+        rows_ = std::move(rebuilt.rows_);
+        pending_ = std::move(pending);
+    }
+    unverified_days_ = ChunkedColumn<int32_t>();
+}
+
+std::pair<size_t, size_t> DateIndex::findRange(int32_t firstDay, int32_t lastDay) const {
+    flush();
+    if (firstDay > lastDay) {
+        return {0, 0};
+    }
+    const size_t first = keyBound(keys_, 0, firstDay, false);
+    return {first, keyBound(keys_, first, lastDay, true)};
+}
+
+void DateIndex::flush() const {
+    if (!unverified_days_.empty()) {
+        verifyBorrowed();
+    }
+    if (pending_.empty()) {
+        return;
+    }
+    std::sort(pending_.begin(), pending_.end());
+
+    // Merge into fresh columns: copies of this index keep the old chunks.
+    ChunkedColumn<int32_t> keys;
+    ChunkedColumn<RowId> rows;
+    size_t i = 0, j = 0;
+    while (i < keys_.size() || j < pending_.size()) {
+        const bool takeMain = j == pending_.size() ||
+            (i < keys_.size() && std::make_pair(keys_[i], rows_[i]) < pending_[j]);
+        if (takeMain) {
+            keys.push_back(keys_[i]);
+            rows.push_back(rows_[i]);
+            ++i;
+        } else {
+            keys.push_back(pending_[j].first);
+            rows.push_back(pending_[j].second);
+            ++j;
+        }
+    }
+    keys_ = std::move(keys);
+    rows_ = std::move(rows);
+    pending_.clear();
+}
+
+} // namespace expense_tracker
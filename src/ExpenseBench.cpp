@@ -0,0 +1,358 @@
+// expense_bench: throughput, latency percentiles and peak RSS of the main
+// ExpenseManager operations over synthetic ledgers (see LedgerGenerator.h).
+//
+//   expense_bench [--rows 10000,100000,1000000] [--full] [--days N]
+//                 [--categories N] [--desc-len N] [--seed N] [--repeat N]
+//                 [--min-time SECONDS] [--max-ops N] [--mutations N]
+//                 [--format json|csv] [--output FILE] [--keep]
+//
+// For every row count a ledger CSV is generated under data/ (not timed), then
+// loadExpenses, each getExpensesBy* method, saveExpenses, addExpense and
+// deleteExpense are measured in that order on the same manager. --full runs
+// the whole 10K..100M sweep (100M rows needs tens of GB of disk and memory).
+//
+// One record per (benchmark, row count) is written as a JSON line or a CSV
+// row, preceded by a "config" record describing the run. Latencies are per
+// call; items_per_sec counts rows for load/save and calls otherwise.
+// peak_rss_kb is the process high-water mark so far (getrusage), so it only
+// grows across a sweep; rss_kb is the resident size after the benchmark.
+
+#include "ExpenseManager.h"
+#include "LedgerGenerator.h"
+#include "ScanKernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace expense_tracker;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    std::vector<size_t> rows{10000, 100000, 1000000};
+    LedgerSpec spec;
+    int repeat = 3;            // Samples of load/save per row count
+    double min_time = 1.0;     // Seconds per query benchmark, at least kMinOps calls
+    size_t max_ops = 10000;    // Upper bound on calls per query benchmark
+    size_t mutations = 100000; // addExpense / deleteExpense calls per row count
+    bool json = true;
+    std::string output;
+    bool keep = false;         // Keep the generated CSVs
+};
+
+constexpr size_t kMinOps = 5;
+
+struct Result {
+    std::string bench;
+    size_t rows = 0;
+    std::vector<uint64_t> latencies_ns;
+    uint64_t items = 0; // Rows processed (load/save) or calls
+};
+
+size_t peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss); // KiB on Linux
+}
+
+size_t currentRssKb() {
+    long pages = 0, resident = 0;
+    if (std::FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        std::fclose(statm);
+    }
+    return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const size_t rank = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+class Reporter {
+public:
+    Reporter(std::FILE* out, bool json) : out_(out), json_(json) {}
+
+    void config(const BenchOptions& options) {
+        const LedgerSpec& spec = options.spec;
+        if (json_) {
+            std::fprintf(out_,
+                         "{\"record\":\"config\",\"span_days\":%d,\"categories\":%zu,\"desc_len\":%zu,"
+                         "\"seed\":%llu,\"repeat\":%d,\"min_time\":%g,\"max_ops\":%zu,\"mutations\":%zu,"
+                         "\"scan_kernel\":\"%s\",\"hardware_threads\":%u}\n",
+                         spec.span_days, spec.categories, spec.description_length,
+                         static_cast<unsigned long long>(spec.seed), options.repeat, options.min_time,
+                         options.max_ops, options.mutations, scanKernelName(), std::thread::hardware_concurrency());
+        } else {
+            std::fprintf(out_,
+                         "# span_days=%d categories=%zu desc_len=%zu seed=%llu scan_kernel=%s hardware_threads=%u\n",
+                         spec.span_days, spec.categories, spec.description_length,
+                         static_cast<unsigned long long>(spec.seed), scanKernelName(),
+                         std::thread::hardware_concurrency());
+            std::fprintf(out_, "bench,rows,ops,seconds,items_per_sec,p50_us,p90_us,p99_us,p999_us,max_us,"
+                               "rss_kb,peak_rss_kb\n");
+        }
+        std::fflush(out_);
+    }
+
+    void record(Result& result) {
+        std::vector<uint64_t>& ns = result.latencies_ns;
+        std::sort(ns.begin(), ns.end());
+        uint64_t totalNs = 0;
+        for (uint64_t sample : ns) {
+            totalNs += sample;
+        }
+        const double seconds = static_cast<double>(totalNs) / 1e9;
+        const double rate = seconds > 0 ? static_cast<double>(result.items) / seconds : 0.0;
+        auto us = [&](double p) { return static_cast<double>(percentile(ns, p)) / 1e3; };
+        const double maxUs = ns.empty() ? 0.0 : static_cast<double>(ns.back()) / 1e3;
+        if (json_) {
+            std::fprintf(out_,
+                         "{\"record\":\"result\",\"bench\":\"%s\",\"rows\":%zu,\"ops\":%zu,\"seconds\":%.6f,"
+                         "\"items_per_sec\":%.1f,\"p50_us\":%.3f,\"p90_us\":%.3f,\"p99_us\":%.3f,"
+                         "\"p999_us\":%.3f,\"max_us\":%.3f,\"rss_kb\":%zu,\"peak_rss_kb\":%zu}\n",
+                         result.bench.c_str(), result.rows, ns.size(), seconds, rate, us(0.5), us(0.9), us(0.99),
+                         us(0.999), maxUs, currentRssKb(), peakRssKb());
+        } else {
+            std::fprintf(out_, "%s,%zu,%zu,%.6f,%.1f,%.3f,%.3f,%.3f,%.3f,%.3f,%zu,%zu\n", result.bench.c_str(),
+                         result.rows, ns.size(), seconds, rate, us(0.5), us(0.9), us(0.99), us(0.999), maxUs,
+                         currentRssKb(), peakRssKb());
+        }
+        std::fflush(out_); // One line per benchmark, so a long sweep can be watched
+    }
+
+private:
+    std::FILE* out_;
+    bool json_;
+};
+
+// Times one call of `op`, appending the latency to `result`.
+template <typename Op>
+void timeOnce(Result& result, Op&& op) {
+    const auto start = Clock::now();
+    op();
+    const auto stop = Clock::now();
+    result.latencies_ns.push_back(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()));
+}
+
+// Calls `op(i)` until both kMinOps calls and min_time seconds are reached, or
+// max_ops calls have been made.
+template <typename Op>
+Result timeQueries(const std::string& bench, size_t rows, const BenchOptions& options, Op&& op) {
+    Result result;
+    result.bench = bench;
+    result.rows = rows;
+    const auto deadline = Clock::now() + std::chrono::duration<double>(options.min_time);
+    for (size_t i = 0; i < options.max_ops && (i < kMinOps || Clock::now() < deadline); ++i) {
+        timeOnce(result, [&] { op(i); });
+        ++result.items;
+    }
+    return result;
+}
+
+bool parseList(const std::string& text, std::vector<size_t>& values) {
+    values.clear();
+    size_t start = 0;
+    while (start <= text.size()) {
+        const size_t comma = std::min(text.find(',', start), text.size());
+        char* end = nullptr;
+        const std::string item = text.substr(start, comma - start);
+        const unsigned long long value = std::strtoull(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || value == 0) {
+            return false;
+        }
+        values.push_back(static_cast<size_t>(value));
+        start = comma + 1;
+    }
+    return !values.empty();
+}
+
+void printUsage() {
+    std::cerr << "Usage: expense_bench [--rows N,N,...] [--full] [--days N] [--categories N] [--desc-len N]\n"
+                 "                     [--seed N] [--repeat N] [--min-time SECONDS] [--max-ops N]\n"
+                 "                     [--mutations N] [--format json|csv] [--output FILE] [--keep]\n";
+}
+
+bool parseOptions(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        auto number = [&]() { return std::strtoull(argv[++i], nullptr, 10); };
+        if (arg == "--rows" && hasValue) {
+            if (!parseList(argv[++i], options.rows)) {
+                return false;
+            }
+        } else if (arg == "--full") {
+            options.rows = {10000, 100000, 1000000, 10000000, 100000000};
+        } else if (arg == "--days" && hasValue) {
+            options.spec.span_days = std::max(1, static_cast<int>(number()));
+        } else if (arg == "--categories" && hasValue) {
+            options.spec.categories = std::max<size_t>(1, number());
+        } else if (arg == "--desc-len" && hasValue) {
+            options.spec.description_length = number();
+        } else if (arg == "--seed" && hasValue) {
+            options.spec.seed = number();
+        } else if (arg == "--repeat" && hasValue) {
+            options.repeat = std::max(1, static_cast<int>(number()));
+        } else if (arg == "--min-time" && hasValue) {
+            options.min_time = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--max-ops" && hasValue) {
+            options.max_ops = std::max<size_t>(kMinOps, number());
+        } else if (arg == "--mutations" && hasValue) {
+            options.mutations = number();
+        } else if (arg == "--format" && hasValue) {
+            const std::string format = argv[++i];
+            if (format != "json" && format != "csv") {
+                return false;
+            }
+            options.json = format == "json";
+        } else if (arg == "--output" && hasValue) {
+            options.output = argv[++i];
+        } else if (arg == "--keep") {
+            options.keep = true;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+void benchLedger(size_t rows, const BenchOptions& options, Reporter& reporter) {
+    LedgerSpec spec = options.spec;
+    spec.rows = rows;
+    const LedgerGenerator generator(spec);
+    const std::string filename = "bench_" + std::to_string(rows) + ".csv";
+    const std::string savedName = "bench_" + std::to_string(rows) + "_saved.csv";
+    if (!generator.writeCsv("data/" + filename)) {
+        std::cerr << "Error: Could not write data/" << filename << std::endl;
+        return;
+    }
+
+    ExpenseManager manager;
+    manager.setSnapshotCache(false); // Measure CSV parsing and formatting, not the mmap cache
+
+    Result load{"loadExpenses", rows, {}, 0};
+    for (int r = 0; r < options.repeat; ++r) {
+        timeOnce(load, [&] { manager.loadExpenses(filename); });
+        load.items += manager.getAllExpenses().size();
+    }
+    reporter.record(load);
+
+    // Query arguments come from their own stream so every run (and every
+    // row count) asks for the same dates.
+    const int32_t firstDay = toDayNumber(spec.first_date);
+    auto randomDay = [&](size_t i) {
+        return firstDay + static_cast<int32_t>(LedgerGenerator::mix(spec.seed + i) % static_cast<uint64_t>(spec.span_days));
+    };
+    size_t sink = 0; // Keeps the results observable
+    Result byDay = timeQueries("getExpensesByDay", rows, options, [&](size_t i) {
+        sink += manager.getExpensesByDay(fromDayNumber(randomDay(i))).size();
+    });
+    reporter.record(byDay);
+    Result byMonth = timeQueries("getExpensesByMonth", rows, options, [&](size_t i) {
+        const Date date = fromDayNumber(randomDay(i));
+        sink += manager.getExpensesByMonth(date.month, date.year).size();
+    });
+    reporter.record(byMonth);
+    Result byYear = timeQueries("getExpensesByYear", rows, options, [&](size_t i) {
+        sink += manager.getExpensesByYear(fromDayNumber(randomDay(i)).year).size();
+    });
+    reporter.record(byYear);
+    Result byRange = timeQueries("getExpensesByDateRange", rows, options, [&](size_t i) {
+        const int32_t start = randomDay(i);
+        const int32_t length = static_cast<int32_t>(LedgerGenerator::mix(~i) % 31); // Up to a month
+        sink += manager.getExpensesByDateRange(fromDayNumber(start), fromDayNumber(start + length)).size();
+    });
+    reporter.record(byRange);
+
+    Result save{"saveExpenses", rows, {}, 0};
+    for (int r = 0; r < options.repeat; ++r) {
+        timeOnce(save, [&] { manager.saveExpenses(savedName); });
+        save.items += manager.getAllExpenses().size();
+    }
+    reporter.record(save);
+
+    // New rows continue the generated ledger after its last row.
+    std::vector<Expense> additions;
+    additions.reserve(options.mutations);
+    LedgerSpec extended = spec;
+    extended.rows = rows + options.mutations;
+    const LedgerGenerator tail(extended);
+    for (size_t i = 0; i < options.mutations; ++i) {
+        additions.push_back(tail.expense(rows + i));
+    }
+    Result add{"addExpense", rows, {}, 0};
+    add.latencies_ns.reserve(options.mutations);
+    for (const Expense& expense : additions) {
+        timeOnce(add, [&] { manager.addExpense(expense); });
+        ++add.items;
+    }
+    reporter.record(add);
+
+    Result erase{"deleteExpense", rows, {}, 0};
+    erase.latencies_ns.reserve(options.mutations);
+    for (size_t i = 0; i < options.mutations; ++i) {
+        const size_t live = manager.store().liveCount();
+        if (live == 0) {
+            break;
+        }
+        const size_t index = LedgerGenerator::mix(spec.seed ^ (i + 1)) % live;
+        timeOnce(erase, [&] { manager.deleteExpense(index); });
+        ++erase.items;
+    }
+    reporter.record(erase);
+
+    if (sink == 0) {
+        std::cerr << "Warning: every query returned no rows" << std::endl;
+    }
+    if (!options.keep) {
+        std::remove(("data/" + filename).c_str());
+        std::remove(("data/" + savedName).c_str());
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 2;
+    }
+    mkdir("data", 0755); // ExpenseManager reads and writes under data/
+
+    std::FILE* out = stdout;
+    if (!options.output.empty()) {
+        out = std::fopen(options.output.c_str(), "w");
+        if (!out) {
+            std::cerr << "Error: Could not open output file: " << options.output << std::endl;
+            return 1;
+        }
+    }
+    Reporter reporter(out, options.json);
+    reporter.config(options);
+    for (size_t rows : options.rows) {
+        benchLedger(rows, options, reporter);
+    }
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    return 0;
+}
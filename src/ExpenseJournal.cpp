@@ -0,0 +1,371 @@
+#include "ExpenseJournal.h"
+#include "AtomicFile.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace expense_tracker {
+
+namespace {
+
+constexpr char kJournalMagic[8] = {'E', 'X', 'P', 'J', 'R', 'N', 'L', '\0'};
+constexpr uint32_t kJournalVersion = 1;
+
+enum RecordType : uint8_t {
+    kAddRecord = 1,    // uint64 id, int32 day, double amount, uint8 type, varint+bytes description, varint+bytes category
+    kDeleteRecord = 2, // uint64 id
+};
+
+struct JournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t base_size;
+    int64_t base_mtime_ns;
+    // Set by prepareRebase: the base being moved into place and the offset
+    // of the first record it does not hold (0 if none is pending).
+    uint64_t next_base_size;
+    int64_t next_base_mtime_ns;
+    uint64_t next_offset;
+};
+
+// Standard CRC-32 (IEEE 802.3), table-driven.
+uint32_t crc32(const char* data, size_t size) {
+    static const std::vector<uint32_t> table = [] {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+void put(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putString(std::string& out, std::string_view text) {
+    uint64_t length = text.size();
+    while (length >= 0x80) {
+        out.push_back(static_cast<char>((length & 0x7F) | 0x80));
+        length >>= 7;
+    }
+    out.push_back(static_cast<char>(length));
+    out.append(text.data(), text.size());
+}
+
+// Bounds-checked reader over one record payload.
+class PayloadReader {
+public:
+    PayloadReader(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+    template <typename T>
+    bool get(T& value) {
+        if (static_cast<size_t>(end_ - p_) < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, p_, sizeof(T));
+        p_ += sizeof(T);
+        return true;
+    }
+
+    bool getString(std::string_view& text) {
+        uint64_t length = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p_ == end_) {
+                return false;
+            }
+            const auto byte = static_cast<unsigned char>(*p_++);
+            length |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                if (length > static_cast<uint64_t>(end_ - p_)) {
+                    return false;
+                }
+                text = std::string_view(p_, static_cast<size_t>(length));
+                p_ += length;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool atEnd() const { return p_ == end_; }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// addExpense only journals kNoDayNumber or a day packed from a real calendar
+// date, and every such day round-trips through fromDayNumber. Anything else
+// (the store's tombstone marker, a value fromDayNumber would overflow on) is a
+// corrupt record rather than a date to roll over.
+bool isRecordedDay(int32_t day) {
+    constexpr int32_t kMaxDay = std::numeric_limits<int32_t>::max() - 719468; // fromDayNumber's offset
+    if (day == kNoDayNumber) {
+        return true;
+    }
+    if (day <= kNoDayNumber + 146097 || day > kMaxDay) {
+        return false;
+    }
+    const Date date = fromDayNumber(day);
+    return toDayNumber(date) == day;
+}
+
+} // namespace
+
+ExpenseJournal::~ExpenseJournal() {
+    close();
+}
+
+uint64_t ExpenseJournal::headerSize() {
+    return sizeof(JournalHeader);
+}
+
+bool ExpenseJournal::open(const std::string& path, const SourceStamp& base, const AddHandler& onAdd,
+                          const DeleteHandler& onDelete) {
+    close();
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Error: Could not open journal file: " << path << std::endl;
+        return false;
+    }
+    path_ = path;
+
+    struct stat info;
+    std::vector<char> contents;
+    if (fstat(fd_, &info) == 0 && info.st_size > 0) {
+        contents.resize(static_cast<size_t>(info.st_size));
+        if (pread(fd_, contents.data(), contents.size(), 0) != static_cast<ssize_t>(contents.size())) {
+            contents.clear();
+        }
+    }
+
+    JournalHeader header{};
+    bool matches = false;
+    bool rebased = false; // Base is the one prepareRebase named: replay from next_offset
+    if (contents.size() >= sizeof(header)) {
+        std::memcpy(&header, contents.data(), sizeof(header));
+        const bool known = std::memcmp(header.magic, kJournalMagic, sizeof(kJournalMagic)) == 0 &&
+                           header.version == kJournalVersion;
+        rebased = known && header.next_offset >= sizeof(header) && header.next_offset <= contents.size() &&
+                  header.next_base_size == base.size && header.next_base_mtime_ns == base.mtime_ns;
+        matches = rebased || (known && header.base_size == base.size && header.base_mtime_ns == base.mtime_ns);
+    }
+    if (!matches) {
+        if (contents.size() > sizeof(header)) {
+            std::cout << "Info: Discarding journal that does not match its base file: " << path << std::endl;
+        }
+        return reset(base);
+    }
+
+    // Replay every complete, verified record; stop at the first torn one.
+    size_t offset = rebased ? static_cast<size_t>(header.next_offset) : sizeof(header);
+    size_t replayed = 0;
+    while (contents.size() - offset >= 2 * sizeof(uint32_t)) {
+        uint32_t length, checksum;
+        std::memcpy(&length, contents.data() + offset, sizeof(length));
+        std::memcpy(&checksum, contents.data() + offset + sizeof(length), sizeof(checksum));
+        const size_t payloadStart = offset + 2 * sizeof(uint32_t);
+        if (length > contents.size() - payloadStart || crc32(contents.data() + payloadStart, length) != checksum) {
+            break;
+        }
+
+        PayloadReader reader(contents.data() + payloadStart, length);
+        uint8_t type = 0;
+        bool ok = reader.get(type);
+        if (ok && type == kAddRecord) {
+            ExpenseId id;
+            int32_t day;
+            double amount;
+            uint8_t transactionType;
+            std::string_view description, category;
+            ok = reader.get(id) && reader.get(day) && reader.get(amount) && reader.get(transactionType) &&
+                 reader.getString(description) && reader.getString(category) && reader.atEnd() &&
+                 isRecordedDay(day);
+            if (ok) {
+                onAdd(id, description, amount, day, category, static_cast<TransactionType>(transactionType));
+            }
+        } else if (ok && type == kDeleteRecord) {
+            ExpenseId id;
+            ok = reader.get(id) && reader.atEnd();
+            if (ok) {
+                onDelete(id);
+            }
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            break;
+        }
+        offset = payloadStart + length;
+        ++replayed;
+    }
+
+    if (offset < contents.size()) {
+        std::cerr << "Warning: Journal " << path << " has a torn or corrupt tail after " << replayed
+                  << " record(s); truncating it." << std::endl;
+        if (ftruncate(fd_, static_cast<off_t>(offset)) != 0) {
+            std::cerr << "Error: Could not truncate journal file: " << path << std::endl;
+            close();
+            return false;
+        }
+    }
+    size_ = offset;
+    lseek(fd_, static_cast<off_t>(size_), SEEK_SET);
+    // A compaction stopped between moving the base and rewriting the journal;
+    // finish it, so the records before the offset are dropped for good.
+    return !rebased || rebase(base, header.next_offset);
+}
+
+void ExpenseJournal::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+bool ExpenseJournal::appendAdd(ExpenseId id, std::string_view description, double amount, int32_t dayNumber,
+                               std::string_view category, TransactionType type) {
+    std::string payload;
+    payload.reserve(32 + description.size() + category.size());
+    put(payload, static_cast<uint8_t>(kAddRecord));
+    put(payload, id);
+    put(payload, dayNumber);
+    put(payload, amount);
+    put(payload, static_cast<uint8_t>(type));
+    putString(payload, description);
+    putString(payload, category);
+    return appendRecord(payload);
+}
+
+bool ExpenseJournal::appendDelete(ExpenseId id) {
+    std::string payload;
+    put(payload, static_cast<uint8_t>(kDeleteRecord));
+    put(payload, id);
+    return appendRecord(payload);
+}
+
+bool ExpenseJournal::appendRecord(const std::string& payload) {
+    if (fd_ < 0) {
+        return false;
+    }
+    std::string record;
+    record.reserve(2 * sizeof(uint32_t) + payload.size());
+    put(record, static_cast<uint32_t>(payload.size()));
+    put(record, crc32(payload.data(), payload.size()));
+    record += payload;
+    // One write per record: a crash leaves at most this record torn.
+    if (!writeAll(fd_, record.data(), record.size())) {
+        std::cerr << "Error: Could not append to journal file: " << path_ << std::endl;
+        return false;
+    }
+    size_ += record.size();
+    return true;
+}
+
+bool ExpenseJournal::sync() {
+    return fd_ >= 0 && fsync(fd_) == 0;
+}
+
+bool ExpenseJournal::reset(const SourceStamp& base) {
+    if (fd_ < 0) {
+        return false;
+    }
+    if (ftruncate(fd_, 0) != 0 || lseek(fd_, 0, SEEK_SET) != 0 || !writeHeader(fd_, base) || fsync(fd_) != 0) {
+        std::cerr << "Error: Could not reset journal file: " << path_ << std::endl;
+        return false;
+    }
+    size_ = headerSize();
+    return true;
+}
+
+bool ExpenseJournal::prepareRebase(const SourceStamp& next, uint64_t offset) {
+    if (fd_ < 0 || offset < headerSize() || offset > size_) {
+        return false;
+    }
+    JournalHeader header{};
+    if (pread(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+        return false;
+    }
+    header.next_base_size = next.size;
+    header.next_base_mtime_ns = next.mtime_ns;
+    header.next_offset = offset;
+    if (pwrite(fd_, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) || fsync(fd_) != 0) {
+        std::cerr << "Error: Could not update journal header: " << path_ << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ExpenseJournal::rebase(const SourceStamp& next, uint64_t offset) {
+    if (fd_ < 0 || offset < headerSize() || offset > size_) {
+        return false;
+    }
+    std::vector<char> records(static_cast<size_t>(size_ - offset));
+    if (!records.empty() &&
+        pread(fd_, records.data(), records.size(), static_cast<off_t>(offset)) != static_cast<ssize_t>(records.size())) {
+        std::cerr << "Error: Could not read journal file: " << path_ << std::endl;
+        return false;
+    }
+    // Written beside the journal and moved over it, so a crash leaves either
+    // the prepared journal or the rebased one.
+    const std::string tempPath = path_ + ".tmp";
+    const int fd = ::open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open journal file for writing: " << tempPath << std::endl;
+        return false;
+    }
+    const bool written = writeHeader(fd, next) && writeAll(fd, records.data(), records.size());
+    if (!written || !replaceFile(tempPath, path_)) {
+        std::cerr << "Error: Could not rewrite journal file: " << path_ << std::endl;
+        ::close(fd);
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    ::close(fd_);
+    fd_ = fd;
+    size_ = headerSize() + records.size();
+    lseek(fd_, static_cast<off_t>(size_), SEEK_SET);
+    return true;
+}
+
+bool ExpenseJournal::writeHeader(int fd, const SourceStamp& base) {
+    JournalHeader header{};
+    std::memcpy(header.magic, kJournalMagic, sizeof(kJournalMagic));
+    header.version = kJournalVersion;
+    header.base_size = base.size;
+    header.base_mtime_ns = base.mtime_ns;
+    return writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+} // namespace expense_tracker
@@ -1,193 +1,1273 @@
 #include "ExpenseManager.h"
+#include "AtomicFile.h"
+#include "Snapshot.h"
+#include "CsvCodec.h"
+#include "ExpenseSegment.h"
 #include <algorithm> // For std::remove_if if needed, or for sorting later
 #include <iostream>  // For viewExpensesSummary and potential error messages
 #include <fstream>   // For load/save
 #include <sstream>   // For parsing lines in load/save
-#include "fmt/core.h"
 #include "csv.h" // From fast-cpp-csv-parser
 
 // For date parsing - will use the 'date' library once linked.
 // For now, a simple placeholder or direct parsing.
 #include "date/date.h" // Assuming this will be available via Conan
 
+#include <cmath>
+#include <cerrno>
+#include <cstdio>
+#include <iterator>
+#include <unordered_map>
+#include <sys/stat.h>
+
 namespace expense_tracker {
 
+namespace {
+
+// Journals smaller than this are never worth compacting.
+constexpr uint64_t kJournalCompactionBytes = uint64_t{4} << 20;
+
+// Distinct partitions of the rows in a flushed date index, in key order.
+std::vector<PartitionCatalog::Key> partitionKeys(const DateIndex& index) {
+    std::vector<PartitionCatalog::Key> keys;
+    int32_t lastDay = ExpenseStore::kTombstoneDay; // Not in the index
+    for (size_t i = 0; i < index.sortedSize(); ++i) {
+        const int32_t day = index.keys()[i];
+        if (day == lastDay) {
+            continue;
+        }
+        lastDay = day;
+        const PartitionCatalog::Key key = PartitionCatalog::keyForDay(day);
+        if (keys.empty() || keys.back() != key) {
+            keys.push_back(key);
+        }
+    }
+    return keys;
+}
+
+} // namespace
+
 ExpenseManager::ExpenseManager() {
     // Initialize data_filename_, perhaps with a default
     // For now, it can be set when load/save are called.
+
+    // Readers always find a published snapshot, so they never have to wait
+    // for the first one.
+    published_ = std::shared_ptr<const ExpenseManager>(new ExpenseManager(*this, SnapshotTag{}));
 }
 
-void ExpenseManager::addExpense(const Expense& expense) {
-    expenses_.push_back(expense);
+ExpenseManager::ExpenseManager(const ExpenseManager& source, SnapshotTag)
+    : store_(source.store_.share()),
+      date_index_(source.date_index_),
+      rollups_(source.rollups_),
+      text_index_(source.text_index_),
+      scan_executor_(source.scan_executor_),
+      data_filename_(source.data_filename_),
+      snapshot_cache_(source.snapshot_cache_),
+      ingest_threads_(source.ingest_threads_),
+      journal_base_path_(source.journal_base_path_),
+      partitioned_(source.partitioned_),
+      snapshot_version_(source.version_.load(std::memory_order_acquire)),
+      is_snapshot_(true),
+      stats_(source.stats_) {
+    // The copy is still private to this thread: apply buffered index updates
+    // now so lookups on the published snapshot never write.
+    date_index_.flush();
+    if (partitioned_) {
+        for (const auto& entry : source.partitions_.partitions()) {
+            if (entry.second.on_disk && !entry.second.resident) {
+                missing_partitions_.push_back(entry.first);
+            }
+        }
+    }
+}
+
+ExpenseManager::~ExpenseManager() {
+    stopWatching();
+    stopAutosave();
+    waitForSaves();
+}
+
+std::shared_ptr<const ExpenseManager> ExpenseManager::readSnapshot() const {
+    if (is_snapshot_) {
+        return std::shared_ptr<const ExpenseManager>(new ExpenseManager(*this, SnapshotTag{}));
+    }
+    std::shared_ptr<const ExpenseManager> snapshot = std::atomic_load(&published_);
+    if (snapshot->snapshot_version_ == version_.load(std::memory_order_acquire)) {
+        return snapshot;
+    }
+    std::unique_lock<std::mutex> lock(writer_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return snapshot; // The writer is busy: serve the last completed state
+    }
+    return publishSnapshot();
+}
+
+std::shared_ptr<const ExpenseManager> ExpenseManager::publishSnapshot() const {
+    // Another reader may have published while this one took the lock.
+    std::shared_ptr<const ExpenseManager> snapshot = std::atomic_load(&published_);
+    if (snapshot->snapshot_version_ != version_.load(std::memory_order_acquire)) {
+        OperationTimer timer(*stats_, Operation::kSnapshot);
+        snapshot = std::shared_ptr<const ExpenseManager>(new ExpenseManager(*this, SnapshotTag{}));
+        std::atomic_store(&published_, snapshot);
+    }
+    return snapshot;
+}
+
+ExpenseId ExpenseManager::addExpense(const Expense& expense) {
+    WriteLock lock(*this);
+    OperationTimer timer(*stats_, Operation::kAdd);
+    const Date& date = expense.date;
+    if (!isStorableDate(date)) {
+        std::cerr << "Error: Invalid date " << date.year << "-" << date.month << "-" << date.day
+                  << "; expense not added." << std::endl;
+        return kNoExpenseId;
+    }
+    if (!std::isfinite(expense.amount)) {
+        // A NaN or infinity would stick in every rollup bucket it touches.
+        std::cerr << "Error: Invalid amount " << expense.amount << "; expense not added." << std::endl;
+        return kNoExpenseId;
+    }
+    const int32_t day = toDayNumber(date);
+    if (partitioned_) {
+        // The month is rewritten whole on save, so its saved rows must be in.
+        loadPartitions(partitions_.touch(day, day));
+        partitions_.markDirty(day);
+    }
+    std::string descriptionScratch, categoryScratch;
+    const std::string_view description = singleLineText(expense.description, descriptionScratch);
+    const std::string_view category = singleLineText(expense.category, categoryScratch);
+    const ExpenseId id = appendRow(description, expense.amount, day, category, expense.transaction_type, kNoExpenseId);
+    journalAdd(id, description, expense.amount, day, category, expense.transaction_type);
+    return id;
 }
 
 bool ExpenseManager::deleteExpense(size_t index) {
-    if (index < expenses_.size()) {
-        expenses_.erase(expenses_.begin() + index);
+    WriteLock lock(*this);
+    OperationTimer timer(*stats_, Operation::kDelete);
+    if (partitioned_) {
+        loadPartitions(partitions_.touch(kNoDayNumber, ExpenseStore::kTombstoneDay - 1));
+    }
+    if (index < store_.liveCount()) {
+        if (store_.deadCount() > 0) {
+            ensureLiveRows();
+            deleteRow(live_rows_[index]);
+        } else {
+            deleteRow(index);
+        }
         return true;
     }
     return false; // Index out of bounds
 }
 
-const std::vector<Expense>& ExpenseManager::getAllExpenses() const {
-    return expenses_;
+bool ExpenseManager::deleteExpenseById(ExpenseId id) {
+    WriteLock lock(*this);
+    OperationTimer timer(*stats_, Operation::kDelete);
+    size_t row;
+    bool found = store_.findRow(id, row);
+    if (!found && partitioned_) {
+        // Not in a resident month; it may be in any of the others.
+        loadPartitions(partitions_.touch(kNoDayNumber, ExpenseStore::kTombstoneDay - 1));
+        found = store_.findRow(id, row);
+    }
+    if (!found) {
+        return false;
+    }
+    deleteRow(row);
+    return true;
+}
+
+void ExpenseManager::deleteRow(size_t row) {
+    journalDelete(store_.idAt(row));
+    if (partitioned_) {
+        partitions_.markDirty(store_.dayNumberAt(row));
+    }
+    tombstoneRow(row);
+    compactIfSparse();
+}
+
+void ExpenseManager::journalAdd(ExpenseId id, std::string_view description, double amount, int32_t dayNumber,
+                                std::string_view category, TransactionType type) {
+    if (journal_ && !journal_broken_ &&
+        !journal_->appendAdd(id, description, amount, dayNumber, category, type)) {
+        markJournalBroken();
+    }
+}
+
+void ExpenseManager::journalDelete(ExpenseId id) {
+    if (journal_ && !journal_broken_ && !journal_->appendDelete(id)) {
+        markJournalBroken();
+    }
+}
+
+void ExpenseManager::markJournalBroken() {
+    journal_broken_ = true;
+    std::cerr << "Warning: Changes are no longer journaled; the next save rewrites " << journal_base_path_
+              << " in full." << std::endl;
+}
+
+bool ExpenseManager::findExpenseById(ExpenseId id, ExpenseRow& expense) const {
+    ensureAllResident(); // Ids say nothing about the month
+    size_t row;
+    if (!store_.findRow(id, row)) {
+        return false;
+    }
+    expense = store_.row(row);
+    return true;
+}
+
+void ExpenseManager::compact() {
+    WriteLock lock(*this);
+    OperationTimer timer(*stats_, Operation::kCompact);
+    timer.rows(store_.size(), store_.liveCount());
+    compactRows();
+}
+
+void ExpenseManager::compactRows() {
+    if (store_.deadCount() == 0) {
+        return;
+    }
+    std::vector<RowId> newRows;
+    if (text_index_) {
+        text_index_ = text_index_->compacted(store_); // Needs the tombstones, so first
+    }
+    store_.compact(&newRows);
+    date_index_.renumber(newRows);
+    live_rows_.clear();
+    live_rows_valid_ = false;
+}
+
+// Amortized O(1) per delete: a compaction costs O(n) and only happens after
+// at least n/2 deletes.
+void ExpenseManager::compactIfSparse() {
+    if (store_.deadCount() > store_.liveCount()) {
+        compactRows();
+    }
+}
+
+ExpenseId ExpenseManager::appendRow(std::string_view description, double amount, int32_t dayNumber,
+                                    std::string_view category, TransactionType type, ExpenseId id) {
+    id = store_.append(description, amount, dayNumber, category, type, id);
+    indexLastRow();
+    return id;
+}
+
+void ExpenseManager::restoreRow(std::string_view description, double amount, int32_t dayNumber,
+                                std::string_view category, TransactionType type, ExpenseId id) {
+    store_.restore(description, amount, dayNumber, category, type, id);
+    indexLastRow();
+}
+
+void ExpenseManager::indexLastRow() {
+    const size_t row = store_.size() - 1;
+    date_index_.insert(static_cast<RowId>(row), store_.dayNumberAt(row));
+    if (text_index_) {
+        text_index_->add(static_cast<RowId>(row), store_.descriptionAt(row));
+    }
+    rollups_.add(store_.dayNumberAt(row), store_.categoryIdAt(row), store_.amountAt(row));
+    if (live_rows_valid_) {
+        live_rows_.push_back(static_cast<RowId>(row));
+    }
+}
+
+void ExpenseManager::tombstoneRow(size_t row) {
+    // The date index keeps the row's entry until compaction (see DateIndex).
+    rollups_.remove(store_.dayNumberAt(row), store_.categoryIdAt(row), store_.amountAt(row));
+    store_.tombstone(row);
+    // Erasing the row from the list would shift every later entry; only
+    // positional access (getAllExpenses, deleteExpense(index)) needs the list,
+    // so it is rebuilt there on next use instead.
+    live_rows_valid_ = false;
+}
+
+void ExpenseManager::ensureLiveRows() const {
+    if (is_snapshot_) {
+        // Several readers may ask at once; exactly one builds the list.
+        std::call_once(live_rows_once_, [this] { buildLiveRows(); });
+        return;
+    }
+    if (!live_rows_valid_) {
+        buildLiveRows();
+    }
+}
+
+void ExpenseManager::buildLiveRows() const {
+    live_rows_.clear();
+    live_rows_.reserve(store_.liveCount());
+    for (size_t row = 0; row < store_.size(); ++row) {
+        if (store_.isLive(row)) {
+            live_rows_.push_back(static_cast<RowId>(row));
+        }
+    }
+    live_rows_valid_ = true;
+}
+
+ExpenseView ExpenseManager::getAllExpenses() const {
+    ensureAllResident();
+    if (store_.deadCount() == 0) {
+        return store_.rows();
+    }
+    ensureLiveRows();
+    return ExpenseView(&store_, live_rows_.data(), live_rows_.size());
+}
+
+void ExpenseManager::rebuildIndexes() {
+    // Only called after a load, when the store has no tombstones.
+    date_index_.rebuild(store_.dayNumbers());
+    rollups_.rebuild(store_);
 }
 
 // Placeholder for viewExpensesSummary - will be detailed later
 void ExpenseManager::viewExpensesSummary() const {
-    if (expenses_.empty()) {
+    const ExpenseView expenses = getAllExpenses();
+    if (expenses.empty()) {
         std::cout << "No expenses recorded." << std::endl;
         return;
     }
     std::cout << "--- All Expenses ---" << std::endl;
-    for (size_t i = 0; i < expenses_.size(); ++i) {
-        const auto& exp = expenses_[i];
-        std::cout << i << ". "
+    for (const ExpenseRow exp : expenses) {
+        std::cout << "#" << exp.id << " "
                   << exp.date << " | "
                   << exp.description << " | $"
                   << exp.amount << " | "
                   << exp.category << " | "
                   << (exp.transaction_type == TransactionType::CREDIT ? "Credit" : "Cash")
-                  << std::endl;
+                  << '\n'; // One flush at the end, not one per row
     }
     std::cout << "--------------------" << std::endl;
 }
 
 
 // Date parsing helper: "YYYY-MM-DD"
-Date ExpenseManager::parseDateString(const std::string& dateStr) const {
+Date ExpenseManager::parseDateString(std::string_view dateStr) const {
     Date date{};
-    if (dateStr.length() == 10 && dateStr[4] == '-' && dateStr[7] == '-') {
-        std::string Y = dateStr.substr(0, 4);
-        std::string M = dateStr.substr(5, 2);
-        std::string D = dateStr.substr(8, 2);
-        try {
-            date.year = std::stoi(Y);
-            date.month = std::stoi(M);
-            date.day = std::stoi(D);
+    parseIsoDate(dateStr, date); // Leaves the zeroed date if the format or calendar date is wrong
+    return date;
+}
 
-            // Basic validation, can be improved with date library
-            if (date.month < 1 || date.month > 12 || date.day < 1 || date.day > 31) {
-                 // Invalid date, return a default or throw an error
-                 // For now, returning a zeroed date.
-                 return Date{};
+
+// Each date filter below becomes an inclusive [firstDay, lastDay] range of packed
+// day numbers, answered by two binary searches in the date index and a walk over
+// the matching slice; other columns are touched only for matching rows.
+
+namespace {
+
+// A month outside 1..12 yields an empty range (firstDay > lastDay) that also
+// overlaps no partition, rather than normalizing into a neighbouring month.
+void monthDayRange(int year, int month, int32_t& firstDay, int32_t& lastDay) {
+    if (month < 1 || month > 12) {
+        firstDay = std::numeric_limits<int32_t>::max();
+        lastDay = std::numeric_limits<int32_t>::min();
+        return;
+    }
+    firstDay = toDayNumber(year, month, 1);
+    lastDay = (month == 12 ? toDayNumber(year + 1, 1, 1) : toDayNumber(year, month + 1, 1)) - 1;
+}
+
+} // namespace
+
+void ExpenseManager::flushDateIndex() const {
+    // A snapshot's index is flushed when it is built, so this never locks there.
+    if (date_index_.hasPending()) {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        date_index_.flush();
+    }
+}
+
+ExpenseView ExpenseManager::viewDayRange(int32_t firstDay, int32_t lastDay) const {
+    flushDateIndex();
+    const auto range = date_index_.findRange(firstDay, lastDay);
+    const ChunkedColumn<RowId>& rows = date_index_.rows();
+    // Deleted rows keep their index entries until compaction, so a slice that
+    // holds any is copied without them; otherwise the view is the slice itself.
+    if (store_.deadCount() > 0) {
+        for (size_t i = range.first; i < range.second; ++i) {
+            if (store_.isLive(rows[i])) {
+                continue;
             }
-        } catch (const std::invalid_argument& ia) {
-            // std::cerr << "Invalid date string format: " << dateStr << std::endl;
-            return Date{}; // Return a default/invalid date
-        } catch (const std::out_of_range& oor) {
-            // std::cerr << "Date string value out of range: " << dateStr << std::endl;
-            return Date{}; // Return a default/invalid date
+            auto live = std::make_shared<std::vector<RowId>>();
+            live->reserve(range.second - range.first);
+            for (size_t j = range.first; j < range.second; ++j) {
+                if (store_.isLive(rows[j])) {
+                    live->push_back(rows[j]);
+                }
+            }
+            return ExpenseView(&store_, std::move(live));
         }
     }
-    return date; // Return potentially zeroed date if format is wrong
+    return ExpenseView(&store_, &rows, range.first, range.second);
 }
 
+// An impossible date (2024-02-30) gives firstDay > lastDay, which matches nothing.
+ExpenseView ExpenseManager::findExpensesByDay(const Date& date) const {
+    return timedDayRange(Operation::kQueryDay, firstDayOnOrAfter(date), lastDayOnOrBefore(date));
+}
 
-// Implementations for loadExpenses, saveExpenses, and other summarization functions
-// will be added in subsequent steps.
+ExpenseView ExpenseManager::findExpensesByMonth(int month, int year) const {
+    int32_t firstDay, lastDay;
+    monthDayRange(year, month, firstDay, lastDay);
+    return timedDayRange(Operation::kQueryMonth, firstDay, lastDay);
+}
 
-// For now, basic implementations of summarization functions returning empty vectors
-// or delegating to viewExpensesSummary to allow compilation.
+ExpenseView ExpenseManager::findExpensesByYear(int year) const {
+    return timedDayRange(Operation::kQueryYear, toDayNumber(year, 1, 1), toDayNumber(year + 1, 1, 1) - 1);
+}
 
+ExpenseView ExpenseManager::findExpensesByDateRange(const Date& startDate, const Date& endDate) const {
+    // Packed day numbers compare in calendar order, so the old (Y,M,D) tuple
+    // comparison collapses into a single index range; bounds that name no real
+    // day are clamped the way that comparison treated them.
+    return timedDayRange(Operation::kQueryRange, firstDayOnOrAfter(startDate), lastDayOnOrBefore(endDate));
+}
+
+// The copying variants are timed as a whole, copy included, under the same
+// operation as their find* counterpart.
 std::vector<Expense> ExpenseManager::getExpensesByDay(const Date& date) const {
-    std::vector<Expense> result;
-    // Logic to filter expenses by day
-    for (const auto& exp : expenses_) {
-        if (exp.date.year == date.year && exp.date.month == date.month && exp.date.day == date.day) {
-            result.push_back(exp);
+    return copyDayRange(Operation::kQueryDay, firstDayOnOrAfter(date), lastDayOnOrBefore(date));
+}
+
+std::vector<Expense> ExpenseManager::getExpensesByMonth(int month, int year) const {
+    int32_t firstDay, lastDay;
+    monthDayRange(year, month, firstDay, lastDay);
+    return copyDayRange(Operation::kQueryMonth, firstDay, lastDay);
+}
+
+std::vector<Expense> ExpenseManager::getExpensesByYear(int year) const {
+    return copyDayRange(Operation::kQueryYear, toDayNumber(year, 1, 1), toDayNumber(year + 1, 1, 1) - 1);
+}
+
+std::vector<Expense> ExpenseManager::getExpensesByDateRange(const Date& startDate, const Date& endDate) const {
+    return copyDayRange(Operation::kQueryRange, firstDayOnOrAfter(startDate), lastDayOnOrBefore(endDate));
+}
+
+ExpenseView ExpenseManager::timedDayRange(Operation op, int32_t firstDay, int32_t lastDay) const {
+    OperationTimer timer(*stats_, op);
+    ensureResident(firstDay, lastDay);
+    const ExpenseView view = viewDayRange(firstDay, lastDay);
+    timer.rows(view.size(), view.size()); // The index slice holds exactly the matches
+    return view;
+}
+
+std::vector<Expense> ExpenseManager::copyDayRange(Operation op, int32_t firstDay, int32_t lastDay) const {
+    OperationTimer timer(*stats_, op);
+    ensureResident(firstDay, lastDay);
+    const ExpenseView view = viewDayRange(firstDay, lastDay);
+    if (!scan_executor_ || !scan_executor_->shouldSplit(view.size())) {
+        std::vector<Expense> expenses = view.toVector();
+        timer.rows(expenses.size(), expenses.size());
+        return expenses;
+    }
+    // Copying a wide range is string allocation bound, so the slice is
+    // copied in morsels on the scan workers, then moved into place in order.
+    const size_t morsels = (view.size() + ScanExecutor::kMorselRows - 1) / ScanExecutor::kMorselRows;
+    std::vector<std::vector<Expense>> parts(morsels);
+    scan_executor_->run(morsels, [&](size_t morsel, size_t) {
+        const size_t begin = view.size() * morsel / morsels;
+        const size_t end = view.size() * (morsel + 1) / morsels;
+        parts[morsel].reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            parts[morsel].push_back(view[i].toExpense());
         }
+    });
+    std::vector<Expense> expenses;
+    expenses.reserve(view.size());
+    for (std::vector<Expense>& part : parts) {
+        std::move(part.begin(), part.end(), std::back_inserter(expenses));
     }
-    return result;
+    timer.rows(expenses.size(), expenses.size());
+    return expenses;
 }
 
-std::vector<Expense> ExpenseManager::getExpensesByMonth(int month, int year) const {
-    std::vector<Expense> result;
-    // Logic to filter expenses by month and year
-    for (const auto& exp : expenses_) {
-        if (exp.date.year == year && exp.date.month == month) {
-            result.push_back(exp);
+
+bool ExpenseManager::clampDayRange(int32_t& firstDay, int32_t& lastDay) const {
+    flushDateIndex();
+    const auto range = date_index_.findRange(firstDay, lastDay);
+    if (range.first == range.second) {
+        return false;
+    }
+    firstDay = date_index_.keys()[range.first];
+    lastDay = date_index_.keys()[range.second - 1];
+    return true;
+}
+
+ExpenseTotal ExpenseManager::totalForDay(const Date& date) const {
+    OperationTimer timer(*stats_, Operation::kTotal);
+    if (firstDayOnOrAfter(date) != lastDayOnOrBefore(date)) {
+        return ExpenseTotal{}; // No such day
+    }
+    const int32_t day = toDayNumber(date);
+    ensureResident(day, day);
+    return rollups_.forDay(day);
+}
+
+ExpenseTotal ExpenseManager::totalForMonth(int month, int year) const {
+    OperationTimer timer(*stats_, Operation::kTotal);
+    int32_t firstDay, lastDay;
+    monthDayRange(year, month, firstDay, lastDay);
+    ensureResident(firstDay, lastDay);
+    return rollups_.forMonth(month, year);
+}
+
+ExpenseTotal ExpenseManager::totalForYear(int year) const {
+    OperationTimer timer(*stats_, Operation::kTotal);
+    ensureResident(toDayNumber(year, 1, 1), toDayNumber(year + 1, 1, 1) - 1);
+    return rollups_.forYear(year);
+}
+
+ExpenseTotal ExpenseManager::totalForDateRange(const Date& startDate, const Date& endDate) const {
+    OperationTimer timer(*stats_, Operation::kTotal);
+    ExpenseTotal total;
+    int32_t day = firstDayOnOrAfter(startDate);
+    int32_t lastDay = lastDayOnOrBefore(endDate);
+    ensureResident(day, lastDay);
+    auto add = [&total](const ExpenseTotal& part) {
+        total.sum += part.sum;
+        total.count += part.count;
+    };
+    if (clampDayRange(day, lastDay) && day == kNoDayNumber) {
+        add(rollups_.forDay(kNoDayNumber));
+        day = kNoDayNumber + 1;
+    }
+    if (!clampDayRange(day, lastDay)) {
+        return total;
+    }
+
+    // Greedily take the largest rollup bucket that starts at `day` and fits.
+    while (day <= lastDay) {
+        const Date date = fromDayNumber(day);
+        if (date.day == 1) {
+            const int32_t yearEnd = toDayNumber(date.year + 1, 1, 1) - 1;
+            if (date.month == 1 && yearEnd <= lastDay) {
+                add(rollups_.forYear(date.year));
+                day = yearEnd + 1;
+                continue;
+            }
+            int32_t monthStart, monthEnd;
+            monthDayRange(date.year, date.month, monthStart, monthEnd);
+            if (monthEnd <= lastDay) {
+                add(rollups_.forMonth(date.month, date.year));
+                day = monthEnd + 1;
+                continue;
+            }
+        }
+        add(rollups_.forDay(day));
+        ++day;
+    }
+    return total;
+}
+
+std::vector<CategoryTotal> ExpenseManager::totalsByCategory(const Date& startDate, const Date& endDate) const {
+    OperationTimer timer(*stats_, Operation::kTotalsByCategory);
+    ensureResident(firstDayOnOrAfter(startDate), lastDayOnOrBefore(endDate));
+    std::vector<ExpenseTotal> byCategory(store_.categoryCount());
+    size_t scanned = 0;
+    auto addRows = [&](int32_t firstDay, int32_t lastDay) {
+        const ExpenseView rows = viewDayRange(firstDay, lastDay);
+        scanned += rows.size();
+        for (size_t i = 0; i < rows.size(); ++i) {
+            const size_t row = rows.rowId(i);
+            ExpenseTotal& total = byCategory[store_.categoryIdAt(row)];
+            total.sum += store_.amountAt(row);
+            ++total.count;
         }
+    };
+
+    int32_t day = firstDayOnOrAfter(startDate);
+    int32_t lastDay = lastDayOnOrBefore(endDate);
+    if (clampDayRange(day, lastDay) && day == kNoDayNumber) {
+        addRows(kNoDayNumber, kNoDayNumber);
+        day = kNoDayNumber + 1;
     }
+    if (clampDayRange(day, lastDay)) {
+        while (day <= lastDay) {
+            const Date date = fromDayNumber(day);
+            int32_t monthStart, monthEnd;
+            monthDayRange(date.year, date.month, monthStart, monthEnd);
+            if (day == monthStart && monthEnd <= lastDay) {
+                if (const auto* month = rollups_.forMonthByCategory(date.month, date.year)) {
+                    for (size_t id = 0; id < month->size(); ++id) {
+                        byCategory[id].sum += (*month)[id].sum;
+                        byCategory[id].count += (*month)[id].count;
+                    }
+                }
+            } else {
+                addRows(day, std::min(monthEnd, lastDay));
+            }
+            day = monthEnd + 1;
+        }
+    }
+
+    std::vector<CategoryTotal> result;
+    for (size_t id = 0; id < byCategory.size(); ++id) {
+        if (byCategory[id].count > 0) {
+            result.push_back(CategoryTotal{store_.categoryName(static_cast<CategoryId>(id)), byCategory[id]});
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const CategoryTotal& a, const CategoryTotal& b) {
+        return a.total.sum > b.total.sum;
+    });
+    timer.rows(scanned, result.size());
     return result;
 }
 
-std::vector<Expense> ExpenseManager::getExpensesByYear(int year) const {
-    std::vector<Expense> result;
-    // Logic to filter expenses by year
-    for (const auto& exp : expenses_) {
-        if (exp.date.year == year) {
-            result.push_back(exp);
+
+// The date and amount columns share the same chunking, so each chunk pair is
+// handed to the kernel as two flat arrays.
+AmountAggregate ExpenseManager::aggregateDateRange(const Date& startDate, const Date& endDate) const {
+    OperationTimer timer(*stats_, Operation::kAggregate);
+    AmountAggregate result;
+    const int32_t firstDay = firstDayOnOrAfter(startDate);
+    const int32_t lastDay = lastDayOnOrBefore(endDate);
+    ensureResident(firstDay, lastDay);
+    const ChunkedColumn<int32_t>& days = store_.dayNumbers();
+    const ChunkedColumn<double>& amounts = store_.amounts();
+    if (scan_executor_ && scan_executor_->shouldSplit(store_.size())) {
+        // One chunk per morsel, folded in chunk order.
+        std::vector<AmountAggregate> parts(days.chunkCount());
+        scan_executor_->run(parts.size(), [&](size_t chunk, size_t) {
+            aggregateDayRange(days.chunkData(chunk), amounts.chunkData(chunk), days.chunkLength(chunk), firstDay,
+                              lastDay, parts[chunk]);
+        });
+        for (const AmountAggregate& part : parts) {
+            result.merge(part);
+        }
+    } else {
+        for (size_t chunk = 0; chunk < days.chunkCount(); ++chunk) {
+            aggregateDayRange(days.chunkData(chunk), amounts.chunkData(chunk), days.chunkLength(chunk), firstDay,
+                              lastDay, result);
         }
     }
+    timer.rows(store_.size(), result.count);
     return result;
 }
 
-std::vector<Expense> ExpenseManager::getExpensesByDateRange(const Date& startDate, const Date& endDate) const {
-    std::vector<Expense> result;
-    // Logic to filter expenses by date range.
-    // This requires comparing Date objects. For simplicity, we'll assume year/month/day comparison.
-    // A more robust solution would convert Dates to a comparable format (e.g., days since epoch).
-    for (const auto& exp : expenses_) {
-        // Simple comparison: (Y,M,D) tuple comparison
-        bool afterOrOnStart = (exp.date.year > startDate.year) ||
-                              (exp.date.year == startDate.year && exp.date.month > startDate.month) ||
-                              (exp.date.year == startDate.year && exp.date.month == startDate.month && exp.date.day >= startDate.day);
+QueryResult ExpenseManager::query(const ExpenseQuery& query) const {
+    OperationTimer timer(*stats_, Operation::kQuery);
+    ensureResident(query.firstDay(), query.lastDay());
+    flushDateIndex();
+    QueryPlan plan = planQuery(query, store_, date_index_, text_index_.get());
+    std::vector<RowId> rows;
+    const size_t scanned = selectRows(query, plan, store_, date_index_, rows, scan_executor_.get());
+    std::vector<RowId>().swap(plan.postings); // The result rows supersede the candidates
+    timer.rows(scanned, rows.size());
+    return QueryResult(&store_, std::move(rows), std::move(plan));
+}
+
+AmountAggregate ExpenseManager::aggregate(const ExpenseQuery& query) const {
+    OperationTimer timer(*stats_, Operation::kAggregate);
+    ensureResident(query.firstDay(), query.lastDay());
+    flushDateIndex();
+    AmountAggregate result;
+    const size_t scanned = aggregateRows(query, planQuery(query, store_, date_index_, text_index_.get()), store_,
+                                         date_index_, result, scan_executor_.get());
+    timer.rows(scanned, result.count);
+    return result;
+}
+
+std::vector<GroupRow> ExpenseManager::groupBy(const GroupBySpec& spec) const {
+    OperationTimer timer(*stats_, Operation::kGroupBy);
+    ensureResident(spec.filter.firstDay(), spec.filter.lastDay());
+    flushDateIndex();
+    size_t scanned = 0;
+    std::vector<GroupRow> groups =
+        groupRows(spec, planQuery(spec.filter, store_, date_index_, text_index_.get()), store_, date_index_,
+                  scan_executor_.get(), scanned);
+    timer.rows(scanned, groups.size());
+    return groups;
+}
+
+QueryPlan ExpenseManager::explain(const ExpenseQuery& query) const {
+    ensureResident(query.firstDay(), query.lastDay()); // Plans are costed on the rows the query would see
+    flushDateIndex();
+    return planQuery(query, store_, date_index_, text_index_.get());
+}
+
+double ExpenseManager::sumForDateRange(const Date& startDate, const Date& endDate) const {
+    return aggregateDateRange(startDate, endDate).sum;
+}
+
+size_t ExpenseManager::countForDateRange(const Date& startDate, const Date& endDate) const {
+    return aggregateDateRange(startDate, endDate).count;
+}
+
+bool ExpenseManager::minAmountForDateRange(const Date& startDate, const Date& endDate, double& amount) const {
+    const AmountAggregate result = aggregateDateRange(startDate, endDate);
+    if (result.count == 0) {
+        return false;
+    }
+    amount = result.min;
+    return true;
+}
+
+bool ExpenseManager::maxAmountForDateRange(const Date& startDate, const Date& endDate, double& amount) const {
+    const AmountAggregate result = aggregateDateRange(startDate, endDate);
+    if (result.count == 0) {
+        return false;
+    }
+    amount = result.max;
+    return true;
+}
 
-        bool beforeOrOnEnd = (exp.date.year < endDate.year) ||
-                             (exp.date.year == endDate.year && exp.date.month < endDate.month) ||
-                             (exp.date.year == endDate.year && exp.date.month == endDate.month && exp.date.day <= endDate.day);
+// Streaming aggregation. The filters are the same inclusive packed-day ranges as
+// the in-memory queries; each row is tested and folded into the running totals
+// as it is read, so nothing but the per-category map outlives the row.
 
-        if (afterOrOnStart && beforeOrOnEnd) {
-            result.push_back(exp);
+bool ExpenseManager::streamDayRange(const std::string& filename, int32_t firstDay, int32_t lastDay,
+                                    ExpenseTotal& total, std::vector<CategoryTotal>* byCategory) const {
+    OperationTimer timer(*stats_, Operation::kStream);
+    total = ExpenseTotal{};
+    std::unordered_map<std::string, ExpenseTotal> categories;
+    std::string key;
+    size_t scanned = 0;
+    const std::string filepath = "data/" + filename;
+    auto onRow = [&](std::string_view, double amount, int32_t dayNumber, std::string_view category,
+                     TransactionType, ExpenseId) {
+        ++scanned;
+        if (dayNumber < firstDay || dayNumber > lastDay) {
+            return;
+        }
+        total.sum += amount;
+        ++total.count;
+        if (byCategory) {
+            key.assign(category.data(), category.size()); // Reuses the buffer; no per-row allocation
+            ExpenseTotal& categoryTotal = categories[key];
+            categoryTotal.sum += amount;
+            ++categoryTotal.count;
+        }
+    };
+    // A segment is read only where its block date ranges overlap the query.
+    bool ok;
+    uint64_t bytesRead = 0;
+    SourceStamp source;
+    if (isSegmentFile(filepath)) {
+        SegmentScanStats segment;
+        ok = scanSegment(filepath, firstDay, lastDay, onRow, &segment);
+        bytesRead = segment.bytes_read;
+    } else {
+        ok = scanCsvFile(filepath, onRow, false);
+        if (statSource(filepath, source)) {
+            bytesRead = source.size;
         }
     }
-    return result;
+
+    if (byCategory) {
+        byCategory->clear();
+        for (auto& entry : categories) {
+            byCategory->push_back(CategoryTotal{entry.first, entry.second});
+        }
+        std::sort(byCategory->begin(), byCategory->end(), [](const CategoryTotal& a, const CategoryTotal& b) {
+            return a.total.sum > b.total.sum;
+        });
+    }
+    timer.bytesRead(bytesRead);
+    timer.rows(scanned, total.count);
+    return ok;
+}
+
+bool ExpenseManager::streamTotalForDay(const std::string& filename, const Date& date, ExpenseTotal& total) const {
+    return streamDayRange(filename, firstDayOnOrAfter(date), lastDayOnOrBefore(date), total, nullptr);
+}
+
+bool ExpenseManager::streamTotalForMonth(const std::string& filename, int month, int year,
+                                         ExpenseTotal& total) const {
+    int32_t firstDay, lastDay;
+    monthDayRange(year, month, firstDay, lastDay);
+    return streamDayRange(filename, firstDay, lastDay, total, nullptr);
+}
+
+bool ExpenseManager::streamTotalForYear(const std::string& filename, int year, ExpenseTotal& total) const {
+    return streamDayRange(filename, toDayNumber(year, 1, 1), toDayNumber(year + 1, 1, 1) - 1, total, nullptr);
+}
+
+bool ExpenseManager::streamTotalForDateRange(const std::string& filename, const Date& startDate, const Date& endDate,
+                                             ExpenseTotal& total, std::vector<CategoryTotal>* byCategory) const {
+    return streamDayRange(filename, firstDayOnOrAfter(startDate), lastDayOnOrBefore(endDate), total, byCategory);
 }
 
 
-// Implementations for loadExpenses and saveExpenses will be added in the data persistence step.
-// For now, dummy implementations to allow compilation:
+// Shared by the sequential and parallel CSV loaders so both accept and reject
+// exactly the same rows. Returns an empty string for a valid row, otherwise the
+// warning text (without line number or "Skipping row").
+std::string ExpenseManager::validateRow(std::string_view dateStr, std::string_view typeStr,
+                                        Date& date, TransactionType& type) const {
+    date = parseDateString(dateStr);
+    // Check if parseDateString indicated an error (e.g., returned 0,0,0 for y,m,d)
+    // and ensure it wasn't intentionally "0000-00-00" or an equivalent "zero" date string.
+    if (date.year == 0 && date.month == 0 && date.day == 0 && !dateStr.empty() && dateStr != "0-00-00" && dateStr != "0000-00-00") {
+        return "Could not parse date string: '" + std::string(dateStr) + "'";
+    }
+
+    if (!parseTransactionType(typeStr, type)) {
+        return "Unknown transaction type: '" + std::string(typeStr) + "'";
+    }
+    return std::string();
+}
+
+void ExpenseManager::setTextIndex(bool enabled) {
+    WriteLock lock(*this);
+    if (!enabled) {
+        text_index_.reset();
+    } else if (!text_index_) {
+        text_index_ = TextIndex::build(store_);
+    }
+}
+
+void ExpenseManager::setScanThreads(unsigned threads) {
+    WriteLock lock(*this);
+    // Snapshots already taken keep the old pool until they are released.
+    scan_executor_ = threads == 1 ? nullptr : std::make_shared<ScanExecutor>(threads);
+}
+
+bool ExpenseManager::saveSnapshot(const std::string& filename) const {
+    ensureAllResident();
+    flushDateIndex();
+    return writeSnapshot("data/" + filename, store_, date_index_, rollups_, SourceStamp{});
+}
+
+bool ExpenseManager::loadSnapshot(const std::string& filename) {
+    WriteLock lock(*this);
+    live_rows_valid_ = false;
+    partitions_.clear(); // The snapshot is the whole ledger; a partitioned save writes every month
+    partition_dir_.clear();
+    const bool indexText = text_index_ != nullptr;
+    text_index_.reset();
+    const bool loaded = openSnapshot("data/" + filename, store_, date_index_, rollups_);
+    if (indexText) {
+        text_index_ = TextIndex::build(store_);
+    }
+    return loaded;
+}
+
 bool ExpenseManager::loadExpenses(const std::string& filename) {
+    // Readers keep getting the previous snapshot until the whole load is done.
+    WriteLock lock(*this);
+    OperationTimer timer(*stats_, Operation::kLoad);
     std::string filepath = "data/" + filename;
-    expenses_.clear(); // Clear existing expenses before loading
+    journal_.reset(); // A journal only ever applies to the file it was opened with
+    ++journal_generation_;
+    journal_base_path_.clear();
+    journal_broken_ = false;
+    live_rows_valid_ = false;
+    partitions_.clear();
+    partition_dir_.clear();
+    // Built afresh once the rows are in; snapshots keep the old one.
+    const bool indexText = text_index_ != nullptr;
+    text_index_.reset();
+    tail_ = TailPosition();
+    SourceStamp before;
+    const bool stamped = statSource(filepath, before);
+
+    const bool loaded = partitioned_ ? loadPartitionedLedger(filepath)
+                                     : loadBaseFile(filepath) && (!journaling_ || attachJournal(filepath));
+    if (indexText) {
+        text_index_ = TextIndex::build(store_);
+    }
+    if (loaded && stamped && !partitioned_ && !journal_ && !isSegmentFile(filepath)) {
+        tail_.path = filepath; // Followed by reloadExpenses
+        followFile(&before);
+    }
+    SourceStamp source;
+    // A partitioned ledger opened from its manifest has read no rows yet.
+    const bool readCsv = !partitioned_ || partitions_.residentCount() > 0;
+    if (readCsv && statSource(filepath, source)) {
+        timer.bytesRead(source.size); // The CSV, even when the snapshot cache served the rows
+    }
+    timer.rows(store_.size(), store_.liveCount());
+    return loaded;
+}
+
+bool ExpenseManager::importExpenses(const std::string& filename) {
+    WriteLock lock(*this);
+    OperationTimer timer(*stats_, Operation::kImport);
+    const size_t before = store_.size();
+    const std::string filepath = "data/" + filename;
+    PartitionCatalog::Key lastKey = PartitionCatalog::kUndated;
+    bool anyKey = false;
+    std::string descriptionScratch, categoryScratch;
+    const bool imported = scanLedgerFile(
+        filepath,
+        [&](std::string_view description, double amount, int32_t dayNumber, std::string_view category,
+            TransactionType type, ExpenseId) {
+            // A segment or record-aware parse can yield line breaks; see singleLineText.
+            description = singleLineText(description, descriptionScratch);
+            category = singleLineText(category, categoryScratch);
+            if (partitioned_) {
+                // Imports tend to run in date order, so the month rarely changes.
+                const PartitionCatalog::Key key = PartitionCatalog::keyForDay(dayNumber);
+                if (!anyKey || key != lastKey) {
+                    loadPartitions(partitions_.touch(dayNumber, dayNumber));
+                    partitions_.markDirty(dayNumber);
+                    lastKey = key;
+                    anyKey = true;
+                }
+            }
+            // The file's ids belong to another ledger; take fresh ones.
+            const ExpenseId id = appendRow(description, amount, dayNumber, category, type, kNoExpenseId);
+            journalAdd(id, description, amount, dayNumber, category, type);
+        },
+        false);
+    SourceStamp source;
+    if (statSource(filepath, source)) {
+        timer.bytesRead(source.size);
+    }
+    timer.rows(store_.size() - before, store_.size() - before);
+    return imported;
+}
+
+bool ExpenseManager::attachJournal(const std::string& filepath) {
+    SourceStamp base; // Stays zero if the CSV does not exist yet
+    statSource(filepath, base);
+    auto journal = std::make_unique<ExpenseJournal>();
+    const bool opened = journal->open(
+        filepath + ".journal", base,
+        [this](ExpenseId id, std::string_view description, double amount, int32_t dayNumber,
+               std::string_view category, TransactionType type) {
+            appendRow(description, amount, dayNumber, category, type, id);
+        },
+        [this](ExpenseId id) {
+            size_t row;
+            if (store_.findRow(id, row)) {
+                tombstoneRow(row);
+            }
+        });
+    if (!opened) {
+        return false;
+    }
+    compactIfSparse();
+    journal_ = std::move(journal);
+    journal_base_path_ = filepath;
+    return true;
+}
+
+bool ExpenseManager::compactJournal() const {
+    if (!journal_) {
+        return false;
+    }
+    waitForSaves(); // Lets a background compaction finish first
+    SourceStamp base;
+    // Crash-safe ordering: the new base is in place before the journal is
+    // emptied, and a journal left behind no longer matches the new base.
+    if (!writeLedgerFile(journal_base_path_, true) || !statSource(journal_base_path_, base) ||
+        !journal_->reset(base)) {
+        return false;
+    }
+    journal_broken_ = false; // The base file now holds every change
+    return true;
+}
+
+// Partitioned storage. The store holds the resident months only; their rows
+// enter and leave it through the same appendRow/tombstoneRow paths as any
+// other mutation, so the date index and rollups always describe exactly the
+// resident rows.
+
+bool ExpenseManager::loadPartitionedLedger(const std::string& filepath) {
+    partition_dir_ = filepath + ".parts";
+    store_.clear();
+    rebuildIndexes();
+    ExpenseId nextId = 0;
+    bool exists = false;
+    if (partitions_.readManifest(partition_dir_ + "/manifest", nextId, exists)) {
+        store_.reserveIds(nextId); // Ids of rows not loaded yet are never reissued
+        return true;
+    }
+    if (exists) {
+        return false;
+    }
+
+    // No partitions yet: the whole single-file ledger is resident and unsaved.
+    const bool loaded = loadBaseFile(filepath);
+    date_index_.flush(); // The writer lock is held, so not flushDateIndex()
+    partitions_.adoptAll(partitionKeys(date_index_));
+    return loaded;
+}
+
+void ExpenseManager::ensureResident(int32_t firstDay, int32_t lastDay) const {
+    if (!partitioned_) {
+        return;
+    }
+    if (is_snapshot_) {
+        // Readers share a snapshot, so it cannot load months; say that the
+        // answer is partial rather than pass it off as the whole ledger.
+        for (PartitionCatalog::Key key : missing_partitions_) {
+            int32_t first, last;
+            PartitionCatalog::dayRange(key, first, last);
+            if (first <= lastDay && firstDay <= last) {
+                std::call_once(missing_warning_once_, [] {
+                    std::cerr << "Warning: Read snapshot of a partitioned ledger lacks months that were not loaded "
+                                 "when it was taken; results cover the loaded months only"
+                              << std::endl;
+                });
+                break;
+            }
+        }
+        return;
+    }
+    const std::vector<PartitionCatalog::Key> missing = partitions_.touch(firstDay, lastDay);
+    if (missing.empty()) {
+        return;
+    }
+    // Residency is a cache of the saved ledger: loading a month changes the
+    // rows in memory, not the ledger a const query answers for. The manager
+    // itself is never a const object (snapshots return above), so writing
+    // through a const_cast is well defined.
+    ExpenseManager& self = const_cast<ExpenseManager&>(*this);
+    WriteLock lock(self);
+    self.loadPartitions(missing);
+}
+
+void ExpenseManager::ensureAllResident() const {
+    ensureResident(kNoDayNumber, ExpenseStore::kTombstoneDay - 1);
+}
+
+void ExpenseManager::loadPartitions(const std::vector<PartitionCatalog::Key>& keys) {
+    if (keys.empty()) {
+        return;
+    }
+    OperationTimer timer(*stats_, Operation::kLoad);
+    const size_t before = store_.size();
+    uint64_t bytes = 0;
+    for (PartitionCatalog::Key key : keys) {
+        SourceStamp source;
+        if (statSource(partition_dir_ + "/" + PartitionCatalog::fileName(key), source)) {
+            bytes += source.size;
+        }
+        loadPartition(key);
+    }
+    timer.rows(store_.size() - before, store_.size() - before);
+    timer.bytesRead(bytes);
+
+    if (partition_budget_ == 0) {
+        return;
+    }
+    const std::vector<PartitionCatalog::Key> victims = partitions_.evictionCandidates(partition_budget_);
+    for (PartitionCatalog::Key key : victims) {
+        evictPartition(key);
+    }
+    if (!victims.empty()) {
+        compactRows();
+    }
+}
+
+bool ExpenseManager::loadPartition(PartitionCatalog::Key key) {
+    // Resident even if the file cannot be read, so a bad month is reported
+    // once rather than on every query; the error is on stderr either way.
+    partitions_.setResident(key, true);
+    return scanLedgerFile(
+        partition_dir_ + "/" + PartitionCatalog::fileName(key),
+        [this](std::string_view description, double amount, int32_t dayNumber, std::string_view category,
+               TransactionType type, ExpenseId id) {
+            if (id == kNoExpenseId) {
+                appendRow(description, amount, dayNumber, category, type, kNoExpenseId);
+            } else {
+                restoreRow(description, amount, dayNumber, category, type, id);
+            }
+        },
+        false);
+}
+
+void ExpenseManager::evictPartition(PartitionCatalog::Key key) {
+    int32_t firstDay, lastDay;
+    PartitionCatalog::dayRange(key, firstDay, lastDay);
+    date_index_.flush();
+    const auto range = date_index_.findRange(firstDay, lastDay);
+    std::vector<RowId> rows;
+    rows.reserve(range.second - range.first);
+    for (size_t i = range.first; i < range.second; ++i) {
+        const RowId row = date_index_.rows()[i];
+        if (store_.isLive(row)) {
+            rows.push_back(row);
+        }
+    }
+    for (RowId row : rows) {
+        tombstoneRow(row);
+    }
+    partitions_.setResident(key, false);
+}
+
+bool ExpenseManager::writePartitions(const std::string& directory, const std::vector<PartitionCatalog::Key>& keys,
+                                     bool record, size_t& rowsWritten, uint64_t& bytesWritten) const {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Error: Could not create partition directory: " << directory << std::endl;
+        return false;
+    }
+    flushDateIndex();
+    PartitionCatalog written; // The manifest when not recording into partitions_
+    for (PartitionCatalog::Key key : keys) {
+        const std::string path = directory + "/" + PartitionCatalog::fileName(key);
+        int32_t firstDay, lastDay;
+        PartitionCatalog::dayRange(key, firstDay, lastDay);
+        const auto range = date_index_.findRange(firstDay, lastDay);
+        // Row order (which is id order within a month) rather than date
+        // order, like the single-file CSV.
+        std::vector<RowId> rows;
+        rows.reserve(range.second - range.first);
+        for (size_t i = range.first; i < range.second; ++i) {
+            const RowId row = date_index_.rows()[i];
+            if (store_.isLive(row)) {
+                rows.push_back(row);
+            }
+        }
+        std::sort(rows.begin(), rows.end());
+
+        if (rows.empty()) {
+            if (std::remove(path.c_str()) != 0 && errno != ENOENT) {
+                std::cerr << "Error: Could not remove empty partition: " << path << std::endl;
+                return false;
+            }
+        } else if (!writeCsvRows(path, true, ExpenseView(&store_, rows.data(), rows.size()))) {
+            return false;
+        } else {
+            SourceStamp stamp;
+            if (statSource(path, stamp)) {
+                bytesWritten += stamp.size;
+            }
+            rowsWritten += rows.size();
+        }
+        (record ? partitions_ : written).markSaved(key, !rows.empty());
+    }
+
+    // Each partition file was replaced atomically; the manifest goes last, so
+    // a crash before this point leaves the previous manifest (which does not
+    // list months first created by this save).
+    const std::string manifestPath = directory + "/manifest";
+    std::ofstream manifest(manifestPath + ".tmp");
+    (record ? partitions_ : written).writeManifest(manifest, store_.nextId());
+    manifest.close();
+    if (!manifest || !replaceFile(manifestPath + ".tmp", manifestPath)) {
+        std::cerr << "Error: Could not write partition manifest: " << manifestPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ExpenseManager::loadBaseFile(const std::string& filepath) {
+    // Fast path: a snapshot written alongside this exact CSV. Opening it maps
+    // the columns instead of parsing every row.
+    SourceStamp csvStamp, snapshotStamp;
+    const std::string snapshotPath = filepath + ".snap";
+    if (snapshot_cache_ && statSource(filepath, csvStamp) && statSource(snapshotPath, snapshotStamp) &&
+        openSnapshot(snapshotPath, store_, date_index_, rollups_, &csvStamp)) {
+        return true;
+    }
+
+    if (isSegmentFile(filepath)) {
+        return loadSegmentFile(filepath);
+    }
+    if (ingest_threads_ != 1) {
+        return loadExpensesParallel(filepath, ingest_threads_);
+    }
+
+    store_.clear(); // Clear existing expenses before loading
+    const bool loaded = scanCsvFile(
+        filepath,
+        [this](std::string_view description, double amount, int32_t dayNumber, std::string_view category,
+               TransactionType type, ExpenseId id) { store_.append(description, amount, dayNumber, category, type, id); },
+        true);
+    rebuildIndexes(); // Also keeps indexes consistent with the rows read before an error
+    return loaded;
+}
 
+bool ExpenseManager::loadSegmentFile(const std::string& filepath) {
+    // A segment holds its rows in date order. They are put back in id order,
+    // which is the order they were added in, so a round trip through a
+    // segment keeps getAllExpenses order and ids ascending like a CSV does.
+    // A ledger that was entered chronologically is already in that order.
+    store_.clear();
+    SegmentScanStats stats;
+    const bool loaded = scanSegment(
+        filepath, kNoDayNumber, ExpenseStore::kTombstoneDay - 1,
+        [this](std::string_view description, double amount, int32_t dayNumber, std::string_view category,
+               TransactionType type, ExpenseId id) { store_.restore(description, amount, dayNumber, category, type, id); },
+        &stats);
+
+    std::vector<std::pair<ExpenseId, RowId>> byId(store_.size());
+    bool ascending = true;
+    for (size_t row = 0; row < store_.size(); ++row) {
+        byId[row] = {store_.idAt(row), static_cast<RowId>(row)};
+        ascending = ascending && (row == 0 || byId[row - 1].first < byId[row].first);
+    }
+    if (!ascending) {
+        std::sort(byId.begin(), byId.end());
+        ExpenseStore byDate = std::move(store_);
+        store_ = ExpenseStore();
+        for (const auto& entry : byId) {
+            const RowId row = entry.second;
+            store_.append(byDate.descriptionAt(row), byDate.amountAt(row), byDate.dayNumberAt(row),
+                          byDate.categoryAt(row), byDate.typeAt(row), entry.first);
+        }
+    }
+    store_.reserveIds(stats.next_id);
+    rebuildIndexes();
+    return loaded;
+}
+
+bool ExpenseManager::scanLedgerFile(const std::string& filepath, const RowHandler& onRow, bool missingIsEmpty) const {
+    if (isSegmentFile(filepath)) {
+        return scanSegment(filepath, kNoDayNumber, ExpenseStore::kTombstoneDay - 1, onRow);
+    }
+    return scanCsvFile(filepath, onRow, missingIsEmpty);
+}
+
+bool ExpenseManager::scanCsvFile(const std::string& filepath, const RowHandler& onRow, bool missingIsEmpty) const {
     try {
-        // Using CSVReader: 5 columns, trim whitespace around fields.
-        // The library handles quoted fields by default.
-        io::CSVReader<5, io::trim_chars<' '>> in(filepath);
+        // Using CSVReader: 6 columns, trim whitespace around fields, and strip
+        // the quotes (collapsing "" escapes) that appendCsvRow writes. The file
+        // is read through a fixed-size buffer, so memory does not grow with it.
+        io::CSVReader<6, io::trim_chars<' '>, io::double_quote_escape<',', '"'>> in(filepath);
 
         // Read the header row and expect these names.
-        // ignore_extra_column allows the CSV to have more columns than we read, though we expect 5.
-        in.read_header(io::ignore_extra_column, "Date", "Description", "Amount", "Category", "Type");
-
-        std::string dateStr, description, category, typeStr;
-        double amount;
-
-        while (in.read_row(dateStr, description, amount, category, typeStr)) {
-            Date date = parseDateString(dateStr);
-            // Check if parseDateString indicated an error (e.g., returned 0,0,0 for y,m,d)
-            // and ensure it wasn't intentionally "0000-00-00" or an equivalent "zero" date string.
-            if (date.year == 0 && date.month == 0 && date.day == 0 && !dateStr.empty() && dateStr != "0-00-00" && dateStr != "0000-00-00") {
-                std::cerr << "Warning: Could not parse date string: '" << dateStr << "'. Skipping row." << std::endl;
-                continue;
+        // ignore_extra_column allows the CSV to have more columns than we read.
+        // Id is optional (files written before expense ids existed), so missing
+        // columns are allowed by the reader and the required ones checked here.
+        in.read_header(io::ignore_extra_column | io::ignore_missing_column,
+                       "Date", "Description", "Amount", "Category", "Type", "Id");
+        for (const char* column : {"Date", "Description", "Amount", "Category", "Type"}) {
+            if (!in.has_column(column)) {
+                std::cerr << "Error: CSV header missing or does not match expected format in file: " << filepath
+                          << " - missing column \"" << column << "\"" << std::endl;
+                return false;
             }
+        }
+
+        // Fields point into the reader's buffer; nothing is copied per row.
+        char* dateStr = nullptr;
+        char* description = nullptr;
+        char* amountStr = nullptr;
+        char* category = nullptr;
+        char* typeStr = nullptr;
+        char* idStr = nullptr;
 
+        // A missing column leaves its variable untouched, hence the reset.
+        while (idStr = nullptr, in.read_row(dateStr, description, amountStr, category, typeStr, idStr)) {
+            // parseAmount rather than the reader's own float parser, so this
+            // loader and the parallel one agree on every Amount field.
+            double amount;
+            if (!parseAmount(amountStr, amount)) {
+                std::cerr << "Error: Exception while reading CSV file: " << filepath << " - could not parse amount '"
+                          << amountStr << "' (line " << in.get_file_line() << ")" << std::endl;
+                return false;
+            }
+            Date date;
             TransactionType transactionTypeVal;
-            if (typeStr == "Credit") {
-                transactionTypeVal = TransactionType::CREDIT;
-            } else if (typeStr == "Cash") {
-                transactionTypeVal = TransactionType::CASH;
-            } else {
-                std::cerr << "Warning: Unknown transaction type: '" << typeStr << "'. Skipping row." << std::endl;
+            const std::string warning = validateRow(dateStr, typeStr, date, transactionTypeVal);
+            if (!warning.empty()) {
+                std::cerr << "Warning: " << warning << " (line " << in.get_file_line() << "). Skipping row." << std::endl;
                 continue;
             }
 
-            expenses_.emplace_back(description, amount, date, category, transactionTypeVal);
+            ExpenseId id = kNoExpenseId;
+            if (idStr && !parseExpenseId(idStr, id)) {
+                id = kNoExpenseId; // Blank or malformed: the store assigns a fresh id
+            }
+            onRow(description, amount, toDayNumber(date), category, transactionTypeVal, id);
         }
-        // Successfully loaded (or file was empty/header-only, which is also success)
+        // Successfully read (or file was empty/header-only, which is also success)
         return true;
     } catch (const io::error::can_not_open_file& e) {
+        if (!missingIsEmpty) {
+            std::cerr << "Error: Could not open file for reading: " << filepath << std::endl;
+            return false;
+        }
         // This is common on first run or if the file is legitimately missing.
         // Treat as success for application startup, but log it.
         std::cout << "Info: Expense file not found or could not be opened: " << filepath
@@ -204,36 +1284,329 @@ bool ExpenseManager::loadExpenses(const std::string& filename) {
 }
 
 bool ExpenseManager::saveExpenses(const std::string& filename) const {
+    if (!is_snapshot_) {
+        if (canSaveFromSnapshot("data/" + filename)) {
+            // Through the save queue, like a background save: saves that
+            // write the same temporary files must never overlap.
+            return saveExpensesAsync(filename).get();
+        }
+        if (!journal_ || "data/" + filename != journal_base_path_) {
+            waitForSaves(); // Partition saves need this manager's own state
+        }
+    }
+    OperationTimer timer(*stats_, Operation::kSave);
     std::string filepath = "data/" + filename;
-    std::ofstream outFile(filepath);
+
+    // Partitioned ledger: only the months changed since they were loaded are
+    // rewritten. Saving under another name writes every month there.
+    if (partitioned_) {
+        if (is_snapshot_) {
+            std::cerr << "Error: A read snapshot of a partitioned ledger holds only the months loaded when it was "
+                         "taken and cannot be saved; save the ledger itself"
+                      << std::endl;
+            return false;
+        }
+        const std::string directory = filepath + ".parts";
+        std::vector<PartitionCatalog::Key> keys;
+        if (directory == partition_dir_) {
+            keys = partitions_.dirtyKeys();
+        } else {
+            ensureAllResident();
+            flushDateIndex();
+            keys = partitionKeys(date_index_);
+        }
+        // Month files are CSVs, whose dates have four-digit years; a month
+        // outside them would be written but could never be loaded again.
+        for (PartitionCatalog::Key key : keys) {
+            int32_t firstDay, lastDay;
+            PartitionCatalog::dayRange(key, firstDay, lastDay);
+            if (key != PartitionCatalog::kUndated && !isStorableDate(fromDayNumber(firstDay))) {
+                std::cerr << "Error: Cannot save month " << PartitionCatalog::fileName(key)
+                          << ": only years " << kMinLedgerYear << ".." << kMaxLedgerYear
+                          << " can be stored; nothing was written" << std::endl;
+                return false;
+            }
+        }
+        size_t rowsWritten = 0;
+        uint64_t bytesWritten = 0;
+        const bool saved = writePartitions(directory, keys, directory == partition_dir_, rowsWritten, bytesWritten);
+        timer.rows(rowsWritten, rowsWritten);
+        timer.bytesWritten(bytesWritten);
+        return saved;
+    }
+
+    // Journaled file: the changes are already on disk as journal records, so a
+    // save costs an fsync. Once the journal has grown to a fair fraction of the
+    // base file, a compaction is queued on the save worker; only a journal
+    // that missed a record, and so no longer holds every change, is compacted
+    // here before the save returns.
+    if (journal_ && filepath == journal_base_path_) {
+        SourceStamp base;
+        if (journal_broken_) {
+            const bool compacted = compactJournal();
+            if (compacted && statSource(filepath, base)) {
+                timer.bytesWritten(base.size);
+            }
+            return compacted;
+        }
+        statSource(filepath, base);
+        // A background compaction swaps the journal under this lock.
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        if (!journal_->sync()) {
+            std::cerr << "Error: Could not sync journal file: " << journal_->path() << std::endl;
+            return false;
+        }
+        if (!compaction_queued_ &&
+            journal_->recordBytes() > std::max<uint64_t>(kJournalCompactionBytes, base.size / 4)) {
+            queueJournalCompaction();
+        }
+        return true;
+    }
+    const bool saved = writeLedgerFile(filepath, true);
+    SourceStamp written;
+    if (saved && statSource(filepath, written)) {
+        timer.bytesWritten(written.size);
+        timer.rows(store_.liveCount(), store_.liveCount());
+    }
+    return saved;
+}
+
+// Background saves. Each queued save is a task that first waits for the one
+// queued before it, so saves land in request order; the chain is cut as soon
+// as a task has waited, so finished saves and their snapshots are released.
+
+std::shared_future<bool> ExpenseManager::saveExpensesAsync(const std::string& filename,
+                                                           SaveCallback onComplete) const {
+    if (is_snapshot_ || !canSaveFromSnapshot("data/" + filename)) {
+        const bool saved = saveExpenses(filename);
+        if (onComplete) {
+            onComplete(saved);
+        }
+        std::promise<bool> done;
+        done.set_value(saved);
+        return done.get_future().share();
+    }
+    std::shared_ptr<const ExpenseManager> snapshot;
+    {
+        // Unlike readSnapshot, wait for the lock: the save must include every
+        // change made before the call.
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        snapshot = publishSnapshot();
+    }
+    return queueSave(std::move(snapshot), filename, std::move(onComplete));
+}
+
+bool ExpenseManager::canSaveFromSnapshot(const std::string& filepath) const {
+    // journal_base_path_ is only set while a journal is open, and snapshots
+    // copy it and partitioned_ from their source.
+    return !partitioned_ && filepath != journal_base_path_;
+}
+
+std::shared_future<bool> ExpenseManager::queueSave(std::shared_ptr<const ExpenseManager> snapshot,
+                                                   const std::string& filename, SaveCallback onComplete) const {
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        ++saves_in_flight_["data/" + filename];
+    }
+    return enqueueSave([this, snapshot = std::move(snapshot), filename,
+                        onComplete = std::move(onComplete)]() mutable {
+        const bool saved = snapshot->saveExpenses(filename);
+        snapshot.reset();
+        followSavedFile("data/" + filename, saved);
+        if (onComplete) {
+            onComplete(saved);
+        }
+        return saved;
+    });
+}
+
+std::shared_future<bool> ExpenseManager::enqueueSave(std::function<bool()> task) const {
+    std::lock_guard<std::mutex> lock(save_mutex_);
+    std::shared_future<bool> previous = pending_save_;
+    pending_save_ = std::async(std::launch::async,
+                               [task = std::move(task), previous]() mutable {
+                                   if (previous.valid()) {
+                                       previous.wait();
+                                       previous = std::shared_future<bool>();
+                                   }
+                                   return task();
+                               })
+                        .share();
+    return pending_save_;
+}
+
+void ExpenseManager::queueJournalCompaction() const {
+    std::shared_ptr<const ExpenseManager> snapshot = publishSnapshot();
+    const uint64_t generation = journal_generation_;
+    const uint64_t offset = journal_->size(); // The snapshot holds every record before it
+    compaction_queued_ = true;
+    enqueueSave([this, snapshot = std::move(snapshot), generation, offset]() mutable {
+        const bool compacted = runJournalCompaction(snapshot, generation, offset);
+        snapshot.reset();
+        return compacted;
+    });
+}
+
+bool ExpenseManager::runJournalCompaction(const std::shared_ptr<const ExpenseManager>& snapshot,
+                                          uint64_t generation, uint64_t offset) const {
+    const std::string& basePath = snapshot->journal_base_path_;
+    const std::string stagedPath = basePath + ".compact";
+    SourceStamp stamp;
+    const bool staged = snapshot->writeStagedLedger(basePath, stagedPath) && statSource(stagedPath, stamp);
+    bool swapped = false;
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        compaction_queued_ = false;
+        // Crash-safe ordering: the journal header names the new base before
+        // it is moved into place, so whichever base a restart finds, the
+        // journal replays onto it exactly the records it lacks.
+        if (staged && journal_ && journal_generation_ == generation && !journal_broken_ &&
+            journal_->prepareRebase(stamp, offset)) {
+            swapped = replaceFile(stagedPath, basePath);
+            // If this fails, the prepared header still replays correctly.
+            if (swapped && !journal_->rebase(stamp, offset)) {
+                std::cerr << "Warning: Could not drop compacted records from " << journal_->path() << std::endl;
+            }
+        }
+    }
+    if (!swapped) {
+        std::remove(stagedPath.c_str());
+        if (staged) {
+            std::cerr << "Error: Could not compact the journal into " << basePath << std::endl;
+        }
+        return false;
+    }
+    // Refresh the snapshot cache, as writeCsvFile would. The stamp still
+    // holds: moving a file keeps its size and modification time.
+    if (snapshot->snapshot_cache_ && !hasSegmentExtension(basePath) &&
+        !writeSnapshot(basePath + ".snap", snapshot->store_, snapshot->date_index_, snapshot->rollups_, stamp)) {
+        std::cerr << "Warning: Could not write snapshot cache for " << basePath << std::endl;
+    }
+    return true;
+}
+
+void ExpenseManager::waitForSaves() const {
+    std::shared_future<bool> pending;
+    {
+        std::lock_guard<std::mutex> lock(save_mutex_);
+        pending = pending_save_;
+    }
+    if (pending.valid()) {
+        pending.wait();
+    }
+}
+
+bool ExpenseManager::setAutosave(const std::string& filename, std::chrono::milliseconds interval) {
+    if (is_snapshot_) {
+        return false;
+    }
+    stopAutosave();
+    if (interval.count() <= 0) {
+        return true;
+    }
+    autosave_stop_ = false;
+    autosave_thread_ = std::thread([this, filename, interval] {
+        // Changes made before autosave started count as saved; a change
+        // since then makes the next tick save.
+        uint64_t savedVersion = version_.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(autosave_mutex_);
+        while (!autosave_wake_.wait_for(lock, interval, [this] { return autosave_stop_; })) {
+            lock.unlock();
+            // A snapshot that lags behind a busy writer is fine: the next
+            // tick picks up the rest.
+            std::shared_ptr<const ExpenseManager> snapshot = readSnapshot();
+            if (snapshot->snapshot_version_ != savedVersion) {
+                if (!snapshot->canSaveFromSnapshot("data/" + filename)) {
+                    std::cerr << "Warning: Autosave of " << filename
+                              << " skipped: journaled and partitioned ledgers are saved by saveExpenses" << std::endl;
+                    savedVersion = snapshot->snapshot_version_;
+                } else if (queueSave(snapshot, filename, nullptr).get()) {
+                    savedVersion = snapshot->snapshot_version_;
+                }
+            }
+            lock.lock();
+        }
+    });
+    return true;
+}
+
+void ExpenseManager::stopAutosave() {
+    if (!autosave_thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(autosave_mutex_);
+        autosave_stop_ = true;
+    }
+    autosave_wake_.notify_all();
+    autosave_thread_.join();
+}
+
+bool ExpenseManager::writeLedgerFile(const std::string& filepath, bool atomic) const {
+    if (!hasSegmentExtension(filepath)) {
+        return writeCsvFile(filepath, atomic);
+    }
+    return writeStagedLedger(filepath, filepath);
+}
+
+bool ExpenseManager::writeStagedLedger(const std::string& basePath, const std::string& stagedPath) const {
+    if (!hasSegmentExtension(basePath)) {
+        return writeCsvRows(stagedPath, false, getAllExpenses());
+    }
+    ensureAllResident();
+    flushDateIndex();
+    return writeSegment(stagedPath, store_, ExpenseView(&store_, &date_index_.rows(), 0, date_index_.sortedSize()));
+}
+
+bool ExpenseManager::writeCsvFile(const std::string& filepath, bool atomic) const {
+    if (!writeCsvRows(filepath, atomic, getAllExpenses())) {
+        return false;
+    }
+
+    // Refresh the snapshot cache, stamped with the CSV we just wrote. A failure
+    // here only costs the next load its fast path.
+    SourceStamp csvStamp;
+    flushDateIndex();
+    if (snapshot_cache_ && statSource(filepath, csvStamp) &&
+        !writeSnapshot(filepath + ".snap", store_, date_index_, rollups_, csvStamp)) {
+        std::cerr << "Warning: Could not write snapshot cache for " << filepath << std::endl;
+    }
+    return true;
+}
+
+bool ExpenseManager::writeCsvRows(const std::string& filepath, bool atomic, const ExpenseView& rows) const {
+    const std::string writePath = atomic ? filepath + ".tmp" : filepath;
+    std::ofstream outFile(writePath);
 
     if (!outFile.is_open()) {
-        std::cerr << "Error: Could not open file for saving: " << filepath << std::endl;
+        std::cerr << "Error: Could not open file for saving: " << writePath << std::endl;
         return false;
     }
 
     // Write header
-    outFile << "Date,Description,Amount,Category,Type\n"; // CSV header
-
-    for (const auto& exp : expenses_) {
-        std::string dateStr = fmt::format("{}-{:02}-{:02}", exp.date.year, exp.date.month, exp.date.day);
-        std::string typeStr = (exp.transaction_type == TransactionType::CREDIT) ? "Credit" : "Cash";
+    outFile << "Date,Description,Amount,Category,Type,Id\n"; // CSV header
 
-        // Format the CSV line using fmt::format.
-        // This simple version quotes all string fields.
-        // Note: If description or category can contain actual quote characters, they would need to be escaped (e.g., "" for ").
-        // This implementation does not handle that level of CSV complexity.
-        outFile << fmt::format("\"{}\",\"{}\",{},\"{}\",\"{}\"\n",
-                               dateStr,
-                               exp.description,
-                               exp.amount,
-                               exp.category,
-                               typeStr);
+    // Rows are encoded into one reused buffer (see CsvCodec.h) and handed to
+    // the stream in large blocks, instead of formatting a string per field.
+    constexpr size_t kFlushBytes = size_t{1} << 20;
+    std::string buffer;
+    buffer.reserve(kFlushBytes + 4096);
+    for (const ExpenseRow exp : rows) {
+        appendCsvRow(buffer, exp);
+        if (buffer.size() >= kFlushBytes) {
+            outFile.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
     }
+    outFile.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 
     outFile.close();
     if (!outFile) { // Check for errors that might have occurred during writes or close.
-        std::cerr << "Error: An error occurred while writing to file: " << filepath << std::endl;
+        std::cerr << "Error: An error occurred while writing to file: " << writePath << std::endl;
+        return false;
+    }
+    if (atomic && !replaceFile(writePath, filepath)) {
+        std::cerr << "Error: Could not move " << writePath << " into place as " << filepath << std::endl;
         return false;
     }
     return true;
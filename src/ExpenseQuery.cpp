@@ -0,0 +1,515 @@
+#include "ExpenseQuery.h"
+#include "CsvCodec.h"
+#include "DateIndex.h"
+#include "ScanExecutor.h"
+#include "TextIndex.h"
+#include <algorithm>
+#include <cmath>
+
+namespace expense_tracker {
+
+ExpenseQuery& ExpenseQuery::between(const Date& first, const Date& last) {
+    return onOrAfter(first).onOrBefore(last);
+}
+
+// Any date predicate excludes undated rows (kNoDayNumber), which would
+// otherwise pass an upper bound on its own.
+ExpenseQuery& ExpenseQuery::onOrAfter(const Date& first) {
+    has_days_ = true;
+    first_day_ = std::max({first_day_, firstDayOnOrAfter(first), kNoDayNumber + 1});
+    return *this;
+}
+
+ExpenseQuery& ExpenseQuery::onOrBefore(const Date& last) {
+    has_days_ = true;
+    first_day_ = std::max(first_day_, kNoDayNumber + 1);
+    last_day_ = std::min(last_day_, lastDayOnOrBefore(last));
+    return *this;
+}
+
+ExpenseQuery& ExpenseQuery::inMonth(int month, int year) {
+    if (month < 1 || month > 12) {
+        // No such month: match nothing instead of a neighbouring month.
+        has_days_ = true;
+        first_day_ = std::numeric_limits<int32_t>::max();
+        last_day_ = std::numeric_limits<int32_t>::min();
+        return *this;
+    }
+    const Date next = month == 12 ? Date(year + 1, 1, 1) : Date(year, month + 1, 1);
+    return between(Date(year, month, 1), fromDayNumber(toDayNumber(next) - 1));
+}
+
+ExpenseQuery& ExpenseQuery::inYear(int year) {
+    return between(Date(year, 1, 1), Date(year, 12, 31));
+}
+
+ExpenseQuery& ExpenseQuery::category(std::string name) {
+    categories_.push_back(std::move(name));
+    return *this;
+}
+
+ExpenseQuery& ExpenseQuery::type(TransactionType type) {
+    if (!types_restricted_) {
+        type_mask_ = 0;
+        types_restricted_ = true;
+    }
+    type_mask_ |= static_cast<uint8_t>(1u << static_cast<int>(type));
+    return *this;
+}
+
+ExpenseQuery& ExpenseQuery::amountAtLeast(double amount) {
+    has_amounts_ = true;
+    min_amount_ = std::max(min_amount_, amount);
+    return *this;
+}
+
+ExpenseQuery& ExpenseQuery::amountAbove(double amount) {
+    // Strict bounds become inclusive ones on the adjacent double, so the scan
+    // has a single comparison form.
+    return amountAtLeast(std::nextafter(amount, std::numeric_limits<double>::infinity()));
+}
+
+ExpenseQuery& ExpenseQuery::amountAtMost(double amount) {
+    has_amounts_ = true;
+    max_amount_ = std::min(max_amount_, amount);
+    return *this;
+}
+
+ExpenseQuery& ExpenseQuery::amountBelow(double amount) {
+    return amountAtMost(std::nextafter(amount, -std::numeric_limits<double>::infinity()));
+}
+
+ExpenseQuery& ExpenseQuery::descriptionContains(std::string text) {
+    substrings_.push_back(std::move(text));
+    return *this;
+}
+
+ExpenseQuery& ExpenseQuery::descriptionStartsWith(std::string text) {
+    prefixes_.push_back(std::move(text));
+    return *this;
+}
+
+std::string QueryPlan::describe() const {
+    std::string text;
+    switch (access) {
+    case Access::kEmpty:
+        return "empty";
+    case Access::kDateIndex:
+        text = "date-index";
+        break;
+    case Access::kTextIndex:
+        text = "text-index";
+        break;
+    case Access::kFullScan:
+        text = "full-scan";
+        break;
+    }
+    text += "(" + std::to_string(candidate_rows) + " rows)";
+    for (Filter filter : filters) {
+        static const char* const kNames[] = {"date", "type", "category", "amount", "description"};
+        text += " -> ";
+        text += kNames[static_cast<int>(filter)];
+    }
+    return text;
+}
+
+namespace {
+
+// An index slice is read through row ids, so each candidate costs a random
+// access per column it is filtered on; a scan reads every row but
+// sequentially. Use the index when it visits under 1/kIndexCostFactor of the rows.
+constexpr size_t kIndexCostFactor = 8;
+// Index candidates are filtered in blocks of this many row ids.
+constexpr size_t kIndexBlock = 4096;
+
+// The query lowered to flat values the filters compare against.
+struct CompiledQuery {
+    int32_t first_day;
+    int32_t last_day;
+    std::vector<uint8_t> accept_category; // By CategoryId; used only with a kCategory filter
+    uint8_t type_mask;
+    double min_amount;
+    double max_amount;
+    const std::vector<std::string>* substrings;
+    const std::vector<std::string>* prefixes;
+};
+
+// Returns false if the query cannot match any row of `store`.
+bool compile(const ExpenseQuery& query, const ExpenseStore& store, CompiledQuery& compiled) {
+    compiled.first_day = query.firstDay();
+    compiled.last_day = query.lastDay();
+    compiled.type_mask = query.typeMask();
+    compiled.min_amount = query.minAmount();
+    compiled.max_amount = query.maxAmount();
+    compiled.substrings = &query.descriptionSubstrings();
+    compiled.prefixes = &query.descriptionPrefixes();
+    if (!query.categories().empty()) {
+        compiled.accept_category.assign(store.categoryCount(), 0);
+        bool any = false;
+        for (const std::string& name : query.categories()) {
+            CategoryId id;
+            if (store.findCategory(name, id)) {
+                compiled.accept_category[id] = 1;
+                any = true;
+            }
+        }
+        if (!any) {
+            return false;
+        }
+    }
+    return compiled.first_day <= compiled.last_day && compiled.type_mask != 0 &&
+           compiled.min_amount <= compiled.max_amount;
+}
+
+// Column access for the filters: offsets into one chunk of every column
+// during a full scan...
+struct ChunkColumns {
+    const ExpenseStore& store;
+    size_t base;
+    const int32_t* days;
+    const uint8_t* types;
+    const CategoryId* categories;
+    const double* amounts;
+
+    int32_t day(uint32_t i) const { return days[i]; }
+    uint8_t type(uint32_t i) const { return types[i]; }
+    CategoryId category(uint32_t i) const { return categories[i]; }
+    double amount(uint32_t i) const { return amounts[i]; }
+    std::string_view description(uint32_t i) const { return store.descriptionAt(base + i); }
+    RowId row(uint32_t i) const { return static_cast<RowId>(base + i); }
+};
+
+// ...or store row ids from the date index.
+struct StoreRows {
+    const ExpenseStore& store;
+
+    int32_t day(uint32_t row) const { return store.dayNumberAt(row); }
+    uint8_t type(uint32_t row) const { return static_cast<uint8_t>(store.typeAt(row)); }
+    CategoryId category(uint32_t row) const { return store.categoryIdAt(row); }
+    double amount(uint32_t row) const { return store.amountAt(row); }
+    std::string_view description(uint32_t row) const { return store.descriptionAt(row); }
+    RowId row(uint32_t row) const { return row; }
+};
+
+// Keeps the entries of sel[0..count) that satisfy `keep`, in order, and
+// returns how many remain. Branch-free: every entry is written and the
+// cursor advances only past the kept ones.
+template <typename Keep>
+size_t narrow(uint32_t* sel, size_t count, Keep keep) {
+    size_t kept = 0;
+    for (size_t k = 0; k < count; ++k) {
+        const uint32_t i = sel[k];
+        sel[kept] = i;
+        kept += keep(i) ? 1 : 0;
+    }
+    return kept;
+}
+
+template <typename Columns>
+size_t applyFilters(const CompiledQuery& q, const std::vector<QueryPlan::Filter>& filters, const Columns& columns,
+                    uint32_t* sel, size_t count) {
+    for (QueryPlan::Filter filter : filters) {
+        if (count == 0) {
+            break;
+        }
+        switch (filter) {
+        case QueryPlan::Filter::kDate:
+            count = narrow(sel, count, [&](uint32_t i) {
+                const int32_t day = columns.day(i);
+                return (day >= q.first_day) & (day <= q.last_day);
+            });
+            break;
+        case QueryPlan::Filter::kType:
+            count = narrow(sel, count, [&](uint32_t i) { return (q.type_mask >> columns.type(i)) & 1; });
+            break;
+        case QueryPlan::Filter::kCategory:
+            count = narrow(sel, count, [&](uint32_t i) {
+                const CategoryId id = columns.category(i);
+                return id < q.accept_category.size() && q.accept_category[id];
+            });
+            break;
+        case QueryPlan::Filter::kAmount:
+            count = narrow(sel, count, [&](uint32_t i) {
+                const double amount = columns.amount(i);
+                return (amount >= q.min_amount) & (amount <= q.max_amount);
+            });
+            break;
+        case QueryPlan::Filter::kDescription:
+            // Substring search has data-dependent cost anyway; keep it last
+            // and short-circuiting.
+            count = narrow(sel, count, [&](uint32_t i) {
+                const std::string_view description = columns.description(i);
+                for (const std::string& text : *q.prefixes) {
+                    if (description.compare(0, text.size(), text) != 0) {
+                        return false;
+                    }
+                }
+                for (const std::string& text : *q.substrings) {
+                    if (description.find(text) == std::string_view::npos) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+            break;
+        }
+    }
+    return count;
+}
+
+// Runs share `part` of `parts` of the plan, handing each block of matching
+// rows to emit(columns, sel, count) in the access path's order. Returns rows
+// scanned.
+template <typename Emit>
+size_t execute(const CompiledQuery& q, const QueryPlan& plan, const ExpenseStore& store, const DateIndex& index,
+               size_t part, size_t parts, Emit emit) {
+    std::vector<uint32_t> sel;
+    if (plan.access == QueryPlan::Access::kDateIndex) {
+        const auto range = index.findRange(q.first_day, q.last_day);
+        const size_t length = range.second - range.first;
+        const size_t begin = range.first + length * part / parts;
+        const size_t end = range.first + length * (part + 1) / parts;
+        const ChunkedColumn<RowId>& rows = index.rows();
+        const StoreRows columns{store};
+        sel.resize(std::min(kIndexBlock, end - begin));
+        for (size_t pos = begin; pos < end; pos += kIndexBlock) {
+            const size_t count = std::min(kIndexBlock, end - pos);
+            for (size_t k = 0; k < count; ++k) {
+                sel[k] = rows[pos + k];
+            }
+            emit(columns, sel.data(), applyFilters(q, plan.filters, columns, sel.data(), count));
+        }
+        return end - begin;
+    }
+    if (plan.access == QueryPlan::Access::kTextIndex) {
+        const size_t length = plan.postings.size();
+        const size_t begin = length * part / parts;
+        const size_t end = length * (part + 1) / parts;
+        const StoreRows columns{store};
+        sel.resize(std::min(kIndexBlock, end - begin));
+        for (size_t pos = begin; pos < end; pos += kIndexBlock) {
+            const size_t count = std::min(kIndexBlock, end - pos);
+            std::copy(plan.postings.begin() + pos, plan.postings.begin() + pos + count, sel.begin());
+            emit(columns, sel.data(), applyFilters(q, plan.filters, columns, sel.data(), count));
+        }
+        return end - begin;
+    }
+    if (plan.access == QueryPlan::Access::kFullScan) {
+        const ChunkedColumn<int32_t>& days = store.dayNumbers();
+        const size_t chunks = days.chunkCount();
+        size_t scanned = 0;
+        for (size_t chunk = chunks * part / parts; chunk < chunks * (part + 1) / parts; ++chunk) {
+            const size_t length = days.chunkLength(chunk);
+            const ChunkColumns columns{store,
+                                       chunk << ChunkedColumn<int32_t>::kChunkShift,
+                                       days.chunkData(chunk),
+                                       store.types().chunkData(chunk),
+                                       store.categoryIds().chunkData(chunk),
+                                       store.amounts().chunkData(chunk)};
+            sel.resize(length);
+            for (size_t i = 0; i < length; ++i) {
+                sel[i] = static_cast<uint32_t>(i);
+            }
+            emit(columns, sel.data(), applyFilters(q, plan.filters, columns, sel.data(), length));
+            scanned += length;
+        }
+        return scanned;
+    }
+    return 0;
+}
+
+// Runs scan(part, parts, result) over the whole plan, returning rows
+// scanned. Serially that is one call with the whole plan as its only part.
+// On an executor every morsel is a part with a result of its own, and the
+// results are folded into `result` in morsel order, so the outcome does not
+// depend on which worker ran which morsel.
+template <typename Result, typename Scan, typename Fold>
+size_t runMorsels(const QueryPlan& plan, const ExpenseStore& store, ScanExecutor* executor, Result& result, Scan scan,
+                  Fold fold) {
+    if (!executor || !executor->shouldSplit(plan.candidate_rows)) {
+        return scan(0, 1, result);
+    }
+    const size_t morsels = morselCount(plan, store);
+    std::vector<Result> results(morsels);
+    std::vector<size_t> scanned(morsels, 0);
+    executor->run(morsels, [&](size_t morsel, size_t) { scanned[morsel] = scan(morsel, morsels, results[morsel]); });
+    size_t total = 0;
+    for (size_t morsel = 0; morsel < morsels; ++morsel) {
+        fold(result, results[morsel]);
+        total += scanned[morsel];
+    }
+    return total;
+}
+
+} // namespace
+
+QueryPlan planQuery(const ExpenseQuery& query, const ExpenseStore& store, const DateIndex& index,
+                    const TextIndex* text) {
+    QueryPlan plan;
+    CompiledQuery compiled;
+    if (!compile(query, store, compiled)) {
+        return plan;
+    }
+    size_t indexed = store.liveCount();
+    if (query.hasDateRange()) {
+        const auto range = index.findRange(compiled.first_day, compiled.last_day);
+        indexed = range.second - range.first;
+        if (indexed == 0) {
+            return plan;
+        }
+    }
+    std::vector<RowId> postings;
+    const bool byText = text && query.hasDescriptionTerms() &&
+                        text->candidates(query.descriptionSubstrings(), query.descriptionPrefixes(), store.size(),
+                                         postings);
+    if (byText && postings.empty()) {
+        return plan;
+    }
+    // Postings are read through row ids like an index slice, so they are
+    // costed the same way, and the smaller of the two candidate sets wins.
+    const bool useDates = query.hasDateRange() && indexed * kIndexCostFactor < store.size();
+    if (byText && postings.size() * kIndexCostFactor < store.size() && (!useDates || postings.size() < indexed)) {
+        plan.access = QueryPlan::Access::kTextIndex;
+        plan.candidate_rows = postings.size();
+        plan.postings = std::move(postings);
+        // Postings keep tombstoned rows (see TextIndex), which the date
+        // filter drops.
+        if (query.hasDateRange() || store.deadCount() > 0) {
+            plan.filters.push_back(QueryPlan::Filter::kDate);
+        }
+    } else if (useDates) {
+        plan.access = QueryPlan::Access::kDateIndex;
+        plan.candidate_rows = indexed;
+        // The slice keeps deleted rows too (see DateIndex).
+        if (store.deadCount() > 0) {
+            plan.filters.push_back(QueryPlan::Filter::kDate);
+        }
+    } else {
+        plan.access = QueryPlan::Access::kFullScan;
+        plan.candidate_rows = store.size();
+        // The date filter also drops tombstoned rows, so a scan needs it even
+        // for an unbounded query unless every row is live.
+        if (query.hasDateRange() || store.deadCount() > 0) {
+            plan.filters.push_back(QueryPlan::Filter::kDate);
+        }
+    }
+
+    // Residual filters, most selective first as far as the dictionary tells:
+    // a category set naming under half the categories is expected to beat a
+    // type filter (at best one of two values), and amount ranges come after
+    // both. Descriptions are always last.
+    const bool byType = query.typeMask() != ExpenseQuery::kAllTypes;
+    const bool byCategory = !query.categories().empty();
+    const bool categoryFirst = byCategory && query.categories().size() * 2 < store.categoryCount();
+    if (categoryFirst) {
+        plan.filters.push_back(QueryPlan::Filter::kCategory);
+    }
+    if (byType) {
+        plan.filters.push_back(QueryPlan::Filter::kType);
+    }
+    if (byCategory && !categoryFirst) {
+        plan.filters.push_back(QueryPlan::Filter::kCategory);
+    }
+    if (query.hasAmountRange()) {
+        plan.filters.push_back(QueryPlan::Filter::kAmount);
+    }
+    if (query.hasDescriptionTerms()) {
+        plan.filters.push_back(QueryPlan::Filter::kDescription);
+    }
+    return plan;
+}
+
+size_t selectRows(const ExpenseQuery& query, const QueryPlan& plan, const ExpenseStore& store,
+                  const DateIndex& index, std::vector<RowId>& rows, ScanExecutor* executor) {
+    CompiledQuery compiled;
+    if (plan.access == QueryPlan::Access::kEmpty || !compile(query, store, compiled)) {
+        return 0;
+    }
+    const size_t first = rows.size();
+    const auto scan = [&](size_t part, size_t parts, std::vector<RowId>& into) {
+        return execute(compiled, plan, store, index, part, parts, [&](const auto& columns, uint32_t* sel,
+                                                                      size_t count) {
+            for (size_t k = 0; k < count; ++k) {
+                into.push_back(columns.row(sel[k]));
+            }
+        });
+    };
+    const size_t scanned = runMorsels(plan, store, executor, rows, scan, [](std::vector<RowId>& all,
+                                                                            const std::vector<RowId>& part) {
+        all.insert(all.end(), part.begin(), part.end());
+    });
+    if (plan.access != QueryPlan::Access::kDateIndex) {
+        // A scan or a posting list yields row order; ledgers are usually
+        // appended in date order, so the sort is mostly skipped.
+        auto byDay = [&](RowId a, RowId b) { return store.dayNumberAt(a) < store.dayNumberAt(b); };
+        if (!std::is_sorted(rows.begin() + first, rows.end(), byDay)) {
+            std::stable_sort(rows.begin() + first, rows.end(), byDay);
+        }
+    }
+    return scanned;
+}
+
+size_t aggregateRows(const ExpenseQuery& query, const QueryPlan& plan, const ExpenseStore& store,
+                     const DateIndex& index, AmountAggregate& acc, ScanExecutor* executor) {
+    CompiledQuery compiled;
+    if (plan.access == QueryPlan::Access::kEmpty || !compile(query, store, compiled)) {
+        return 0;
+    }
+    // Date-only (or no) predicate: the vectorized kernel needs no selection vector.
+    const bool kernel = plan.access == QueryPlan::Access::kFullScan &&
+                        (plan.filters.empty() ||
+                         (plan.filters.size() == 1 && plan.filters[0] == QueryPlan::Filter::kDate));
+    const auto scan = [&](size_t part, size_t parts, AmountAggregate& into) -> size_t {
+        if (kernel) {
+            const ChunkedColumn<int32_t>& days = store.dayNumbers();
+            const size_t chunks = days.chunkCount();
+            size_t scanned = 0;
+            for (size_t chunk = chunks * part / parts; chunk < chunks * (part + 1) / parts; ++chunk) {
+                aggregateDayRange(days.chunkData(chunk), store.amounts().chunkData(chunk), days.chunkLength(chunk),
+                                  compiled.first_day, compiled.last_day, into);
+                scanned += days.chunkLength(chunk);
+            }
+            return scanned;
+        }
+        return execute(compiled, plan, store, index, part, parts, [&](const auto& columns, uint32_t* sel,
+                                                                      size_t count) {
+            AmountAggregate local;
+            for (size_t k = 0; k < count; ++k) {
+                const double amount = columns.amount(sel[k]);
+                local.sum += amount;
+                local.min = std::min(local.min, amount);
+                local.max = std::max(local.max, amount);
+            }
+            local.count = count;
+            into.merge(local);
+        });
+    };
+    return runMorsels(plan, store, executor, acc, scan, [](AmountAggregate& all, const AmountAggregate& part) {
+        all.merge(part);
+    });
+}
+
+size_t morselCount(const QueryPlan& plan, const ExpenseStore& store) {
+    // execute() cuts a scan at chunk boundaries and an index path anywhere.
+    return plan.access == QueryPlan::Access::kFullScan
+               ? store.dayNumbers().chunkCount()
+               : (plan.candidate_rows + ScanExecutor::kMorselRows - 1) / ScanExecutor::kMorselRows;
+}
+
+size_t scanMatchingRows(const ExpenseQuery& query, const QueryPlan& plan, const ExpenseStore& store,
+                        const DateIndex& index, size_t part, size_t parts, const RowBlockSink& sink) {
+    CompiledQuery compiled;
+    if (plan.access == QueryPlan::Access::kEmpty || !compile(query, store, compiled)) {
+        return 0;
+    }
+    return execute(compiled, plan, store, index, part, parts, [&](const auto& columns, uint32_t* sel, size_t count) {
+        for (size_t k = 0; k < count; ++k) {
+            sel[k] = columns.row(sel[k]); // Chunk offsets become store rows in place
+        }
+        if (count) {
+            sink(sel, count);
+        }
+    });
+}
+
+} // namespace expense_tracker
@@ -0,0 +1,166 @@
+#include "ExpenseRollups.h"
+#include "ExpenseStore.h"
+
+namespace expense_tracker {
+
+namespace {
+
+void applyTo(ExpenseTotal& total, double amount, int delta) {
+    if (delta > 0) {
+        total.sum += amount;
+        ++total.count;
+    } else if (total.count > 0) {
+        // Reset on the last removal so floating-point residue cannot accumulate.
+        total.sum = (--total.count == 0) ? 0.0 : total.sum - amount;
+    }
+}
+
+template <typename Map>
+void applyToKey(Map& map, int32_t key, double amount, int delta) {
+    ExpenseTotal& total = map[key];
+    applyTo(total, amount, delta);
+    if (total.count == 0) {
+        map.erase(key);
+    }
+}
+
+template <typename Map>
+ExpenseTotal lookup(const Map& map, int32_t key) {
+    auto it = map.find(key);
+    return it == map.end() ? ExpenseTotal{} : it->second;
+}
+
+} // namespace
+
+void ExpenseRollups::add(int32_t day, CategoryId category, double amount) {
+    apply(day, category, amount, +1);
+}
+
+void ExpenseRollups::remove(int32_t day, CategoryId category, double amount) {
+    apply(day, category, amount, -1);
+}
+
+void ExpenseRollups::apply(int32_t day, CategoryId category, double amount, int delta) {
+    applyToKey(days_, day, amount, delta);
+    if (day == kNoDayNumber) {
+        return;
+    }
+    const Date date = fromDayNumber(day);
+    const int32_t month = monthKey(date.year, date.month);
+    applyToKey(months_, month, amount, delta);
+    applyToKey(years_, date.year, amount, delta);
+
+    std::vector<ExpenseTotal>& byCategory = month_categories_[month];
+    if (byCategory.size() <= category) {
+        byCategory.resize(category + 1);
+    }
+    applyTo(byCategory[category], amount, delta);
+}
+
+void ExpenseRollups::rebuild(const ExpenseStore& store) {
+    clear();
+    int32_t lastDay = kNoDayNumber;
+    Date lastDate;
+    for (size_t row = 0; row < store.size(); ++row) {
+        if (!store.isLive(row)) {
+            continue;
+        }
+        const int32_t day = store.dayNumberAt(row);
+        const double amount = store.amountAt(row);
+        applyTo(days_[day], amount, +1);
+        if (day == kNoDayNumber) {
+            continue;
+        }
+        if (day != lastDay) { // Ledgers cluster by date; skip the civil conversion for repeats
+            lastDay = day;
+            lastDate = fromDayNumber(day);
+        }
+        const int32_t month = monthKey(lastDate.year, lastDate.month);
+        const CategoryId category = store.categoryIdAt(row);
+        applyTo(months_[month], amount, +1);
+        applyTo(years_[lastDate.year], amount, +1);
+
+        std::vector<ExpenseTotal>& byCategory = month_categories_[month];
+        if (byCategory.size() <= category) {
+            byCategory.resize(category + 1);
+        }
+        applyTo(byCategory[category], amount, +1);
+    }
+}
+
+void ExpenseRollups::clear() {
+    days_.clear();
+    months_.clear();
+    years_.clear();
+    month_categories_.clear();
+}
+
+ExpenseTotal ExpenseRollups::forDay(int32_t day) const {
+    return lookup(days_, day);
+}
+
+ExpenseTotal ExpenseRollups::forMonth(int month, int year) const {
+    if (month < 1 || month > 12) {
+        return ExpenseTotal{}; // monthKey would alias a neighbouring month
+    }
+    return lookup(months_, monthKey(year, month));
+}
+
+ExpenseTotal ExpenseRollups::forYear(int year) const {
+    return lookup(years_, year);
+}
+
+const std::vector<ExpenseTotal>* ExpenseRollups::forMonthByCategory(int month, int year) const {
+    if (month < 1 || month > 12) {
+        return nullptr;
+    }
+    auto it = month_categories_.find(monthKey(year, month));
+    return it == month_categories_.end() ? nullptr : &it->second;
+}
+
+std::vector<RollupEntry> ExpenseRollups::exportEntries() const {
+    std::vector<RollupEntry> entries;
+    auto emit = [&entries](RollupEntry::Kind kind, int32_t key, uint32_t category, const ExpenseTotal& total) {
+        entries.push_back(RollupEntry{kind, key, category, 0, total.sum, static_cast<uint64_t>(total.count)});
+    };
+    for (const auto& entry : days_) {
+        emit(RollupEntry::kDay, entry.first, 0, entry.second);
+    }
+    for (const auto& entry : months_) {
+        emit(RollupEntry::kMonth, entry.first, 0, entry.second);
+    }
+    for (const auto& entry : years_) {
+        emit(RollupEntry::kYear, entry.first, 0, entry.second);
+    }
+    for (const auto& entry : month_categories_) {
+        for (size_t id = 0; id < entry.second.size(); ++id) {
+            if (entry.second[id].count > 0) {
+                emit(RollupEntry::kMonthCategory, entry.first, static_cast<uint32_t>(id), entry.second[id]);
+            }
+        }
+    }
+    return entries;
+}
+
+void ExpenseRollups::importEntries(const RollupEntry* entries, size_t count) {
+    clear();
+    for (size_t i = 0; i < count; ++i) {
+        const RollupEntry& entry = entries[i];
+        const ExpenseTotal total{entry.sum, static_cast<size_t>(entry.count)};
+        switch (entry.kind) {
+            case RollupEntry::kDay: days_[entry.key] = total; break;
+            case RollupEntry::kMonth: months_[entry.key] = total; break;
+            case RollupEntry::kYear: years_[entry.key] = total; break;
+            case RollupEntry::kMonthCategory: {
+                std::vector<ExpenseTotal>& byCategory = month_categories_[entry.key];
+                if (byCategory.size() <= entry.category) {
+                    byCategory.resize(entry.category + 1);
+                }
+                byCategory[entry.category] = total;
+                break;
+            }
+        }
+    }
+}
+
+} // namespace expense_tracker
@@ -0,0 +1,568 @@
+#include "ExpenseSegment.h"
+#include "AtomicFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace expense_tracker {
+
+namespace {
+
+constexpr char kMagic[8] = {'E', 'X', 'P', 'S', 'E', 'G', '\0', '\0'};
+constexpr size_t kHeaderBytes = sizeof(kMagic) + 4;
+constexpr size_t kTrailerBytes = 3 * 8 + sizeof(kMagic);
+constexpr size_t kDirectoryEntryBytes = 8 + 8 + 4 + 4 + 4;
+
+enum AmountEncoding : uint8_t {
+    kCents = 0, // Frame of reference over integer cents
+    kRaw = 1,   // Little-endian IEEE doubles
+};
+
+struct BlockInfo {
+    uint64_t offset = 0;
+    uint64_t bytes = 0;
+    uint32_t rows = 0;
+    int32_t first_day = 0;
+    int32_t last_day = 0;
+};
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Bits needed to store every value in [0, max].
+int bitWidth(uint64_t max) {
+    int width = 0;
+    while (max) {
+        ++width;
+        max >>= 1;
+    }
+    return width;
+}
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+void putFixed(std::string& out, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+uint64_t getFixed(const char* data, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    }
+    return value;
+}
+
+// Appends values of a fixed bit width, least significant bits first.
+class BitPacker {
+public:
+    BitPacker(std::string& out, int width) : out_(out), width_(width) {}
+    ~BitPacker() { flush(); }
+
+    void put(uint64_t value) {
+        if (width_ == 0) {
+            return;
+        }
+        for (int written = 0; written < width_;) {
+            const int take = std::min(width_ - written, 64 - used_);
+            const uint64_t bits = take == 64 ? value : (value >> written) & ((uint64_t{1} << take) - 1);
+            acc_ |= bits << used_;
+            used_ += take;
+            written += take;
+            if (used_ == 64) {
+                putFixed(out_, acc_, 8);
+                acc_ = 0;
+                used_ = 0;
+            }
+        }
+    }
+
+    void flush() {
+        putFixed(out_, acc_, static_cast<size_t>((used_ + 7) / 8));
+        acc_ = 0;
+        used_ = 0;
+    }
+
+private:
+    std::string& out_;
+    int width_;
+    uint64_t acc_ = 0;
+    int used_ = 0;
+};
+
+// Bounds-checked reads over one block or section; any overrun clears ok().
+class ByteReader {
+public:
+    ByteReader(const char* data, size_t size) : pos_(data), end_(data + size) {}
+
+    bool ok() const { return ok_; }
+    bool atEnd() const { return pos_ == end_; }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos_ == end_) {
+                break;
+            }
+            const auto byte = static_cast<unsigned char>(*pos_++);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        ok_ = false;
+        return 0;
+    }
+
+    uint8_t byte() {
+        const char* data = take(1);
+        return data ? static_cast<uint8_t>(*data) : 0;
+    }
+
+    uint64_t fixed(size_t bytes) {
+        const char* data = take(bytes);
+        return data ? getFixed(data, bytes) : 0;
+    }
+
+    std::string_view bytes(size_t count) {
+        const char* data = take(count);
+        return data ? std::string_view(data, count) : std::string_view();
+    }
+
+    // Reads `count` values of `width` bits packed by BitPacker.
+    void unpack(size_t count, int width, std::vector<uint64_t>& values) {
+        values.assign(count, 0);
+        if (width == 0) {
+            return;
+        }
+        const size_t byteCount = (count * static_cast<size_t>(width) + 7) / 8;
+        const char* data = take(byteCount);
+        if (!data) {
+            return;
+        }
+        // Each value is at most 9 bytes wide; load them 8 at a time.
+        auto load = [&](size_t index) { return getFixed(data + index, std::min<size_t>(8, byteCount - index)); };
+        const uint64_t mask = width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+        size_t bit = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const size_t index = bit / 8;
+            const int offset = static_cast<int>(bit % 8);
+            uint64_t value = load(index) >> offset;
+            if (offset + width > 64) {
+                value |= load(index + 8) << (64 - offset);
+            }
+            values[i] = value & mask;
+            bit += static_cast<size_t>(width);
+        }
+    }
+
+private:
+    const char* take(size_t count) {
+        if (!ok_ || static_cast<size_t>(end_ - pos_) < count) {
+            ok_ = false;
+            return nullptr;
+        }
+        const char* data = pos_;
+        pos_ += count;
+        return data;
+    }
+
+    const char* pos_;
+    const char* end_;
+    bool ok_ = true;
+};
+
+bool toCents(double amount, int64_t& cents) {
+    // 2^53 / 100: beyond this, cents no longer map one-to-one onto doubles.
+    if (!std::isfinite(amount) || std::fabs(amount) > 9.0e13) {
+        return false;
+    }
+    cents = std::llround(amount * 100.0);
+    return static_cast<double>(cents) / 100.0 == amount;
+}
+
+void encodeBlock(std::string& out, const ExpenseStore& store, const std::vector<RowId>& rows, int categoryWidth) {
+    putVarint(out, rows.size());
+
+    int32_t previousDay = store.dayNumberAt(rows[0]);
+    putVarint(out, zigzag(previousDay));
+    for (size_t i = 1; i < rows.size(); ++i) {
+        const int32_t day = store.dayNumberAt(rows[i]);
+        putVarint(out, static_cast<uint64_t>(static_cast<int64_t>(day) - previousDay));
+        previousDay = day;
+    }
+
+    ExpenseId previousId = 0;
+    for (RowId row : rows) {
+        putVarint(out, zigzag(static_cast<int64_t>(store.idAt(row) - previousId)));
+        previousId = store.idAt(row);
+    }
+
+    {
+        BitPacker types(out, 1);
+        for (RowId row : rows) {
+            types.put(static_cast<uint64_t>(store.typeAt(row)));
+        }
+    }
+    {
+        BitPacker categories(out, categoryWidth);
+        for (RowId row : rows) {
+            categories.put(store.categoryIdAt(row));
+        }
+    }
+
+    std::vector<int64_t> cents(rows.size());
+    bool exact = true;
+    for (size_t i = 0; i < rows.size() && exact; ++i) {
+        exact = toCents(store.amountAt(rows[i]), cents[i]);
+    }
+    if (exact) {
+        const auto range = std::minmax_element(cents.begin(), cents.end());
+        const int64_t base = *range.first;
+        const int width = bitWidth(static_cast<uint64_t>(*range.second - base));
+        out.push_back(static_cast<char>(kCents));
+        putVarint(out, zigzag(base));
+        out.push_back(static_cast<char>(width));
+        BitPacker amounts(out, width);
+        for (int64_t value : cents) {
+            amounts.put(static_cast<uint64_t>(value - base));
+        }
+    } else {
+        out.push_back(static_cast<char>(kRaw));
+        for (RowId row : rows) {
+            uint64_t bits;
+            const double amount = store.amountAt(row);
+            std::memcpy(&bits, &amount, sizeof(bits));
+            putFixed(out, bits, 8);
+        }
+    }
+
+    std::vector<std::string_view> dictionary;
+    dictionary.reserve(rows.size());
+    for (RowId row : rows) {
+        dictionary.push_back(store.descriptionAt(row));
+    }
+    std::sort(dictionary.begin(), dictionary.end());
+    dictionary.erase(std::unique(dictionary.begin(), dictionary.end()), dictionary.end());
+    putVarint(out, dictionary.size());
+    std::string_view previous;
+    for (std::string_view entry : dictionary) {
+        size_t shared = 0;
+        while (shared < previous.size() && shared < entry.size() && previous[shared] == entry[shared]) {
+            ++shared;
+        }
+        putVarint(out, shared);
+        putVarint(out, entry.size() - shared);
+        out.append(entry.data() + shared, entry.size() - shared);
+        previous = entry;
+    }
+    BitPacker indexes(out, bitWidth(dictionary.size() - 1));
+    for (RowId row : rows) {
+        const auto it = std::lower_bound(dictionary.begin(), dictionary.end(), store.descriptionAt(row));
+        indexes.put(static_cast<uint64_t>(it - dictionary.begin()));
+    }
+}
+
+// Decoded columns of one block; descriptions index into `dictionary`.
+struct DecodedBlock {
+    std::vector<int32_t> days;
+    std::vector<ExpenseId> ids;
+    std::vector<uint64_t> types;
+    std::vector<uint64_t> categories;
+    std::vector<double> amounts;
+    std::vector<std::string> dictionary;
+    std::vector<uint64_t> descriptions;
+};
+
+bool decodeBlock(const std::string& data, size_t categoryCount, int categoryWidth, DecodedBlock& block) {
+    ByteReader in(data.data(), data.size());
+    const size_t rows = static_cast<size_t>(in.varint());
+    if (!in.ok() || rows == 0 || rows > kSegmentBlockRows) {
+        return false;
+    }
+
+    block.days.resize(rows);
+    int64_t day = unzigzag(in.varint());
+    for (size_t i = 0; i < rows; ++i) {
+        if (i > 0) {
+            day += static_cast<int64_t>(in.varint());
+        }
+        block.days[i] = static_cast<int32_t>(day);
+    }
+
+    block.ids.resize(rows);
+    ExpenseId id = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        id += static_cast<ExpenseId>(unzigzag(in.varint()));
+        block.ids[i] = id;
+    }
+
+    in.unpack(rows, 1, block.types);
+    in.unpack(rows, categoryWidth, block.categories);
+
+    block.amounts.resize(rows);
+    const uint8_t encoding = in.byte();
+    if (encoding == kCents) {
+        const int64_t base = unzigzag(in.varint());
+        const int width = in.byte();
+        if (width > 64) {
+            return false;
+        }
+        std::vector<uint64_t> offsets;
+        in.unpack(rows, width, offsets);
+        for (size_t i = 0; i < rows; ++i) {
+            block.amounts[i] = static_cast<double>(base + static_cast<int64_t>(offsets[i])) / 100.0;
+        }
+    } else if (encoding == kRaw) {
+        for (size_t i = 0; i < rows; ++i) {
+            const uint64_t bits = in.fixed(8);
+            std::memcpy(&block.amounts[i], &bits, sizeof(bits));
+        }
+    } else {
+        return false;
+    }
+
+    const size_t entries = static_cast<size_t>(in.varint());
+    if (!in.ok() || entries == 0 || entries > rows) {
+        return false;
+    }
+    block.dictionary.resize(entries);
+    for (size_t i = 0; i < entries; ++i) {
+        const size_t shared = static_cast<size_t>(in.varint());
+        const size_t rest = static_cast<size_t>(in.varint());
+        if (!in.ok() || (i == 0 ? shared != 0 : shared > block.dictionary[i - 1].size())) {
+            return false;
+        }
+        block.dictionary[i].assign(i == 0 ? std::string() : block.dictionary[i - 1].substr(0, shared));
+        const std::string_view suffix = in.bytes(rest);
+        block.dictionary[i].append(suffix.data(), suffix.size());
+    }
+    in.unpack(rows, bitWidth(entries - 1), block.descriptions);
+
+    if (!in.ok() || !in.atEnd()) {
+        return false;
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        if (block.categories[i] >= categoryCount || block.descriptions[i] >= entries) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool readAt(std::ifstream& in, uint64_t offset, size_t size, std::string& buffer) {
+    buffer.resize(size);
+    in.seekg(static_cast<std::streamoff>(offset));
+    in.read(&buffer[0], static_cast<std::streamsize>(size));
+    return static_cast<bool>(in);
+}
+
+} // namespace
+
+bool writeSegment(const std::string& path, const ExpenseStore& store, const ExpenseView& rowsByDate) {
+    const std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open segment file for writing: " << tempPath << std::endl;
+        return false;
+    }
+
+    std::string buffer(kMagic, sizeof(kMagic));
+    putFixed(buffer, kSegmentVersion, 4);
+    putVarint(buffer, store.categoryCount());
+    for (const std::string& name : store.categoryNames()) {
+        putVarint(buffer, name.size());
+        buffer += name;
+    }
+    const int categoryWidth = bitWidth(store.categoryCount() > 0 ? store.categoryCount() - 1 : 0);
+
+    uint64_t position = 0;
+    std::vector<BlockInfo> directory;
+    std::vector<RowId> rows;
+    rows.reserve(kSegmentBlockRows);
+    auto flushBlock = [&] {
+        BlockInfo info;
+        info.offset = position + buffer.size();
+        info.rows = static_cast<uint32_t>(rows.size());
+        info.first_day = store.dayNumberAt(rows.front());
+        info.last_day = store.dayNumberAt(rows.back());
+        encodeBlock(buffer, store, rows, categoryWidth);
+        info.bytes = position + buffer.size() - info.offset;
+        directory.push_back(info);
+        rows.clear();
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        position += buffer.size();
+        buffer.clear();
+    };
+    uint64_t rowCount = 0;
+    for (size_t i = 0; i < rowsByDate.size(); ++i) {
+        const size_t row = rowsByDate.rowId(i);
+        if (!store.isLive(row)) {
+            continue;
+        }
+        rows.push_back(static_cast<RowId>(row));
+        ++rowCount;
+        if (rows.size() == kSegmentBlockRows) {
+            flushBlock();
+        }
+    }
+    if (!rows.empty()) {
+        flushBlock();
+    }
+
+    const uint64_t directoryOffset = position + buffer.size();
+    for (const BlockInfo& info : directory) {
+        putFixed(buffer, info.offset, 8);
+        putFixed(buffer, info.bytes, 8);
+        putFixed(buffer, info.rows, 4);
+        putFixed(buffer, static_cast<uint32_t>(info.first_day), 4);
+        putFixed(buffer, static_cast<uint32_t>(info.last_day), 4);
+    }
+    putFixed(buffer, directoryOffset, 8);
+    putFixed(buffer, rowCount, 8);
+    putFixed(buffer, store.nextId(), 8);
+    buffer.append(kMagic, sizeof(kMagic));
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+
+    out.close();
+    if (!out) {
+        std::cerr << "Error: An error occurred while writing segment file: " << tempPath << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    if (!replaceFile(tempPath, path)) {
+        std::cerr << "Error: Could not move segment into place: " << path << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool hasSegmentExtension(const std::string& path) {
+    constexpr std::string_view kExtension = ".seg";
+    return path.size() > kExtension.size() && path.compare(path.size() - kExtension.size(), kExtension.size(),
+                                                           kExtension.data()) == 0;
+}
+
+bool isSegmentFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    return in.read(magic, sizeof(magic)) && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+bool scanSegment(const std::string& path, int32_t firstDay, int32_t lastDay, const SegmentRowHandler& onRow,
+                 SegmentScanStats* stats) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) {
+        std::cerr << "Error: Could not open file for reading: " << path << std::endl;
+        return false;
+    }
+    const uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+    auto malformed = [&path](const char* what) {
+        std::cerr << "Error: Malformed segment file " << path << ": " << what << std::endl;
+        return false;
+    };
+
+    std::string buffer;
+    if (fileSize < kHeaderBytes + kTrailerBytes || !readAt(in, 0, kHeaderBytes, buffer) ||
+        std::memcmp(buffer.data(), kMagic, sizeof(kMagic)) != 0) {
+        return malformed("bad header");
+    }
+    if (getFixed(buffer.data() + sizeof(kMagic), 4) != kSegmentVersion) {
+        return malformed("unsupported version");
+    }
+    if (!readAt(in, fileSize - kTrailerBytes, kTrailerBytes, buffer) ||
+        std::memcmp(buffer.data() + 24, kMagic, sizeof(kMagic)) != 0) {
+        return malformed("bad trailer (truncated file?)");
+    }
+    const uint64_t directoryOffset = getFixed(buffer.data(), 8);
+    const ExpenseId nextId = getFixed(buffer.data() + 16, 8);
+    const uint64_t directoryBytes = fileSize - kTrailerBytes - std::min(directoryOffset, fileSize - kTrailerBytes);
+    if (directoryOffset < kHeaderBytes || directoryBytes % kDirectoryEntryBytes != 0) {
+        return malformed("bad block directory");
+    }
+
+    std::vector<BlockInfo> directory(directoryBytes / kDirectoryEntryBytes);
+    if (!readAt(in, directoryOffset, directoryBytes, buffer)) {
+        return malformed("bad block directory");
+    }
+    for (size_t i = 0; i < directory.size(); ++i) {
+        const char* entry = buffer.data() + i * kDirectoryEntryBytes;
+        BlockInfo& info = directory[i];
+        info.offset = getFixed(entry, 8);
+        info.bytes = getFixed(entry + 8, 8);
+        info.rows = static_cast<uint32_t>(getFixed(entry + 16, 4));
+        info.first_day = static_cast<int32_t>(getFixed(entry + 20, 4));
+        info.last_day = static_cast<int32_t>(getFixed(entry + 24, 4));
+        if (info.offset < kHeaderBytes || info.offset > directoryOffset || info.bytes > directoryOffset - info.offset) {
+            return malformed("block outside the file");
+        }
+    }
+
+    // The category dictionary sits between the header and the first block.
+    const uint64_t dictionaryEnd = directory.empty() ? directoryOffset : directory.front().offset;
+    if (!readAt(in, kHeaderBytes, dictionaryEnd - kHeaderBytes, buffer)) {
+        return malformed("bad category dictionary");
+    }
+    ByteReader header(buffer.data(), buffer.size());
+    std::vector<std::string> categories(static_cast<size_t>(std::min<uint64_t>(header.varint(), buffer.size())));
+    for (std::string& name : categories) {
+        const std::string_view bytes = header.bytes(static_cast<size_t>(header.varint()));
+        name.assign(bytes.data(), bytes.size());
+    }
+    if (!header.ok() || !header.atEnd()) {
+        return malformed("bad category dictionary");
+    }
+    const int categoryWidth = bitWidth(categories.empty() ? 0 : categories.size() - 1);
+
+    if (stats) {
+        *stats = SegmentScanStats{};
+        stats->blocks = directory.size();
+        stats->bytes_read = kHeaderBytes + buffer.size() + directoryBytes + kTrailerBytes;
+        stats->next_id = nextId;
+    }
+    DecodedBlock block;
+    for (const BlockInfo& info : directory) {
+        if (info.last_day < firstDay || info.first_day > lastDay) {
+            continue; // Skipped by date without reading it
+        }
+        if (!readAt(in, info.offset, static_cast<size_t>(info.bytes), buffer)) {
+            return malformed("truncated block");
+        }
+        if (!decodeBlock(buffer, categories.size(), categoryWidth, block) || block.days.size() != info.rows) {
+            return malformed("corrupt block");
+        }
+        if (stats) {
+            ++stats->blocks_read;
+            stats->bytes_read += info.bytes;
+        }
+        // Days are sorted, so the rows in range are one contiguous run.
+        const auto begin = std::lower_bound(block.days.begin(), block.days.end(), firstDay);
+        const auto end = std::upper_bound(begin, block.days.end(), lastDay);
+        for (size_t i = static_cast<size_t>(begin - block.days.begin());
+             i < static_cast<size_t>(end - block.days.begin()); ++i) {
+            onRow(block.dictionary[block.descriptions[i]], block.amounts[i], block.days[i],
+                  categories[block.categories[i]], static_cast<TransactionType>(block.types[i]), block.ids[i]);
+        }
+    }
+    return true;
+}
+
+} // namespace expense_tracker
@@ -0,0 +1,251 @@
+#include "ExpenseStore.h"
+
+namespace expense_tracker {
+
+std::vector<Expense> ExpenseView::toVector() const {
+    std::vector<Expense> result;
+    result.reserve(size());
+    for (const ExpenseRow row : *this) {
+        result.push_back(row.toExpense());
+    }
+    return result;
+}
+
+ExpenseId ExpenseStore::append(const Expense& expense) {
+    return append(expense.description, expense.amount, toDayNumber(expense.date),
+                  expense.category, expense.transaction_type);
+}
+
+ExpenseId ExpenseStore::append(std::string_view description, double amount, int32_t dayNumber,
+                               std::string_view category, TransactionType type, ExpenseId id) {
+    if (id == kNoExpenseId || id < next_id_) {
+        id = next_id_; // Keeps ids unique and ascending in row order
+    }
+    next_id_ = id + 1;
+    pushRow(description, amount, dayNumber, category, type, id);
+    return id;
+}
+
+ExpenseId ExpenseStore::restore(std::string_view description, double amount, int32_t dayNumber,
+                                std::string_view category, TransactionType type, ExpenseId id) {
+    if (!ids_.empty() && id < ids_[ids_.size() - 1]) {
+        ids_ascending_ = false;
+    }
+    next_id_ = std::max(next_id_, id + 1);
+    pushRow(description, amount, dayNumber, category, type, id);
+    return id;
+}
+
+void ExpenseStore::pushRow(std::string_view description, double amount, int32_t dayNumber,
+                           std::string_view category, TransactionType type, ExpenseId id) {
+    days_.push_back(dayNumber);
+    amounts_.push_back(amount);
+    categories_.push_back(internCategory(category));
+    types_.push_back(static_cast<uint8_t>(type));
+    description_handles_.push_back(descriptions_.append(description));
+    ids_.push_back(id);
+    if (rows_by_id_valid_) {
+        rows_by_id_.emplace(id, static_cast<RowId>(days_.size() - 1));
+    }
+}
+
+void ExpenseStore::tombstone(size_t row) {
+    if (!isLive(row)) {
+        return;
+    }
+    days_.set(row, kTombstoneDay);
+    ++dead_;
+    if (rows_by_id_valid_) {
+        rows_by_id_.erase(ids_[row]);
+    }
+}
+
+void ExpenseStore::compact(std::vector<RowId>* newRows) {
+    if (dead_ == 0) {
+        return;
+    }
+    if (newRows) {
+        newRows->assign(size(), kDroppedRow);
+    }
+    // Live rows slide down over dead ones; rows before the first dead row
+    // stay where they are and are never written (so borrowed chunks there
+    // are not copied).
+    size_t out = 0;
+    for (size_t row = 0; row < size(); ++row) {
+        if (!isLive(row)) {
+            continue;
+        }
+        if (out != row) {
+            days_.set(out, days_[row]);
+            amounts_.set(out, amounts_[row]);
+            categories_.set(out, categories_[row]);
+            types_.set(out, types_[row]);
+            description_handles_.set(out, description_handles_[row]);
+            ids_.set(out, ids_[row]);
+        }
+        if (newRows) {
+            (*newRows)[row] = static_cast<RowId>(out);
+        }
+        ++out;
+    }
+    while (size() > out) {
+        days_.pop_back();
+        amounts_.pop_back();
+        categories_.pop_back();
+        types_.pop_back();
+        description_handles_.pop_back();
+        ids_.pop_back();
+    }
+    dead_ = 0;
+    rows_by_id_.clear();
+    rows_by_id_valid_ = false;
+}
+
+void ExpenseStore::clear() {
+    days_.clear();
+    amounts_.clear();
+    categories_.clear();
+    types_.clear();
+    description_handles_.clear();
+    ids_.clear();
+    descriptions_.clear();
+    category_names_.clear();
+    category_ids_.clear();
+    next_id_ = 0;
+    ids_ascending_ = true;
+    dead_ = 0;
+    rows_by_id_.clear();
+    rows_by_id_valid_ = false;
+}
+
+bool ExpenseStore::findRow(ExpenseId id, size_t& row) const {
+    if (shared_copy_) {
+        size_t low = 0, high = size();
+        while (low < high) {
+            const size_t mid = low + (high - low) / 2;
+            if (ids_[mid] < id) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        if (low < size() && ids_[low] == id) {
+            row = low;
+            return isLive(low);
+        }
+        if (ids_ascending_) {
+            return false;
+        }
+        for (size_t r = 0; r < size(); ++r) {
+            if (ids_[r] == id) {
+                row = r;
+                return isLive(r);
+            }
+        }
+        return false;
+    }
+    if (!rows_by_id_valid_) {
+        rows_by_id_.clear();
+        rows_by_id_.reserve(liveCount());
+        for (size_t r = 0; r < size(); ++r) {
+            if (isLive(r)) {
+                rows_by_id_.emplace(ids_[r], static_cast<RowId>(r));
+            }
+        }
+        rows_by_id_valid_ = true;
+    }
+    auto it = rows_by_id_.find(id);
+    if (it == rows_by_id_.end()) {
+        return false;
+    }
+    row = it->second;
+    return true;
+}
+
+ExpenseStore ExpenseStore::share() const {
+    // Member by member: the id map is deliberately left out (copying it is
+    // O(rows), and the writer may be rebuilding it).
+    ExpenseStore copy;
+    copy.days_ = days_;
+    copy.amounts_ = amounts_;
+    copy.categories_ = categories_;
+    copy.types_ = types_;
+    copy.description_handles_ = description_handles_;
+    copy.ids_ = ids_;
+    copy.descriptions_ = descriptions_;
+    copy.next_id_ = next_id_;
+    copy.ids_ascending_ = ids_ascending_;
+    copy.dead_ = dead_;
+    copy.shared_copy_ = true;
+    copy.category_names_ = category_names_;
+    copy.indexCategories();
+    return copy;
+}
+
+ExpenseRow ExpenseStore::row(size_t row) const {
+    return ExpenseRow{descriptionAt(row), amountAt(row), fromDayNumber(dayNumberAt(row)),
+                      categoryAt(row), typeAt(row), idAt(row)};
+}
+
+bool ExpenseStore::findCategory(const std::string& name, CategoryId& id) const {
+    auto it = category_ids_.find(name);
+    if (it == category_ids_.end()) {
+        return false;
+    }
+    id = it->second;
+    return true;
+}
+
+size_t ExpenseStore::memoryUsage() const {
+    size_t total = days_.memoryUsage() + amounts_.memoryUsage() + categories_.memoryUsage() +
+                   types_.memoryUsage() + description_handles_.memoryUsage() +
+                   ids_.memoryUsage() + descriptions_.memoryUsage();
+    for (const auto& name : category_names_) {
+        // Name stored once in the dictionary vector and once as the map key.
+        total += 2 * (sizeof(std::string) + name.capacity());
+    }
+    return total;
+}
+
+void ExpenseStore::borrowColumns(const MappedColumns& columns, const std::shared_ptr<const void>& owner) {
+    clear();
+    days_.borrow(columns.days, columns.rows, owner);
+    amounts_.borrow(columns.amounts, columns.rows, owner);
+    categories_.borrow(columns.categories, columns.rows, owner);
+    types_.borrow(columns.types, columns.rows, owner);
+    description_handles_.borrow(columns.description_handles, columns.rows, owner);
+    ids_.borrow(columns.ids, columns.rows, owner);
+    next_id_ = columns.next_id;
+    ids_ascending_ = columns.ids_ascending;
+    dead_ = columns.dead;
+    for (const auto& block : columns.description_blocks) {
+        descriptions_.borrowBlock(block.first, block.second, owner);
+    }
+    category_names_ = columns.category_names;
+    indexCategories();
+}
+
+CategoryId ExpenseStore::internCategory(std::string_view name) {
+    auto it = category_ids_.find(name);
+    if (it != category_ids_.end()) {
+        return it->second;
+    }
+    const auto id = static_cast<CategoryId>(category_names_.size());
+    const size_t capacity = category_names_.capacity();
+    category_names_.emplace_back(name);
+    if (category_names_.capacity() != capacity) {
+        indexCategories(); // Reallocated: short names moved along with their characters
+    } else {
+        category_ids_.emplace(category_names_.back(), id);
+    }
+    return id;
+}
+
+void ExpenseStore::indexCategories() {
+    category_ids_.clear();
+    for (size_t id = 0; id < category_names_.size(); ++id) {
+        category_ids_.emplace(category_names_[id], static_cast<CategoryId>(id));
+    }
+}
+
+} // namespace expense_tracker
@@ -0,0 +1,230 @@
+#include "GroupBy.h"
+#include "DateIndex.h"
+#include "ExpenseStore.h"
+#include "ScanExecutor.h"
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+
+namespace expense_tracker {
+
+namespace {
+
+// Packed group key, low to high: category id (28 bits), type (2), day of
+// month (5), month (4), year + kYearBias (24, enough for any packed day
+// number). Bit 63 stays clear, so ~0 can mark empty hash slots.
+constexpr int kTypeShift = 28;
+constexpr int kDayShift = 30;
+constexpr int kMonthShift = 35;
+constexpr int kYearShift = 39;
+constexpr uint64_t kCategoryMask = (uint64_t{1} << kTypeShift) - 1;
+constexpr int kYearBias = 1 << 23;
+constexpr uint64_t kEmptyKey = ~uint64_t{0};
+
+uint64_t hashKey(uint64_t key) {
+    key ^= key >> 31;
+    key *= 0x9E3779B97F4A7C15ull;
+    return key ^ (key >> 29);
+}
+
+uint64_t packDate(int32_t day, unsigned fields) {
+    if (!(fields & (kGroupYear | kGroupMonth | kGroupDay))) {
+        return 0;
+    }
+    const Date date = fromDayNumber(day);
+    uint64_t key = 0;
+    if (fields & kGroupYear) {
+        key |= static_cast<uint64_t>(date.year + kYearBias) << kYearShift;
+    }
+    if (fields & kGroupMonth) {
+        key |= static_cast<uint64_t>(date.month) << kMonthShift;
+    }
+    if (fields & kGroupDay) {
+        key |= static_cast<uint64_t>(date.day) << kDayShift;
+    }
+    return key;
+}
+
+// Open-addressing (linear probing) map from packed key to aggregate. Keys
+// and aggregates live in flat arrays; the table doubles at half load.
+class GroupTable {
+public:
+    AmountAggregate& at(uint64_t key, uint64_t hash) {
+        if (keys_.empty()) {
+            resize(64);
+        }
+        size_t slot = hash & mask_;
+        while (keys_[slot] != key) {
+            if (keys_[slot] == kEmptyKey) {
+                if ((size_ + 1) * 2 > keys_.size()) {
+                    resize(keys_.size() * 2);
+                    return at(key, hash);
+                }
+                keys_[slot] = key;
+                ++size_;
+                break;
+            }
+            slot = (slot + 1) & mask_;
+        }
+        return values_[slot];
+    }
+
+    size_t size() const { return size_; }
+
+    template <typename Visit>
+    void forEach(Visit visit) const {
+        for (size_t slot = 0; slot < keys_.size(); ++slot) {
+            if (keys_[slot] != kEmptyKey) {
+                visit(keys_[slot], values_[slot]);
+            }
+        }
+    }
+
+private:
+    void resize(size_t capacity) {
+        std::vector<uint64_t> keys(capacity, kEmptyKey);
+        std::vector<AmountAggregate> values(capacity);
+        keys.swap(keys_);
+        values.swap(values_);
+        mask_ = capacity - 1;
+        size_ = 0;
+        for (size_t slot = 0; slot < keys.size(); ++slot) {
+            if (keys[slot] != kEmptyKey) {
+                at(keys[slot], hashKey(keys[slot])) = values[slot];
+            }
+        }
+    }
+
+    std::vector<uint64_t> keys_;
+    std::vector<AmountAggregate> values_;
+    size_t mask_ = 0;
+    size_t size_ = 0;
+};
+
+GroupRow unpack(uint64_t key, const AmountAggregate& amounts, unsigned fields, const ExpenseStore& store) {
+    GroupRow row;
+    if (fields & kGroupYear) {
+        row.year = static_cast<int>(key >> kYearShift) - kYearBias;
+    }
+    row.month = static_cast<int>((key >> kMonthShift) & 0xF);
+    row.day = static_cast<int>((key >> kDayShift) & 0x1F);
+    if (fields & kGroupCategory) {
+        row.category = store.categoryName(static_cast<CategoryId>(key & kCategoryMask));
+    }
+    row.type = static_cast<TransactionType>((key >> kTypeShift) & 0x3);
+    row.amounts = amounts;
+    return row;
+}
+
+bool keyLess(const GroupRow& a, const GroupRow& b) {
+    return std::tie(a.year, a.month, a.day, a.category, a.type) < std::tie(b.year, b.month, b.day, b.category, b.type);
+}
+
+} // namespace
+
+std::vector<GroupRow> groupRows(const GroupBySpec& spec, const QueryPlan& plan, const ExpenseStore& store,
+                                const DateIndex& index, ScanExecutor* executor, size_t& scanned) {
+    scanned = 0;
+    const unsigned fields = spec.fields;
+    const bool split = executor && executor->shouldSplit(plan.candidate_rows);
+    const size_t workers = split ? executor->workers() : 1;
+    const size_t partitions = workers;
+    const size_t morsels = split ? morselCount(plan, store) : 1;
+
+    // Phase 1: each worker aggregates the morsels it runs into its own
+    // partitions. Calls on one worker never overlap, so they need no locks.
+    std::vector<GroupTable> tables(workers * partitions);
+    std::vector<size_t> scannedBy(workers, 0);
+    auto scanMorsel = [&](size_t morsel, size_t worker) {
+        GroupTable* mine = &tables[worker * partitions];
+        int32_t lastDay = ExpenseStore::kTombstoneDay; // Never a live row's day
+        uint64_t dateKey = 0;
+        scannedBy[worker] += scanMatchingRows(spec.filter, plan, store, index, morsel, morsels,
+                                              [&](const RowId* rows, size_t count) {
+            for (size_t k = 0; k < count; ++k) {
+                const RowId row = rows[k];
+                const int32_t day = store.dayNumberAt(row);
+                if (day != lastDay) { // Rows mostly arrive in date runs; decode each date once
+                    lastDay = day;
+                    dateKey = packDate(day, fields);
+                }
+                uint64_t key = dateKey;
+                if (fields & kGroupCategory) {
+                    key |= store.categoryIdAt(row);
+                }
+                if (fields & kGroupType) {
+                    key |= static_cast<uint64_t>(store.typeAt(row)) << kTypeShift;
+                }
+                const uint64_t hash = hashKey(key);
+                AmountAggregate& group = mine[(hash >> 32) % partitions].at(key, hash);
+                const double amount = store.amountAt(row);
+                group.sum += amount;
+                group.min = std::min(group.min, amount);
+                group.max = std::max(group.max, amount);
+                ++group.count;
+            }
+        });
+    };
+    if (split) {
+        executor->run(morsels, scanMorsel);
+    } else {
+        scanMorsel(0, 0);
+    }
+    for (size_t rows : scannedBy) {
+        scanned += rows;
+    }
+
+    // Phase 2: partition p of every worker is merged into merged[p].
+    std::vector<std::vector<GroupRow>> merged(partitions);
+    auto mergePartition = [&](size_t p, size_t) {
+        GroupTable table;
+        for (size_t w = 0; w < workers; ++w) {
+            tables[w * partitions + p].forEach([&](uint64_t key, const AmountAggregate& amounts) {
+                table.at(key, hashKey(key)).merge(amounts);
+            });
+            tables[w * partitions + p] = GroupTable(); // Free it as soon as it is folded in
+        }
+        merged[p].reserve(table.size());
+        table.forEach([&](uint64_t key, const AmountAggregate& amounts) {
+            merged[p].push_back(unpack(key, amounts, fields, store));
+        });
+    };
+    if (split) {
+        executor->run(partitions, mergePartition);
+    } else {
+        mergePartition(0, 0);
+    }
+
+    std::vector<GroupRow> groups;
+    for (std::vector<GroupRow>& part : merged) {
+        std::move(part.begin(), part.end(), std::back_inserter(groups));
+    }
+
+    auto order = [&](const GroupRow& a, const GroupRow& b) {
+        switch (spec.order) {
+        case GroupBySpec::Order::kSumDescending:
+            if (a.amounts.sum != b.amounts.sum) {
+                return a.amounts.sum > b.amounts.sum;
+            }
+            break;
+        case GroupBySpec::Order::kCountDescending:
+            if (a.amounts.count != b.amounts.count) {
+                return a.amounts.count > b.amounts.count;
+            }
+            break;
+        case GroupBySpec::Order::kKey:
+            break;
+        }
+        return keyLess(a, b);
+    };
+    if (spec.limit && spec.limit < groups.size()) {
+        std::partial_sort(groups.begin(), groups.begin() + static_cast<std::ptrdiff_t>(spec.limit), groups.end(),
+                          order);
+        groups.resize(spec.limit);
+    } else {
+        std::sort(groups.begin(), groups.end(), order);
+    }
+    return groups;
+}
+
+} // namespace expense_tracker
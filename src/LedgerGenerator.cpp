@@ -0,0 +1,80 @@
+#include "LedgerGenerator.h"
+#include "CsvCodec.h"
+#include <cstdio>
+#include <utility>
+
+namespace expense_tracker {
+
+namespace {
+
+const char* const kWords[] = {
+    "coffee", "rent", "grocery", "fuel", "lunch", "dinner", "taxi", "train",
+    "book", "phone", "internet", "gym", "cinema", "pharmacy", "parking", "gift",
+    "hardware", "cleaning", "insurance", "repair", "subscription", "bakery", "market", "hotel",
+    "flight", "museum", "concert", "stationery", "garden", "pet", "toll", "laundry",
+};
+constexpr size_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+// Field selectors for rowHash, so each field of a row draws independent bits.
+enum Field : uint64_t { kAmount, kCategory, kType, kDescription };
+
+} // namespace
+
+uint64_t LedgerGenerator::mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+int32_t LedgerGenerator::dayNumber(size_t i) const {
+    // Spread rows evenly over the span; integer math keeps it exact and
+    // non-decreasing for any row count.
+    const uint64_t span = static_cast<uint64_t>(spec_.span_days);
+    const uint64_t offset = spec_.rows ? static_cast<uint64_t>(i) * span / spec_.rows : 0;
+    return toDayNumber(spec_.first_date) + static_cast<int32_t>(offset);
+}
+
+Expense LedgerGenerator::expense(size_t i) const {
+    std::string description;
+    description.reserve(spec_.description_length);
+    uint64_t bits = rowHash(i, kDescription);
+    while (description.size() < spec_.description_length) {
+        if (!description.empty()) {
+            description += ' ';
+        }
+        description += kWords[bits % kWordCount];
+        bits = mix(bits);
+    }
+    description.resize(spec_.description_length);
+
+    const double amount = static_cast<double>(1 + rowHash(i, kAmount) % 50000) / 100.0; // 0.01 .. 500.00
+    std::string category =
+        "category-" + std::to_string(rowHash(i, kCategory) % (spec_.categories ? spec_.categories : 1));
+    const TransactionType type = (rowHash(i, kType) & 1) ? TransactionType::CREDIT : TransactionType::CASH;
+    return Expense(std::move(description), amount, fromDayNumber(dayNumber(i)), std::move(category), type);
+}
+
+bool LedgerGenerator::writeCsv(const std::string& path) const {
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    constexpr size_t kFlushBytes = size_t{1} << 20;
+    std::string buffer = "Date,Description,Amount,Category,Type,Id\n";
+    buffer.reserve(kFlushBytes + 4096);
+    for (size_t i = 0; i < spec_.rows; ++i) {
+        const Expense e = expense(i);
+        appendCsvRow(buffer, ExpenseRow{e.description, e.amount, e.date, e.category, e.transaction_type,
+                                        static_cast<ExpenseId>(i)});
+        if (buffer.size() >= kFlushBytes) {
+            std::fwrite(buffer.data(), 1, buffer.size(), out);
+            buffer.clear();
+        }
+    }
+    std::fwrite(buffer.data(), 1, buffer.size(), out);
+    const bool ok = !std::ferror(out);
+    return std::fclose(out) == 0 && ok;
+}
+
+} // namespace expense_tracker
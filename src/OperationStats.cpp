@@ -0,0 +1,164 @@
+#include "OperationStats.h"
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+
+namespace expense_tracker {
+
+namespace {
+
+const char* const kOperationNames[] = {
+    "load", "save", "import", "reload", "add", "delete", "compact",
+    "query_day", "query_month", "query_year", "query_range", "query",
+    "total", "totals_by_category", "aggregate", "group_by", "stream", "snapshot",
+};
+static_assert(sizeof(kOperationNames) / sizeof(kOperationNames[0]) == static_cast<size_t>(Operation::kCount),
+              "every Operation needs a name");
+
+} // namespace
+
+const char* operationName(Operation op) {
+    return kOperationNames[static_cast<size_t>(op)];
+}
+
+size_t OperationStats::bucketFor(uint64_t ns) {
+    if (ns < 4) {
+        return static_cast<size_t>(ns);
+    }
+    // Bucket = (power of two, top two bits below the leading one).
+    const int msb = 63 - __builtin_clzll(ns);
+    const size_t sub = static_cast<size_t>(ns >> (msb - 2)) & 3;
+    return 4 * static_cast<size_t>(msb - 1) + sub;
+}
+
+uint64_t OperationStats::bucketUpperBound(size_t bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+    const int shift = static_cast<int>(bucket / 4) - 1; // msb - 2
+    const uint64_t lower = (4 + static_cast<uint64_t>(bucket % 4)) << shift;
+    return lower + ((uint64_t{1} << shift) - 1);
+}
+
+void OperationStats::record(Operation op, uint64_t ns, uint64_t rowsScanned, uint64_t rowsReturned,
+                            uint64_t bytesRead, uint64_t bytesWritten) {
+    Counters& c = counters_[static_cast<size_t>(op)];
+    c.calls.fetch_add(1, std::memory_order_relaxed);
+    c.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    c.buckets[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = c.max_ns.load(std::memory_order_relaxed);
+    while (ns > max && !c.max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+    }
+    // Skip the adds that would be zero; most operations report only some counts.
+    if (rowsScanned) {
+        c.rows_scanned.fetch_add(rowsScanned, std::memory_order_relaxed);
+    }
+    if (rowsReturned) {
+        c.rows_returned.fetch_add(rowsReturned, std::memory_order_relaxed);
+    }
+    if (bytesRead) {
+        c.bytes_read.fetch_add(bytesRead, std::memory_order_relaxed);
+    }
+    if (bytesWritten) {
+        c.bytes_written.fetch_add(bytesWritten, std::memory_order_relaxed);
+    }
+}
+
+uint64_t OperationStats::percentileNs(Operation op, double p) const {
+    const Counters& c = counters_[static_cast<size_t>(op)];
+    uint64_t counts[kBuckets];
+    uint64_t total = 0;
+    for (size_t b = 0; b < kBuckets; ++b) {
+        counts[b] = c.buckets[b].load(std::memory_order_relaxed);
+        total += counts[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    // Smallest bucket whose cumulative count reaches ceil(p * total).
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * static_cast<double>(total) + 0.999999));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < kBuckets; ++b) {
+        seen += counts[b];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(b), c.max_ns.load(std::memory_order_relaxed));
+        }
+    }
+    return c.max_ns.load(std::memory_order_relaxed);
+}
+
+OperationSummary OperationStats::summary(Operation op) const {
+    const Counters& c = counters_[static_cast<size_t>(op)];
+    OperationSummary s;
+    s.calls = c.calls.load(std::memory_order_relaxed);
+    s.total_ns = c.total_ns.load(std::memory_order_relaxed);
+    s.max_ns = c.max_ns.load(std::memory_order_relaxed);
+    s.p50_ns = percentileNs(op, 0.50);
+    s.p90_ns = percentileNs(op, 0.90);
+    s.p99_ns = percentileNs(op, 0.99);
+    s.rows_scanned = c.rows_scanned.load(std::memory_order_relaxed);
+    s.rows_returned = c.rows_returned.load(std::memory_order_relaxed);
+    s.bytes_read = c.bytes_read.load(std::memory_order_relaxed);
+    s.bytes_written = c.bytes_written.load(std::memory_order_relaxed);
+    return s;
+}
+
+void OperationStats::reset() {
+    for (Counters& c : counters_) {
+        c.calls.store(0, std::memory_order_relaxed);
+        c.total_ns.store(0, std::memory_order_relaxed);
+        c.max_ns.store(0, std::memory_order_relaxed);
+        c.rows_scanned.store(0, std::memory_order_relaxed);
+        c.rows_returned.store(0, std::memory_order_relaxed);
+        c.bytes_read.store(0, std::memory_order_relaxed);
+        c.bytes_written.store(0, std::memory_order_relaxed);
+        for (auto& bucket : c.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void OperationStats::dump(std::ostream& out, bool json) const {
+    bool first = true;
+    if (json) {
+        out << '{';
+    }
+    for (size_t i = 0; i < static_cast<size_t>(Operation::kCount); ++i) {
+        const Operation op = static_cast<Operation>(i);
+        const OperationSummary s = summary(op);
+        if (s.calls == 0) {
+            continue;
+        }
+        if (json) {
+            out << (first ? "" : ",") << '"' << operationName(op) << "\":{\"calls\":" << s.calls
+                << ",\"total_ns\":" << s.total_ns << ",\"p50_ns\":" << s.p50_ns << ",\"p90_ns\":" << s.p90_ns
+                << ",\"p99_ns\":" << s.p99_ns << ",\"max_ns\":" << s.max_ns
+                << ",\"rows_scanned\":" << s.rows_scanned << ",\"rows_returned\":" << s.rows_returned
+                << ",\"bytes_read\":" << s.bytes_read << ",\"bytes_written\":" << s.bytes_written << '}';
+        } else {
+            if (first) {
+                out << "operation            calls     mean_us    p50_us    p90_us    p99_us    max_us"
+                       "  rows_scanned rows_returned  bytes_read bytes_written\n";
+            }
+            char line[256];
+            const double mean = static_cast<double>(s.total_ns) / static_cast<double>(s.calls);
+            std::snprintf(line, sizeof(line), "%-18s %7llu %11.2f %9.2f %9.2f %9.2f %9.2f %13llu %13llu %11llu %13llu\n",
+                          operationName(op), static_cast<unsigned long long>(s.calls), mean / 1e3,
+                          static_cast<double>(s.p50_ns) / 1e3, static_cast<double>(s.p90_ns) / 1e3,
+                          static_cast<double>(s.p99_ns) / 1e3, static_cast<double>(s.max_ns) / 1e3,
+                          static_cast<unsigned long long>(s.rows_scanned),
+                          static_cast<unsigned long long>(s.rows_returned),
+                          static_cast<unsigned long long>(s.bytes_read),
+                          static_cast<unsigned long long>(s.bytes_written));
+            out << line;
+        }
+        first = false;
+    }
+    if (json) {
+        out << "}\n";
+    } else if (first) {
+        out << "No operations recorded.\n";
+    }
+}
+
+} // namespace expense_tracker
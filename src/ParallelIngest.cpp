@@ -0,0 +1,245 @@
+#include "ExpenseManager.h"
+#include "CsvCodec.h"
+#include <algorithm>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Multi-threaded CSV ingest for ExpenseManager::loadExpenses.
+//
+// The file is mapped and cut into roughly equal byte ranges, one per worker.
+// Range boundaries are moved forward to the next record-ending newline; to
+// avoid cutting inside a quoted field that contains a newline, each worker
+// first counts quote characters in its range, and the prefix parity tells
+// every boundary whether it starts inside quotes. Workers then parse their
+// ranges into compact row batches, which are appended to the store in file
+// order so row order, warnings and line numbers match the sequential loader.
+
+namespace expense_tracker {
+
+namespace {
+
+// Below this many bytes per worker, thread start-up outweighs the parsing.
+constexpr size_t kMinBytesPerWorker = size_t{1} << 20;
+
+struct ParsedRow {
+    ExpenseId id;
+    int32_t day;
+    double amount;
+    TransactionType type;
+    // Into ChunkResult::text, which can pass 4 GiB on a large slice.
+    size_t description_offset;
+    size_t description_length;
+    size_t category_offset;
+    size_t category_length;
+};
+
+struct ChunkResult {
+    std::vector<ParsedRow> rows;
+    std::string text; // Decoded description/category bytes referenced by rows
+    std::vector<std::pair<size_t, std::string>> warnings; // (line offset in chunk, message)
+    size_t lines = 0;  // Physical lines consumed, for numbering later chunks
+    bool failed = false;
+    size_t error_line = 0;
+    std::string error;
+};
+
+struct MappedInput {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    ~MappedInput() {
+        if (data) {
+            munmap(const_cast<char*>(data), size);
+        }
+    }
+};
+
+// Finds the first record start at or after `p`, given whether `p` is inside a
+// quoted field.
+const char* nextRecordStart(const char* p, const char* end, bool inQuotes) {
+    for (; p < end; ++p) {
+        if (*p == '"') {
+            inQuotes = !inQuotes;
+        } else if (*p == '\n' && !inQuotes) {
+            return p + 1;
+        }
+    }
+    return end;
+}
+
+} // namespace
+
+bool ExpenseManager::loadExpensesParallel(const std::string& filepath, unsigned threads) {
+    store_.clear(); // Clear existing expenses before loading
+
+    const int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "Info: Expense file not found or could not be opened: " << filepath
+                  << ". This is normal if running for the first time or if no expenses have been saved." << std::endl;
+        rebuildIndexes();
+        return true;
+    }
+    struct stat info;
+    MappedInput input;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            input.data = static_cast<const char*>(address);
+            input.size = static_cast<size_t>(info.st_size);
+            madvise(address, input.size, MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+    if (!input.data) {
+        std::cerr << "Error: CSV header missing or does not match expected format in file: " << filepath
+                  << " - file is empty or could not be read" << std::endl;
+        rebuildIndexes();
+        return false;
+    }
+    const char* const begin = input.data;
+    const char* const end = input.data + input.size;
+
+    // Header: map the expected column names to their positions.
+    std::vector<std::string_view> fields;
+    size_t headerLines = 0;
+    const char* body = splitCsvRecord(begin, end, fields, headerLines);
+    CsvLayout layout;
+    CsvColumn missing;
+    if (!mapCsvHeader(fields, layout, missing)) {
+        std::cerr << "Error: CSV header missing or does not match expected format in file: " << filepath
+                  << " - missing column \"" << csvColumnName(missing) << "\"" << std::endl;
+        rebuildIndexes();
+        return false;
+    }
+
+    // Cut the body into per-worker ranges aligned to record boundaries.
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const size_t bodySize = static_cast<size_t>(end - body);
+    const size_t workers = std::max<size_t>(1, std::min<size_t>(threads, bodySize / kMinBytesPerWorker));
+    std::vector<size_t> quoteCounts(workers, 0);
+    {
+        std::vector<std::thread> pool;
+        for (size_t w = 0; w < workers; ++w) {
+            pool.emplace_back([&, w] {
+                quoteCounts[w] = static_cast<size_t>(
+                    std::count(body + bodySize * w / workers, body + bodySize * (w + 1) / workers, '"'));
+            });
+        }
+        for (auto& worker : pool) {
+            worker.join();
+        }
+    }
+    std::vector<const char*> starts(workers + 1, end);
+    starts[0] = body;
+    size_t quotesBefore = 0;
+    for (size_t w = 1; w < workers; ++w) {
+        quotesBefore += quoteCounts[w - 1];
+        starts[w] = std::max(starts[w - 1],
+                             nextRecordStart(body + bodySize * w / workers, end, quotesBefore % 2 == 1));
+    }
+
+    std::vector<ChunkResult> results(workers);
+    auto parseRange = [&](size_t w) {
+        ChunkResult& result = results[w];
+        std::vector<std::string_view> rowFields;
+        std::string decoded[kCsvColumnCount];
+        const char* p = starts[w];
+        try {
+            while (p < starts[w + 1]) {
+                const size_t line = result.lines;
+                result.error_line = line; // Where an exception below is reported
+                size_t newlines = 0;
+                p = splitCsvRecord(p, starts[w + 1], rowFields, newlines);
+                result.lines += newlines;
+                if (rowFields.size() == 1 && rowFields[0].empty()) {
+                    continue; // Blank line
+                }
+                if (rowFields.size() < layout.min_fields) {
+                    result.failed = true;
+                    result.error = "too few columns";
+                    return;
+                }
+                for (int column = 0; column < kCsvColumnCount; ++column) {
+                    if (layout.column_of[column] == CsvLayout::kMissing) {
+                        decoded[column].clear();
+                    } else {
+                        decodeCsvField(rowFields[layout.column_of[column]], decoded[column]);
+                    }
+                }
+
+                ParsedRow row;
+                if (!parseAmount(decoded[kCsvAmount], row.amount)) {
+                    result.failed = true;
+                    result.error = "could not parse amount '" + decoded[kCsvAmount] + "'";
+                    return;
+                }
+                Date date;
+                std::string warning = validateRow(decoded[kCsvDate], decoded[kCsvType], date, row.type);
+                if (!warning.empty()) {
+                    result.warnings.emplace_back(line, std::move(warning));
+                    continue;
+                }
+                if (!parseExpenseId(decoded[kCsvId], row.id)) {
+                    row.id = kNoExpenseId; // Blank, malformed or no Id column: the store assigns one
+                }
+                row.day = toDayNumber(date);
+                row.description_offset = result.text.size();
+                row.description_length = decoded[kCsvDescription].size();
+                result.text += decoded[kCsvDescription];
+                row.category_offset = result.text.size();
+                row.category_length = decoded[kCsvCategory].size();
+                result.text += decoded[kCsvCategory];
+                result.rows.push_back(row);
+            }
+        } catch (const std::exception& e) {
+            result.failed = true;
+            result.error = e.what();
+        }
+    };
+    {
+        std::vector<std::thread> pool;
+        for (size_t w = 1; w < workers; ++w) {
+            pool.emplace_back(parseRange, w);
+        }
+        parseRange(0); // The calling thread takes the first range
+        for (auto& worker : pool) {
+            worker.join();
+        }
+    }
+
+    // Merge in file order. Line numbers are 1-based and count the header.
+    size_t lineBase = 1 + headerLines;
+    for (const ChunkResult& result : results) {
+        for (const auto& warning : result.warnings) {
+            std::cerr << "Warning: " << warning.second << " (line " << lineBase + warning.first
+                      << "). Skipping row." << std::endl;
+        }
+        const char* text = result.text.data();
+        for (const ParsedRow& row : result.rows) {
+            store_.append(std::string_view(text + row.description_offset, row.description_length), row.amount,
+                          row.day, std::string_view(text + row.category_offset, row.category_length), row.type,
+                          row.id);
+        }
+        if (result.failed) {
+            std::cerr << "Error: Exception while reading CSV file: " << filepath << " - " << result.error
+                      << " (line " << lineBase + result.error_line << ")" << std::endl;
+            rebuildIndexes(); // Keep indexes consistent with the rows read before the error
+            return false;
+        }
+        lineBase += result.lines;
+    }
+    rebuildIndexes();
+    return true;
+}
+
+} // namespace expense_tracker
@@ -0,0 +1,212 @@
+#include "PartitionCatalog.h"
+#include "CsvCodec.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace expense_tracker {
+
+namespace {
+
+constexpr const char* kManifestMagic = "expense-partitions 1";
+constexpr const char* kUndatedFile = "undated.csv";
+
+} // namespace
+
+PartitionCatalog::Key PartitionCatalog::keyForDay(int32_t dayNumber) {
+    if (dayNumber == kNoDayNumber) {
+        return kUndated;
+    }
+    const Date date = fromDayNumber(dayNumber);
+    return date.year * 12 + date.month - 1;
+}
+
+void PartitionCatalog::dayRange(Key key, int32_t& firstDay, int32_t& lastDay) {
+    if (key == kUndated) {
+        firstDay = lastDay = kNoDayNumber;
+        return;
+    }
+    // Floor division, so months before year 0 map back correctly too.
+    const int year = (key >= 0 ? key : key - 11) / 12;
+    const int month = key - year * 12 + 1;
+    firstDay = toDayNumber(year, month, 1);
+    lastDay = (month == 12 ? toDayNumber(year + 1, 1, 1) : toDayNumber(year, month + 1, 1)) - 1;
+}
+
+std::string PartitionCatalog::fileName(Key key) {
+    if (key == kUndated) {
+        return kUndatedFile;
+    }
+    int32_t firstDay, lastDay;
+    dayRange(key, firstDay, lastDay);
+    const Date date = fromDayNumber(firstDay);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%04d-%02d.csv", date.year, date.month);
+    return name;
+}
+
+bool PartitionCatalog::parseFileName(std::string_view name, Key& key) {
+    if (name == kUndatedFile) {
+        key = kUndated;
+        return true;
+    }
+    // "<signed year>-MM.csv", the inverse of fileName's "%04d-%02d.csv".
+    const size_t monthSuffix = 7; // "-MM.csv"
+    if (name.size() <= monthSuffix || name.substr(name.size() - 4) != ".csv" ||
+        name[name.size() - monthSuffix] != '-') {
+        return false;
+    }
+    const std::string_view yearText = name.substr(0, name.size() - monthSuffix);
+    const std::string_view monthText = name.substr(name.size() - monthSuffix + 1, 2);
+    int year = 0;
+    int month = 0;
+    const auto yearParsed = std::from_chars(yearText.data(), yearText.data() + yearText.size(), year);
+    const auto monthParsed = std::from_chars(monthText.data(), monthText.data() + monthText.size(), month);
+    if (yearParsed.ec != std::errc() || yearParsed.ptr != yearText.data() + yearText.size() ||
+        monthParsed.ec != std::errc() || monthParsed.ptr != monthText.data() + monthText.size() || month < 1 ||
+        month > 12 || year <= std::numeric_limits<Key>::min() / 12 || year >= std::numeric_limits<Key>::max() / 12) {
+        return false;
+    }
+    key = year * 12 + month - 1;
+    return true;
+}
+
+void PartitionCatalog::clear() {
+    partitions_.clear();
+    clock_ = 0;
+}
+
+bool PartitionCatalog::readManifest(const std::string& path, ExpenseId& nextId, bool& exists) {
+    clear();
+    std::ifstream in(path);
+    exists = in.is_open();
+    if (!exists) {
+        return false;
+    }
+    std::string line;
+    if (!std::getline(in, line) || line != kManifestMagic) {
+        std::cerr << "Error: Not a partition manifest: " << path << std::endl;
+        return false;
+    }
+    std::string word;
+    if (!std::getline(in, line) || !(std::istringstream(line) >> word >> nextId) || word != "next-id" ||
+        nextId > kMaxExpenseId + 1) {
+        std::cerr << "Error: Partition manifest is missing its next-id line: " << path << std::endl;
+        return false;
+    }
+    while (std::getline(in, line)) {
+        Key key;
+        if (line.empty()) {
+            continue;
+        }
+        if (!parseFileName(line, key)) {
+            std::cerr << "Error: Bad partition name '" << line << "' in manifest: " << path << std::endl;
+            clear();
+            return false;
+        }
+        partitions_[key].on_disk = true;
+    }
+    return true;
+}
+
+void PartitionCatalog::writeManifest(std::ostream& out, ExpenseId nextId) const {
+    out << kManifestMagic << '\n' << "next-id " << nextId << '\n';
+    for (const auto& entry : partitions_) {
+        if (entry.second.on_disk) {
+            out << fileName(entry.first) << '\n';
+        }
+    }
+}
+
+std::vector<PartitionCatalog::Key> PartitionCatalog::touch(int32_t firstDay, int32_t lastDay) {
+    ++clock_;
+    std::vector<Key> missing;
+    // A ledger has one partition per month it spans, so a walk over all of
+    // them is cheap next to loading even one.
+    for (auto& entry : partitions_) {
+        int32_t partFirst, partLast;
+        dayRange(entry.first, partFirst, partLast);
+        if (partLast < firstDay || partFirst > lastDay) {
+            continue;
+        }
+        entry.second.last_used = clock_;
+        if (entry.second.on_disk && !entry.second.resident) {
+            missing.push_back(entry.first);
+        }
+    }
+    return missing;
+}
+
+std::vector<PartitionCatalog::Key> PartitionCatalog::evictionCandidates(size_t budget) const {
+    const size_t resident = residentCount();
+    if (resident <= budget) {
+        return {};
+    }
+    std::vector<std::pair<uint64_t, Key>> clean;
+    for (const auto& entry : partitions_) {
+        const Partition& part = entry.second;
+        if (part.resident && !part.dirty && part.on_disk && part.last_used < clock_) {
+            clean.emplace_back(part.last_used, entry.first);
+        }
+    }
+    std::sort(clean.begin(), clean.end());
+    clean.resize(std::min(clean.size(), resident - budget));
+    std::vector<Key> keys;
+    for (const auto& candidate : clean) {
+        keys.push_back(candidate.second);
+    }
+    return keys;
+}
+
+void PartitionCatalog::markDirty(int32_t dayNumber) {
+    Partition& part = partitions_[keyForDay(dayNumber)];
+    part.resident = true; // A new month starts out resident
+    part.dirty = true;
+    part.last_used = clock_;
+}
+
+void PartitionCatalog::setResident(Key key, bool resident) {
+    partitions_[key].resident = resident;
+}
+
+void PartitionCatalog::adoptAll(const std::vector<Key>& keys) {
+    clear();
+    for (Key key : keys) {
+        Partition& part = partitions_[key];
+        part.resident = true;
+        part.dirty = true;
+    }
+}
+
+void PartitionCatalog::markSaved(Key key, bool hasRows) {
+    if (!hasRows) {
+        partitions_.erase(key);
+        return;
+    }
+    Partition& part = partitions_[key];
+    part.on_disk = true;
+    part.dirty = false;
+}
+
+std::vector<PartitionCatalog::Key> PartitionCatalog::dirtyKeys() const {
+    std::vector<Key> keys;
+    for (const auto& entry : partitions_) {
+        if (entry.second.dirty) {
+            keys.push_back(entry.first);
+        }
+    }
+    return keys;
+}
+
+size_t PartitionCatalog::residentCount() const {
+    size_t count = 0;
+    for (const auto& entry : partitions_) {
+        count += entry.second.resident ? 1 : 0;
+    }
+    return count;
+}
+
+} // namespace expense_tracker
@@ -0,0 +1,467 @@
+#include "QueryDaemon.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace expense_tracker {
+
+namespace {
+
+constexpr size_t kRequestHeaderBytes = 5;  // u32 command length, u8 format
+constexpr size_t kResponseHeaderBytes = 9; // u8 status, u32 output length, u32 diagnostics length
+constexpr size_t kReadBytes = 64 * 1024;
+constexpr int kMaxEvents = 64;
+
+bool socketAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Error: Socket path is empty or too long: " << path << std::endl;
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+void appendU32(std::string& out, uint32_t value) {
+    char bytes[sizeof(value)];
+    std::memcpy(bytes, &value, sizeof(value));
+    out.append(bytes, sizeof(value));
+}
+
+uint32_t readU32(const char* bytes) {
+    uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+void appendResponse(std::string& out, const DaemonReply& reply) {
+    out += static_cast<char>(reply.ok ? 0 : 1);
+    appendU32(out, static_cast<uint32_t>(reply.output.size()));
+    appendU32(out, static_cast<uint32_t>(reply.diagnostics.size()));
+    out += reply.output;
+    out += reply.diagnostics;
+}
+
+// send() without SIGPIPE. Returns bytes sent, 0 if the socket is full, or -1
+// on error.
+ssize_t sendSome(int fd, const char* data, size_t size) {
+    for (;;) {
+        const ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n >= 0) {
+            return n;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+}
+
+struct Connection {
+    int fd = -1;
+    std::string in;  // Received bytes from the first unanswered request on
+    std::string out; // Responses not yet sent, from `sent` on
+    size_t sent = 0;
+    bool peer_closed = false; // Nothing more will arrive
+    bool failed = false;      // Socket error or malformed request: drop it
+    uint32_t events = 0;      // Current epoll interest
+
+    size_t queued() const { return out.size() - sent; }
+};
+
+class Server {
+public:
+    explicit Server(const RequestHandler& handler) : handler_(handler) {}
+    ~Server();
+
+    bool open(const std::string& socketPath);
+    void run();
+
+private:
+    void acceptAll();
+    void service(Connection& connection);
+    void readFrom(Connection& connection);
+    void runRequests(Connection& connection);
+    // True if `in` holds a whole request.
+    bool hasRequest(const Connection& connection) const;
+    void writeTo(Connection& connection);
+    // Closes a finished connection or sets its epoll interest.
+    void settle(Connection& connection);
+
+    const RequestHandler& handler_;
+    std::string path_;
+    int listen_fd_ = -1;
+    int signal_fd_ = -1;
+    int epoll_fd_ = -1;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    bool stopping_ = false;
+    DaemonReply reply_; // Reused across requests
+};
+
+Server::~Server() {
+    for (auto& entry : connections_) {
+        close(entry.first);
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(path_.c_str());
+    }
+    if (signal_fd_ >= 0) {
+        close(signal_fd_);
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+}
+
+bool Server::open(const std::string& socketPath) {
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) {
+        return false;
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "Error: Could not create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    int bound = bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    if (bound != 0 && errno == EADDRINUSE) {
+        // Only a socket is ours to replace; anything else is the user's file.
+        struct stat existing;
+        if (lstat(socketPath.c_str(), &existing) != 0 || !S_ISSOCK(existing.st_mode)) {
+            std::cerr << "Error: " << socketPath << " exists and is not a socket" << std::endl;
+            close(fd);
+            return false;
+        }
+        // Left behind by a daemon that is gone, unless one still answers.
+        const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        const bool live = probe >= 0 && connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (live) {
+            std::cerr << "Error: A daemon is already serving " << socketPath << std::endl;
+            close(fd);
+            return false;
+        }
+        unlink(socketPath.c_str());
+        bound = bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+    }
+    if (bound != 0 || listen(fd, SOMAXCONN) != 0) {
+        std::cerr << "Error: Could not listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+    listen_fd_ = fd;
+    path_ = socketPath;
+
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    signal_fd_ = signalfd(-1, &stopSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event listenEvent{EPOLLIN, {}};
+    listenEvent.data.fd = listen_fd_;
+    epoll_event signalEvent{EPOLLIN, {}};
+    signalEvent.data.fd = signal_fd_;
+    if (signal_fd_ < 0 || epoll_fd_ < 0 || epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &listenEvent) != 0 ||
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, signal_fd_, &signalEvent) != 0) {
+        std::cerr << "Error: Could not set up the event loop: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Server::run() {
+    epoll_event events[kMaxEvents];
+    while (!stopping_) {
+        const int ready = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error: Event loop failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < ready; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                acceptAll();
+            } else if (fd == signal_fd_) {
+                stopping_ = true;
+            } else {
+                const auto it = connections_.find(fd);
+                if (it == connections_.end()) {
+                    continue; // Closed earlier in this batch
+                }
+                Connection& connection = *it->second;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    readFrom(connection);
+                }
+                service(connection);
+            }
+        }
+    }
+    // Answers already queued (the "shutdown" one included) go out as far as
+    // the sockets take them without waiting.
+    for (auto& entry : connections_) {
+        writeTo(*entry.second);
+    }
+}
+
+void Server::acceptAll() {
+    for (;;) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "Warning: Could not accept a connection: " << std::strerror(errno) << std::endl;
+            }
+            return;
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connection->events = EPOLLIN;
+        epoll_event event{EPOLLIN, {}};
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+        connections_.emplace(fd, std::move(connection));
+    }
+}
+
+void Server::service(Connection& connection) {
+    // Requests held back by a full queue run as soon as writing empties it;
+    // no event would bring them back otherwise.
+    do {
+        runRequests(connection);
+        writeTo(connection);
+    } while (!connection.failed && !stopping_ && connection.queued() == 0 && hasRequest(connection));
+    settle(connection);
+}
+
+bool Server::hasRequest(const Connection& connection) const {
+    return connection.in.size() >= kRequestHeaderBytes &&
+           connection.in.size() >= kRequestHeaderBytes + readU32(connection.in.data());
+}
+
+void Server::readFrom(Connection& connection) {
+    // Reading stops at kMaxQueuedBytes of unparsed input; the rest waits for
+    // the next wakeup, when these requests have been answered.
+    while (!connection.peer_closed && connection.in.size() < kMaxQueuedBytes) {
+        const size_t used = connection.in.size();
+        connection.in.resize(used + kReadBytes);
+        const ssize_t n = read(connection.fd, &connection.in[used], kReadBytes);
+        connection.in.resize(used + static_cast<size_t>(n > 0 ? n : 0));
+        if (n > 0) {
+            continue;
+        }
+        if (n == 0) {
+            connection.peer_closed = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            connection.failed = true;
+        }
+        break;
+    }
+}
+
+void Server::runRequests(Connection& connection) {
+    size_t at = 0;
+    while (!stopping_ && !connection.failed && connection.queued() < kMaxQueuedBytes &&
+           connection.in.size() - at >= kRequestHeaderBytes) {
+        const uint32_t length = readU32(connection.in.data() + at);
+        if (length > kMaxRequestBytes) {
+            std::cerr << "Warning: Dropping a client that sent a " << length << "-byte request" << std::endl;
+            connection.failed = true;
+            break;
+        }
+        if (connection.in.size() - at < kRequestHeaderBytes + length) {
+            break; // The rest of this request is still on its way
+        }
+        const uint8_t format = static_cast<uint8_t>(connection.in[at + 4]);
+        const std::string_view command(connection.in.data() + at + kRequestHeaderBytes, length);
+        at += kRequestHeaderBytes + length;
+
+        reply_.ok = true;
+        reply_.output.clear();
+        reply_.diagnostics.clear();
+        if (command == "shutdown") {
+            stopping_ = true;
+        } else {
+            handler_(format, command, reply_);
+        }
+        if (reply_.output.size() > std::numeric_limits<uint32_t>::max() ||
+            reply_.diagnostics.size() > std::numeric_limits<uint32_t>::max()) {
+            reply_.ok = false;
+            reply_.output.clear();
+            reply_.diagnostics = "Error: Result too large to send\n";
+        }
+        appendResponse(connection.out, reply_);
+    }
+    connection.in.erase(0, at);
+}
+
+void Server::writeTo(Connection& connection) {
+    while (!connection.failed && connection.queued() > 0) {
+        const ssize_t n = sendSome(connection.fd, connection.out.data() + connection.sent, connection.queued());
+        if (n < 0) {
+            connection.failed = true;
+        } else if (n == 0) {
+            break; // Socket full; EPOLLOUT resumes
+        }
+        connection.sent += static_cast<size_t>(n > 0 ? n : 0);
+    }
+    if (connection.queued() == 0) {
+        connection.out.clear();
+        connection.sent = 0;
+    }
+}
+
+void Server::settle(Connection& connection) {
+    const bool done = connection.failed || (connection.peer_closed && connection.queued() == 0);
+    if (done) {
+        const int fd = connection.fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        connections_.erase(fd); // Destroys `connection`
+        return;
+    }
+    uint32_t events = 0;
+    if (!connection.peer_closed && connection.queued() < kMaxQueuedBytes) {
+        events |= EPOLLIN;
+    }
+    if (connection.queued() > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events != connection.events) {
+        epoll_event event{events, {}};
+        event.data.fd = connection.fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.events = events;
+    }
+}
+
+} // namespace
+
+void blockStopSignals() {
+    sigset_t stopSignals;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+}
+
+bool serveRequests(const std::string& socketPath, const RequestHandler& handler) {
+    Server server(handler);
+    if (!server.open(socketPath)) {
+        return false;
+    }
+    std::cerr << "Info: Serving on " << socketPath << std::endl;
+    server.run();
+    return true;
+}
+
+bool sendRequests(const std::string& socketPath, uint8_t format, const std::vector<std::string>& commands,
+                  const ReplySink& onReply) {
+    sockaddr_un address;
+    if (!socketAddress(socketPath, address)) {
+        return false;
+    }
+    std::string requests;
+    for (const std::string& command : commands) {
+        if (command.size() > kMaxRequestBytes) {
+            std::cerr << "Error: Command longer than " << kMaxRequestBytes << " bytes" << std::endl;
+            return false;
+        }
+        appendU32(requests, static_cast<uint32_t>(command.size()));
+        requests += static_cast<char>(format);
+        requests += command;
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Error: Could not connect to the daemon at " << socketPath << ": " << std::strerror(errno)
+                  << std::endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    // Requests and responses flow at the same time: a daemon holding back
+    // its reads until we take its answers must not find us blocked in send.
+    size_t sent = 0;
+    size_t answered = 0;
+    std::string in;
+    DaemonReply reply;
+    bool ok = true;
+    while (ok && answered < commands.size()) {
+        pollfd wait{fd, static_cast<short>(POLLIN | (sent < requests.size() ? POLLOUT : 0)), 0};
+        if (poll(&wait, 1, -1) < 0) {
+            ok = errno == EINTR;
+            continue;
+        }
+        if (wait.revents & POLLOUT) {
+            const ssize_t n = sendSome(fd, requests.data() + sent, requests.size() - sent);
+            ok = n >= 0;
+            sent += static_cast<size_t>(n > 0 ? n : 0);
+        }
+        if (!ok || !(wait.revents & (POLLIN | POLLHUP | POLLERR))) {
+            continue;
+        }
+        const size_t used = in.size();
+        in.resize(used + kReadBytes);
+        const ssize_t n = read(fd, &in[used], kReadBytes);
+        in.resize(used + static_cast<size_t>(n > 0 ? n : 0));
+        if (n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN)) {
+            ok = false;
+            continue;
+        }
+        size_t at = 0;
+        while (in.size() - at >= kResponseHeaderBytes) {
+            const size_t outputBytes = readU32(in.data() + at + 1);
+            const size_t diagnosticBytes = readU32(in.data() + at + 5);
+            if (in.size() - at < kResponseHeaderBytes + outputBytes + diagnosticBytes) {
+                break;
+            }
+            const char* body = in.data() + at + kResponseHeaderBytes;
+            reply.ok = in[at] == 0;
+            reply.output.assign(body, outputBytes);
+            reply.diagnostics.assign(body + outputBytes, diagnosticBytes);
+            at += kResponseHeaderBytes + outputBytes + diagnosticBytes;
+            ++answered;
+            onReply(reply);
+        }
+        in.erase(0, at);
+    }
+    close(fd);
+    if (!ok) {
+        std::cerr << "Error: Lost the connection to the daemon after " << answered << " of " << commands.size()
+                  << " replies" << std::endl;
+    }
+    return ok;
+}
+
+} // namespace expense_tracker
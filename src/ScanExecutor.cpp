@@ -0,0 +1,119 @@
+#include "ScanExecutor.h"
+#include <algorithm>
+
+namespace expense_tracker {
+
+ScanExecutor::ScanExecutor(unsigned threads)
+    : workers_(threads ? threads : std::max(1u, std::thread::hardware_concurrency())),
+      shares_(new Share[workers_]) {
+    threads_.reserve(workers_ - 1);
+    for (size_t worker = 1; worker < workers_; ++worker) {
+        threads_.emplace_back(&ScanExecutor::workerLoop, this, worker);
+    }
+}
+
+ScanExecutor::~ScanExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ScanExecutor::run(size_t morsels, const MorselTask& task) {
+    std::unique_lock<std::mutex> exclusive(run_mutex_, std::try_to_lock);
+    if (!exclusive.owns_lock() || workers_ == 1 || morsels < 2) {
+        for (size_t morsel = 0; morsel < morsels; ++morsel) {
+            task(morsel, 0);
+        }
+        return;
+    }
+    // No pool thread is in a run, so the shares can be set without locks;
+    // the generation bump below publishes them.
+    for (size_t worker = 0; worker < workers_; ++worker) {
+        shares_[worker].next = morsels * worker / workers_;
+        shares_[worker].end = morsels * (worker + 1) / workers_;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        busy_ = threads_.size();
+        ++generation_;
+    }
+    wake_.notify_all();
+    work(0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return busy_ == 0; });
+    task_ = nullptr;
+}
+
+void ScanExecutor::workerLoop(size_t worker) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+            if (stopping_) {
+                return;
+            }
+            seen = generation_;
+        }
+        work(worker);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+void ScanExecutor::work(size_t worker) {
+    const MorselTask& task = *task_;
+    size_t morsel;
+    while (takeOwn(worker, morsel) || steal(worker, morsel)) {
+        task(morsel, worker);
+    }
+}
+
+bool ScanExecutor::takeOwn(size_t worker, size_t& morsel) {
+    Share& own = shares_[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.next == own.end) {
+        return false;
+    }
+    morsel = own.next++;
+    return true;
+}
+
+bool ScanExecutor::steal(size_t worker, size_t& morsel) {
+    // A worker that finds every share empty is done: morsels only ever move
+    // from one share to another, and a range in transit belongs to a thief
+    // that is still working.
+    for (size_t i = 1; i < workers_; ++i) {
+        Share& victim = shares_[(worker + i) % workers_];
+        size_t first, last;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            const size_t left = victim.end - victim.next;
+            if (left == 0) {
+                continue;
+            }
+            // Half from the far end: the victim keeps the morsels next to
+            // the ones it is scanning, and the thief gets a run of its own.
+            last = victim.end;
+            first = last - (left + 1) / 2;
+            victim.end = first;
+        }
+        morsel = first;
+        Share& own = shares_[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.next = first + 1;
+        own.end = last;
+        return true;
+    }
+    return false;
+}
+
+} // namespace expense_tracker
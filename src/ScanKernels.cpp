@@ -0,0 +1,155 @@
+#include "ScanKernels.h"
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define EXPENSE_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace expense_tracker {
+
+namespace {
+
+using AggregateKernel = void (*)(const int32_t*, const double*, size_t, int32_t, int32_t, AmountAggregate&);
+
+void aggregateScalar(const int32_t* days, const double* amounts, size_t count, int32_t firstDay, int32_t lastDay,
+                     AmountAggregate& acc) {
+    constexpr double kInf = std::numeric_limits<double>::infinity();
+    AmountAggregate local;
+    for (size_t i = 0; i < count; ++i) {
+        const bool selected = days[i] >= firstDay && days[i] <= lastDay;
+        const double amount = amounts[i];
+        local.sum += selected ? amount : 0.0;
+        local.min = std::min(local.min, selected ? amount : kInf);
+        local.max = std::max(local.max, selected ? amount : -kInf);
+        local.count += selected;
+    }
+    acc.merge(local);
+}
+
+#ifdef EXPENSE_SCAN_X86
+
+// Lane masks are computed as "outside the range" (first > day || day > last)
+// because SSE/AVX2 only have a signed greater-than for 32-bit integers. Each
+// 32-bit mask lane is widened to 64 bits to select the matching amount.
+
+void aggregateSse2(const int32_t* days, const double* amounts, size_t count, int32_t firstDay, int32_t lastDay,
+                   AmountAggregate& acc) {
+    const __m128i first = _mm_set1_epi32(firstDay);
+    const __m128i last = _mm_set1_epi32(lastDay);
+    const __m128d inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    const __m128d negInf = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+    __m128d sum0 = _mm_setzero_pd(), sum1 = _mm_setzero_pd();
+    __m128d min0 = inf, min1 = inf;
+    __m128d max0 = negInf, max1 = negInf;
+    size_t selected = 0;
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i day = _mm_loadu_si128(reinterpret_cast<const __m128i*>(days + i));
+        const __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(first, day), _mm_cmpgt_epi32(day, last));
+        const __m128d skip0 = _mm_castsi128_pd(_mm_unpacklo_epi32(outside, outside));
+        const __m128d skip1 = _mm_castsi128_pd(_mm_unpackhi_epi32(outside, outside));
+        const __m128d amount0 = _mm_loadu_pd(amounts + i);
+        const __m128d amount1 = _mm_loadu_pd(amounts + i + 2);
+
+        sum0 = _mm_add_pd(sum0, _mm_andnot_pd(skip0, amount0));
+        sum1 = _mm_add_pd(sum1, _mm_andnot_pd(skip1, amount1));
+        min0 = _mm_min_pd(min0, _mm_or_pd(_mm_and_pd(skip0, inf), _mm_andnot_pd(skip0, amount0)));
+        min1 = _mm_min_pd(min1, _mm_or_pd(_mm_and_pd(skip1, inf), _mm_andnot_pd(skip1, amount1)));
+        max0 = _mm_max_pd(max0, _mm_or_pd(_mm_and_pd(skip0, negInf), _mm_andnot_pd(skip0, amount0)));
+        max1 = _mm_max_pd(max1, _mm_or_pd(_mm_and_pd(skip1, negInf), _mm_andnot_pd(skip1, amount1)));
+        selected += 4 - __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(outside)));
+    }
+
+    alignas(16) double lanes[2];
+    AmountAggregate local;
+    _mm_store_pd(lanes, _mm_add_pd(sum0, sum1));
+    local.sum = lanes[0] + lanes[1];
+    _mm_store_pd(lanes, _mm_min_pd(min0, min1));
+    local.min = std::min(lanes[0], lanes[1]);
+    _mm_store_pd(lanes, _mm_max_pd(max0, max1));
+    local.max = std::max(lanes[0], lanes[1]);
+    local.count = selected;
+    acc.merge(local);
+    aggregateScalar(days + i, amounts + i, count - i, firstDay, lastDay, acc);
+}
+
+__attribute__((target("avx2"))) void aggregateAvx2(const int32_t* days, const double* amounts, size_t count,
+                                                   int32_t firstDay, int32_t lastDay, AmountAggregate& acc) {
+    const __m256i first = _mm256_set1_epi32(firstDay);
+    const __m256i last = _mm256_set1_epi32(lastDay);
+    const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    const __m256d negInf = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+    __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+    __m256d min0 = inf, min1 = inf;
+    __m256d max0 = negInf, max1 = negInf;
+    size_t selected = 0;
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i day = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(days + i));
+        const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(first, day), _mm256_cmpgt_epi32(day, last));
+        const __m256d skip0 = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(outside)));
+        const __m256d skip1 = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_extracti128_si256(outside, 1)));
+        const __m256d amount0 = _mm256_loadu_pd(amounts + i);
+        const __m256d amount1 = _mm256_loadu_pd(amounts + i + 4);
+
+        sum0 = _mm256_add_pd(sum0, _mm256_andnot_pd(skip0, amount0));
+        sum1 = _mm256_add_pd(sum1, _mm256_andnot_pd(skip1, amount1));
+        min0 = _mm256_min_pd(min0, _mm256_blendv_pd(amount0, inf, skip0));
+        min1 = _mm256_min_pd(min1, _mm256_blendv_pd(amount1, inf, skip1));
+        max0 = _mm256_max_pd(max0, _mm256_blendv_pd(amount0, negInf, skip0));
+        max1 = _mm256_max_pd(max1, _mm256_blendv_pd(amount1, negInf, skip1));
+        selected += 8 - __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(outside)));
+    }
+
+    alignas(32) double lanes[4];
+    AmountAggregate local;
+    _mm256_store_pd(lanes, _mm256_add_pd(sum0, sum1));
+    local.sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_store_pd(lanes, _mm256_min_pd(min0, min1));
+    local.min = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+    _mm256_store_pd(lanes, _mm256_max_pd(max0, max1));
+    local.max = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    local.count = selected;
+    acc.merge(local);
+    aggregateScalar(days + i, amounts + i, count - i, firstDay, lastDay, acc);
+}
+
+#endif // EXPENSE_SCAN_X86
+
+struct KernelChoice {
+    AggregateKernel kernel;
+    const char* name;
+};
+
+KernelChoice selectKernel() {
+#ifdef EXPENSE_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {aggregateAvx2, "avx2"};
+    }
+    return {aggregateSse2, "sse2"}; // Baseline on x86-64
+#else
+    return {aggregateScalar, "scalar"};
+#endif
+}
+
+const KernelChoice& activeKernel() {
+    static const KernelChoice choice = selectKernel();
+    return choice;
+}
+
+} // namespace
+
+void aggregateDayRange(const int32_t* days, const double* amounts, size_t count, int32_t firstDay,
+                       int32_t lastDay, AmountAggregate& acc) {
+    activeKernel().kernel(days, amounts, count, firstDay, lastDay, acc);
+}
+
+const char* scanKernelName() {
+    return activeKernel().name;
+}
+
+} // namespace expense_tracker
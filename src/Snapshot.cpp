@@ -0,0 +1,400 @@
+#include "Snapshot.h"
+#include "AtomicFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace expense_tracker {
+
+namespace {
+
+constexpr char kMagic[8] = {'E', 'X', 'P', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t kByteOrderMark = 0x01020304;
+constexpr uint64_t kSectionAlignment = 64;
+// Description bytes are split into arena blocks of at most this size, because
+// a StringArena handle stores the in-block offset in 32 bits.
+constexpr uint64_t kMaxDescriptionBlock = uint64_t{1} << 30;
+
+enum SectionId : uint32_t {
+    kDaysSection,               // int32_t[rows]
+    kAmountsSection,            // double[rows]
+    kCategoriesSection,         // CategoryId[rows]
+    kTypesSection,              // uint8_t[rows]
+    kDescriptionHandlesSection, // StringArena::Handle[rows]
+    kDescriptionBlocksSection,  // uint64_t[blocks]: size of each arena block
+    kDescriptionBytesSection,   // arena blocks, back to back
+    kCategoryNamesSection,      // per name: uint32_t length + bytes
+    kIndexKeysSection,          // int32_t[index_count], sorted
+    kIndexRowsSection,          // RowId[index_count]
+    kRollupsSection,            // RollupEntry[]
+    kIdsSection,                // ExpenseId[rows]
+    kSectionCount
+};
+
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t row_count;         // Physical rows, tombstoned ones included
+    uint64_t dead_count;
+    uint64_t next_id;
+    uint64_t index_count;       // Every row, deleted ones included (see DateIndex)
+    uint64_t source_size;
+    int64_t source_mtime_ns;
+    SnapshotSection sections[kSectionCount];
+    // Recorded by the writer so that open can check every subscript column
+    // against the dictionary and row counts without reading it.
+    uint64_t category_bound;    // 1 + largest category id in the column, 0 if none
+    uint64_t index_row_bound;   // 1 + largest row in the index, 0 if none
+    uint32_t type_bound;        // 1 + largest type byte, 0 if none
+    uint32_t ids_ascending;     // 1 if ids ascend in row order (ExpenseStore::idsAscending)
+    uint64_t checksum;          // headerChecksum of everything above
+};
+
+// Owns a read-only mapping; shared by every column that borrows from it.
+struct MappedFile {
+    void* address = MAP_FAILED;
+    size_t size = 0;
+
+    ~MappedFile() {
+        if (address != MAP_FAILED) {
+            munmap(address, size);
+        }
+    }
+};
+
+class SectionWriter {
+public:
+    explicit SectionWriter(std::ofstream& out) : out_(out) {}
+
+    void begin(SnapshotSection& section) {
+        static const char zeros[kSectionAlignment] = {};
+        const uint64_t padding = (kSectionAlignment - position_ % kSectionAlignment) % kSectionAlignment;
+        current_ = nullptr; // Padding belongs to no section
+        write(zeros, padding);
+        section.offset = position_;
+        current_ = &section;
+    }
+
+    void write(const void* data, uint64_t size) {
+        out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        position_ += size;
+        if (current_) {
+            current_->size += size;
+        }
+    }
+
+    template <typename T>
+    void writeColumn(const ChunkedColumn<T>& column) {
+        for (size_t chunk = 0; chunk < column.chunkCount(); ++chunk) {
+            write(column.chunkData(chunk), column.chunkLength(chunk) * sizeof(T));
+        }
+    }
+
+    void end() { current_ = nullptr; }
+    void seekStart(uint64_t position) { position_ = position; }
+
+private:
+    std::ofstream& out_;
+    uint64_t position_ = 0;
+    SnapshotSection* current_ = nullptr;
+};
+
+bool sectionFits(const SnapshotSection& section, uint64_t expectedSize, size_t fileSize) {
+    return section.size == expectedSize && section.offset % kSectionAlignment == 0 &&
+           section.offset <= fileSize && section.size <= fileSize - section.offset;
+}
+
+// FNV-1a over the header, with the checksum field itself taken as zero.
+uint64_t headerChecksum(SnapshotHeader header) {
+    header.checksum = 0;
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&header);
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (size_t i = 0; i < sizeof(header); ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+bool rollupsValid(const RollupEntry* rollups, size_t rollupCount, size_t categoryCount) {
+    for (size_t entry = 0; entry < rollupCount; ++entry) {
+        const RollupEntry& rollup = rollups[entry];
+        if (rollup.kind < RollupEntry::kDay || rollup.kind > RollupEntry::kMonthCategory ||
+            (rollup.kind == RollupEntry::kMonthCategory && rollup.category >= categoryCount)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool statSource(const std::string& path, SourceStamp& stamp) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+    stamp.size = static_cast<uint64_t>(info.st_size);
+    stamp.mtime_ns = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    return true;
+}
+
+bool writeSnapshot(const std::string& path, const ExpenseStore& store, const DateIndex& index,
+                   const ExpenseRollups& rollups, const SourceStamp& source) {
+    index.flush();
+    const std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open snapshot file for writing: " << tempPath << std::endl;
+        return false;
+    }
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kSnapshotVersion;
+    header.byte_order = kByteOrderMark;
+    header.row_count = store.size();
+    header.dead_count = store.deadCount();
+    header.next_id = store.nextId();
+    header.index_count = index.sortedSize();
+    header.source_size = source.size;
+    header.source_mtime_ns = source.mtime_ns;
+    header.ids_ascending = store.idsAscending() ? 1 : 0;
+    for (size_t row = 0; row < store.size(); ++row) {
+        header.category_bound = std::max<uint64_t>(header.category_bound, uint64_t{store.categoryIdAt(row)} + 1);
+        header.type_bound = std::max<uint32_t>(header.type_bound, static_cast<uint32_t>(store.typeAt(row)) + 1);
+    }
+    for (size_t i = 0; i < index.sortedSize(); ++i) {
+        header.index_row_bound = std::max<uint64_t>(header.index_row_bound, uint64_t{index.rows()[i]} + 1);
+    }
+
+    SectionWriter writer(out);
+    writer.write(&header, sizeof(header)); // Placeholder, rewritten once offsets are known
+
+    writer.begin(header.sections[kDaysSection]);
+    writer.writeColumn(store.dayNumbers());
+    writer.begin(header.sections[kAmountsSection]);
+    writer.writeColumn(store.amounts());
+    writer.begin(header.sections[kCategoriesSection]);
+    writer.writeColumn(store.categoryIds());
+    writer.begin(header.sections[kTypesSection]);
+    writer.writeColumn(store.types());
+    writer.begin(header.sections[kIdsSection]);
+    writer.writeColumn(store.ids());
+
+    // Descriptions are re-packed into fresh arena blocks, which also drops the
+    // bytes of rows deleted since the last load (tombstoned rows are kept, with
+    // an empty description). First pass: handles.
+    auto descriptionOf = [&store](size_t row) {
+        return store.isLive(row) ? store.descriptionAt(row) : std::string_view();
+    };
+    std::vector<uint64_t> blockSizes(1, 0);
+    writer.begin(header.sections[kDescriptionHandlesSection]);
+    for (size_t row = 0; row < store.size(); ++row) {
+        const size_t size = StringArena::encodedSize(descriptionOf(row));
+        if (blockSizes.back() + size > kMaxDescriptionBlock && blockSizes.back() > 0) {
+            blockSizes.push_back(0);
+        }
+        const StringArena::Handle handle = StringArena::makeHandle(blockSizes.size() - 1, blockSizes.back());
+        writer.write(&handle, sizeof(handle));
+        blockSizes.back() += size;
+    }
+    writer.begin(header.sections[kDescriptionBlocksSection]);
+    writer.write(blockSizes.data(), blockSizes.size() * sizeof(uint64_t));
+
+    // Second pass: the encoded bytes, buffered to keep write() calls large.
+    writer.begin(header.sections[kDescriptionBytesSection]);
+    std::vector<char> buffer;
+    buffer.reserve(1 << 20);
+    for (size_t row = 0; row < store.size(); ++row) {
+        const std::string_view text = descriptionOf(row);
+        const size_t start = buffer.size();
+        buffer.resize(start + StringArena::encodedSize(text));
+        StringArena::encode(buffer.data() + start, text);
+        if (buffer.size() >= (1 << 20)) {
+            writer.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    writer.write(buffer.data(), buffer.size());
+
+    writer.begin(header.sections[kCategoryNamesSection]);
+    for (const std::string& name : store.categoryNames()) {
+        const auto length = static_cast<uint32_t>(name.size());
+        writer.write(&length, sizeof(length));
+        writer.write(name.data(), name.size());
+    }
+
+    writer.begin(header.sections[kIndexKeysSection]);
+    writer.writeColumn(index.keys());
+    writer.begin(header.sections[kIndexRowsSection]);
+    writer.writeColumn(index.rows());
+
+    const std::vector<RollupEntry> entries = rollups.exportEntries();
+    writer.begin(header.sections[kRollupsSection]);
+    writer.write(entries.data(), entries.size() * sizeof(RollupEntry));
+    writer.end();
+
+    header.checksum = headerChecksum(header);
+    out.seekp(0);
+    writer.seekStart(0);
+    writer.write(&header, sizeof(header));
+    out.close();
+    if (!out) {
+        std::cerr << "Error: An error occurred while writing snapshot file: " << tempPath << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    if (!replaceFile(tempPath, path)) {
+        std::cerr << "Error: Could not move snapshot into place: " << path << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool openSnapshot(const std::string& path, ExpenseStore& store, DateIndex& index,
+                  ExpenseRollups& rollups, const SourceStamp* expectedSource) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open snapshot file: " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SnapshotHeader)) {
+        std::cerr << "Error: Snapshot file is truncated: " << path << std::endl;
+        close(fd);
+        return false;
+    }
+
+    auto mapping = std::make_shared<MappedFile>();
+    mapping->size = static_cast<size_t>(info.st_size);
+    mapping->address = mmap(nullptr, mapping->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file contents reachable
+    if (mapping->address == MAP_FAILED) {
+        std::cerr << "Error: Could not map snapshot file: " << path << std::endl;
+        return false;
+    }
+
+    const char* base = static_cast<const char*>(mapping->address);
+    SnapshotHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.byte_order != kByteOrderMark) {
+        std::cerr << "Error: Not an expense snapshot (or written on another architecture): " << path << std::endl;
+        return false;
+    }
+    if (header.version != kSnapshotVersion) {
+        std::cerr << "Error: Unsupported snapshot version " << header.version << " in " << path << std::endl;
+        return false;
+    }
+    if (header.checksum != headerChecksum(header)) {
+        std::cerr << "Error: Snapshot header is corrupt: " << path << std::endl;
+        return false;
+    }
+    if (expectedSource && !(SourceStamp{header.source_size, header.source_mtime_ns} == *expectedSource)) {
+        return false; // Stale cache; the caller falls back to the CSV
+    }
+
+    const uint64_t rows = header.row_count;
+    const SnapshotSection* sections = header.sections;
+    const size_t fileSize = mapping->size;
+    bool valid = rows <= UINT32_MAX && header.dead_count <= rows && header.index_count == rows &&
+                 sectionFits(sections[kDaysSection], rows * sizeof(int32_t), fileSize) &&
+                 sectionFits(sections[kAmountsSection], rows * sizeof(double), fileSize) &&
+                 sectionFits(sections[kCategoriesSection], rows * sizeof(CategoryId), fileSize) &&
+                 sectionFits(sections[kTypesSection], rows, fileSize) &&
+                 sectionFits(sections[kDescriptionHandlesSection], rows * sizeof(StringArena::Handle), fileSize) &&
+                 sectionFits(sections[kIdsSection], rows * sizeof(ExpenseId), fileSize) &&
+                 sectionFits(sections[kIndexKeysSection], header.index_count * sizeof(int32_t), fileSize) &&
+                 sectionFits(sections[kIndexRowsSection], header.index_count * sizeof(RowId), fileSize) &&
+                 header.index_row_bound <= rows && header.type_bound <= 2;
+    for (uint32_t id : {kDescriptionBlocksSection, kDescriptionBytesSection, kCategoryNamesSection, kRollupsSection}) {
+        valid = valid && sectionFits(sections[id], sections[id].size, fileSize);
+    }
+    valid = valid && sections[kDescriptionBlocksSection].size % sizeof(uint64_t) == 0 &&
+            sections[kRollupsSection].size % sizeof(RollupEntry) == 0;
+    if (!valid) {
+        std::cerr << "Error: Snapshot file is corrupt or truncated: " << path << std::endl;
+        return false;
+    }
+
+    ExpenseStore::MappedColumns columns;
+    columns.rows = static_cast<size_t>(rows);
+    columns.days = reinterpret_cast<const int32_t*>(base + sections[kDaysSection].offset);
+    columns.amounts = reinterpret_cast<const double*>(base + sections[kAmountsSection].offset);
+    columns.categories = reinterpret_cast<const CategoryId*>(base + sections[kCategoriesSection].offset);
+    columns.types = reinterpret_cast<const uint8_t*>(base + sections[kTypesSection].offset);
+    columns.description_handles =
+        reinterpret_cast<const StringArena::Handle*>(base + sections[kDescriptionHandlesSection].offset);
+    columns.ids = reinterpret_cast<const ExpenseId*>(base + sections[kIdsSection].offset);
+    columns.dead = static_cast<size_t>(header.dead_count);
+    columns.next_id = header.next_id;
+    columns.ids_ascending = header.ids_ascending == 1;
+
+    const auto* blockSizes = reinterpret_cast<const uint64_t*>(base + sections[kDescriptionBlocksSection].offset);
+    const size_t blockCount = sections[kDescriptionBlocksSection].size / sizeof(uint64_t);
+    uint64_t blockOffset = 0;
+    for (size_t block = 0; block < blockCount; ++block) {
+        if (blockSizes[block] > sections[kDescriptionBytesSection].size - blockOffset) {
+            std::cerr << "Error: Snapshot description blocks are corrupt: " << path << std::endl;
+            return false;
+        }
+        columns.description_blocks.emplace_back(base + sections[kDescriptionBytesSection].offset + blockOffset,
+                                                static_cast<size_t>(blockSizes[block]));
+        blockOffset += blockSizes[block];
+    }
+    // The writer lays the handles out over exactly these blocks.
+    if (blockOffset != sections[kDescriptionBytesSection].size) {
+        std::cerr << "Error: Snapshot description blocks are corrupt: " << path << std::endl;
+        return false;
+    }
+
+    const char* names = base + sections[kCategoryNamesSection].offset;
+    const char* namesEnd = names + sections[kCategoryNamesSection].size;
+    while (names < namesEnd) {
+        uint32_t length = 0;
+        if (static_cast<size_t>(namesEnd - names) < sizeof(length)) {
+            std::cerr << "Error: Snapshot category dictionary is corrupt: " << path << std::endl;
+            return false;
+        }
+        std::memcpy(&length, names, sizeof(length));
+        names += sizeof(length);
+        if (length > static_cast<size_t>(namesEnd - names)) {
+            std::cerr << "Error: Snapshot category dictionary is corrupt: " << path << std::endl;
+            return false;
+        }
+        columns.category_names.emplace_back(names, length);
+        names += length;
+    }
+
+    const auto* indexRows = reinterpret_cast<const RowId*>(base + sections[kIndexRowsSection].offset);
+    const auto* rollupEntries = reinterpret_cast<const RollupEntry*>(base + sections[kRollupsSection].offset);
+    const size_t rollupCount = sections[kRollupsSection].size / sizeof(RollupEntry);
+    if (header.category_bound > columns.category_names.size() ||
+        !rollupsValid(rollupEntries, rollupCount, columns.category_names.size())) {
+        std::cerr << "Error: Snapshot file is corrupt: " << path << std::endl;
+        return false;
+    }
+
+    store.borrowColumns(columns, mapping);
+    index.borrow(reinterpret_cast<const int32_t*>(base + sections[kIndexKeysSection].offset), indexRows,
+                 columns.days, static_cast<size_t>(header.index_count), mapping);
+    rollups.importEntries(rollupEntries, rollupCount);
+    return true;
+}
+
+} // namespace expense_tracker
@@ -0,0 +1,111 @@
+#include "StringArena.h"
+#include <algorithm>
+#include <cstring>
+
+namespace expense_tracker {
+
+namespace {
+
+constexpr size_t kMaxVarintBytes = 10;
+
+size_t writeVarint(char* out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out[n++] = static_cast<char>(value);
+    return n;
+}
+
+// Returns the position after the varint, or nullptr if it runs past `end` or
+// is longer than any length append() writes.
+const char* readVarint(const char* in, const char* end, uint64_t& value) {
+    value = 0;
+    for (size_t shift = 0; in < end && shift < 7 * kMaxVarintBytes; shift += 7) {
+        const auto byte = static_cast<unsigned char>(*in++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return in;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+StringArena::Handle StringArena::append(std::string_view text) {
+    const size_t needed = text.size() + kMaxVarintBytes;
+    if (blocks_.empty() || blocks_.back().capacity - blocks_.back().used < needed) {
+        // Oversized strings get a block of their own; everything else shares 1 MiB blocks.
+        Block block;
+        block.capacity = std::max(kBlockSize, needed);
+        block.data.reset(new char[block.capacity]);
+        blocks_.push_back(std::move(block));
+    }
+
+    Block& block = blocks_.back();
+    const Handle handle = makeHandle(blocks_.size() - 1, block.used);
+    block.used += encode(block.data.get() + block.used, text);
+    return handle;
+}
+
+size_t StringArena::encodedSize(std::string_view text) {
+    size_t prefix = 1;
+    for (uint64_t length = text.size(); length >= 0x80; length >>= 7) {
+        ++prefix;
+    }
+    return prefix + text.size();
+}
+
+size_t StringArena::encode(char* out, std::string_view text) {
+    const size_t prefix = writeVarint(out, text.size());
+    if (!text.empty()) { // data() may be null for an empty view
+        std::memcpy(out + prefix, text.data(), text.size());
+    }
+    return prefix + text.size();
+}
+
+void StringArena::borrowBlock(const char* data, size_t size, const std::shared_ptr<const void>& owner) {
+    Block block;
+    block.data = std::shared_ptr<char[]>(owner, const_cast<char*>(data));
+    block.capacity = size;
+    block.used = size;
+    block.borrowed = true;
+    blocks_.push_back(std::move(block));
+}
+
+// Handles of borrowed blocks are read from a mapped snapshot that open does
+// not scan, so every handle is checked against its block here; one that does
+// not point at a whole entry reads as an empty string instead of out of bounds.
+std::string_view StringArena::get(Handle handle) const {
+    const size_t index = static_cast<size_t>(handle >> 32);
+    const size_t offset = static_cast<size_t>(handle & 0xFFFFFFFFu);
+    if (index >= blocks_.size() || offset >= blocks_[index].used) {
+        return std::string_view();
+    }
+    const Block& block = blocks_[index];
+    const char* end = block.data.get() + block.used;
+    uint64_t length = 0;
+    const char* text = readVarint(block.data.get() + offset, end, length);
+    if (!text || length > static_cast<uint64_t>(end - text)) {
+        return std::string_view();
+    }
+    return std::string_view(text, static_cast<size_t>(length));
+}
+
+void StringArena::clear() {
+    blocks_.clear();
+}
+
+size_t StringArena::memoryUsage() const {
+    size_t total = 0;
+    for (const auto& block : blocks_) {
+        if (!block.borrowed) {
+            total += block.capacity;
+        }
+    }
+    return total;
+}
+
+} // namespace expense_tracker
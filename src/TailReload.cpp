@@ -0,0 +1,329 @@
+#include "ExpenseManager.h"
+#include "CsvCodec.h"
+#include "ExpenseSegment.h"
+#include "Snapshot.h"
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Incremental reload for ExpenseManager::reloadExpenses, and the inotify
+// watcher that triggers it.
+//
+// A bank feed appends whole records to the end of the ledger CSV. After a
+// load, tail_ remembers the file's device and inode, the offset just past
+// the last complete record, and the bytes right before that offset. A reload
+// reads only from there: if the file is the same inode, has not shrunk and
+// still holds those bytes at that offset, everything after them is new
+// records. Anything else means the file was truncated, replaced or
+// rewritten, and the caller loads it whole.
+
+namespace expense_tracker {
+
+namespace {
+
+// Bytes before the offset compared on every reload. A rewrite that keeps the
+// inode and does not shrink the file (e.g. `>` redirection of a longer
+// ledger) almost always changes them.
+constexpr size_t kFingerprintBytes = 64;
+// The header record must fit in this much of the start of the file.
+constexpr size_t kMaxHeaderBytes = 64 * 1024;
+
+// pread until `size` bytes are read or the file ends. Returns the bytes read,
+// or -1 on error.
+ssize_t readAt(int fd, char* out, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t n = pread(fd, out + done, size - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<ssize_t>(done);
+}
+
+// Position just past the last record-ending newline in [p, end), or `p` if
+// there is none; `p` must be a record start. What follows is a record the
+// writer has not finished yet.
+const char* lastRecordEnd(const char* p, const char* end) {
+    const char* last = p;
+    bool inQuotes = false;
+    for (; p < end; ++p) {
+        if (*p == '"') {
+            inQuotes = !inQuotes;
+        } else if (*p == '\n' && !inQuotes) {
+            last = p + 1;
+        }
+    }
+    return last;
+}
+
+// Maps the header at the start of the file. False if it is unreadable,
+// longer than kMaxHeaderBytes or lacks a required column.
+bool readLayout(int fd, uint64_t fileSize, CsvLayout& layout) {
+    std::string head(static_cast<size_t>(std::min<uint64_t>(fileSize, kMaxHeaderBytes)), '\0');
+    if (readAt(fd, &head[0], head.size(), 0) != static_cast<ssize_t>(head.size())) {
+        return false;
+    }
+    std::vector<std::string_view> fields;
+    size_t newlines = 0;
+    splitCsvRecord(head.data(), head.data() + head.size(), fields, newlines);
+    CsvColumn missing;
+    return newlines > 0 && mapCsvHeader(fields, layout, missing);
+}
+
+} // namespace
+
+bool ExpenseManager::reloadExpenses(const std::string& filename, size_t* rowsAdded) {
+    const std::string filepath = "data/" + filename;
+    size_t added = 0;
+    bool ok = true;
+    bool appended = false;
+    {
+        WriteLock lock(*this);
+        if (saves_in_flight_.count(filepath)) {
+            // Our own save is renaming a new file into place (the watcher
+            // sees that too). It holds no row the store lacks, and a full
+            // load would drop the changes made since the save began;
+            // followSavedFile follows the new file once the save is done.
+            appended = true;
+        } else if (tail_.following && tail_.path == filepath && !journal_ && !partitioned_) {
+            OperationTimer timer(*stats_, Operation::kReload);
+            uint64_t bytesRead = 0;
+            appended = loadTail(added, bytesRead, ok);
+            timer.bytesRead(bytesRead);
+            timer.rows(added, added);
+        }
+    }
+    if (!appended) {
+        ok = loadExpenses(filename);
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        added = store_.liveCount();
+    }
+    if (rowsAdded) {
+        *rowsAdded = added;
+    }
+    return ok;
+}
+
+void ExpenseManager::followFile(const SourceStamp* loadedAs) const {
+    tail_.following = false;
+    tail_.has_layout = false;
+    const int fd = open(tail_.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat info;
+    SourceStamp now;
+    // A file that changed while it was being loaded may hold rows the load
+    // did not see, so it is not followed; the next reload is a full one.
+    if (fstat(fd, &info) == 0 && statSource(tail_.path, now) && (!loadedAs || now == *loadedAs)) {
+        const uint64_t size = static_cast<uint64_t>(info.st_size);
+        std::string last(static_cast<size_t>(std::min<uint64_t>(size, kFingerprintBytes)), '\0');
+        // Likewise if the last record lacks its newline: it was loaded as it
+        // stood, but its writer may not be done with it.
+        if (readAt(fd, &last[0], last.size(), size - last.size()) == static_cast<ssize_t>(last.size()) &&
+            !last.empty() && last.back() == '\n') {
+            tail_.following = true;
+            tail_.device = static_cast<uint64_t>(info.st_dev);
+            tail_.inode = static_cast<uint64_t>(info.st_ino);
+            tail_.offset = size;
+            tail_.fingerprint = std::move(last);
+        }
+    }
+    close(fd);
+}
+
+void ExpenseManager::followSavedFile(const std::string& filepath, bool saved) const {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    const auto inFlight = saves_in_flight_.find(filepath);
+    if (--inFlight->second == 0) {
+        saves_in_flight_.erase(inFlight);
+    }
+    if (saved && tail_.path == filepath && !hasSegmentExtension(filepath)) {
+        followFile(nullptr); // The file now holds exactly rows the store has
+    }
+}
+
+bool ExpenseManager::loadTail(size_t& rowsAdded, uint64_t& bytesRead, bool& ok) {
+    rowsAdded = 0;
+    bytesRead = 0;
+    ok = true;
+    const int fd = open(tail_.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false; // Gone; the full reload reports it
+    }
+    struct stat info;
+    bool same = fstat(fd, &info) == 0 && static_cast<uint64_t>(info.st_dev) == tail_.device &&
+                static_cast<uint64_t>(info.st_ino) == tail_.inode &&
+                static_cast<uint64_t>(info.st_size) >= tail_.offset;
+    // Read from the start of the fingerprint, so a single read both checks
+    // it and fetches the new records.
+    const size_t kept = tail_.fingerprint.size();
+    std::string buffer;
+    if (same) {
+        const uint64_t start = tail_.offset - kept;
+        buffer.resize(static_cast<size_t>(static_cast<uint64_t>(info.st_size) - start));
+        same = readAt(fd, &buffer[0], buffer.size(), start) == static_cast<ssize_t>(buffer.size()) &&
+               buffer.compare(0, kept, tail_.fingerprint) == 0;
+    }
+    if (same && !tail_.has_layout) {
+        same = tail_.has_layout = readLayout(fd, static_cast<uint64_t>(info.st_size), tail_.layout);
+    }
+    close(fd);
+    if (!same) {
+        return false;
+    }
+    bytesRead = buffer.size();
+
+    const CsvLayout& layout = tail_.layout;
+    const char* const base = buffer.data() + kept;
+    const char* const end = lastRecordEnd(base, buffer.data() + buffer.size());
+    const char* p = base;
+    std::vector<std::string_view> fields;
+    std::string decoded[kCsvColumnCount];
+    while (p < end) {
+        const char* const record = p;
+        const uint64_t at = tail_.offset + static_cast<uint64_t>(record - base);
+        size_t newlines = 0;
+        p = splitCsvRecord(p, end, fields, newlines);
+        if (fields.size() == 1 && fields[0].empty()) {
+            continue; // Blank line
+        }
+        // Like a full load, a malformed record stops the reload. It is left
+        // unconsumed, so every reload reports it until the file is fixed.
+        std::string error;
+        double amount = 0;
+        if (fields.size() < layout.min_fields) {
+            error = "too few columns";
+        } else {
+            for (int column = 0; column < kCsvColumnCount; ++column) {
+                if (layout.column_of[column] == CsvLayout::kMissing) {
+                    decoded[column].clear();
+                } else {
+                    decodeCsvField(fields[layout.column_of[column]], decoded[column]);
+                }
+            }
+            if (!parseAmount(decoded[kCsvAmount], amount)) {
+                error = "could not parse amount '" + decoded[kCsvAmount] + "'";
+            }
+        }
+        if (!error.empty()) {
+            std::cerr << "Error: Exception while reading CSV file: " << tail_.path << " - " << error
+                      << " (byte offset " << at << ")" << std::endl;
+            p = record;
+            ok = false;
+            break;
+        }
+        Date date;
+        TransactionType type;
+        const std::string warning = validateRow(decoded[kCsvDate], decoded[kCsvType], date, type);
+        if (!warning.empty()) {
+            std::cerr << "Warning: " << warning << " (byte offset " << at << "). Skipping row." << std::endl;
+            continue;
+        }
+        ExpenseId id;
+        if (!parseExpenseId(decoded[kCsvId], id)) {
+            id = kNoExpenseId; // Blank, malformed or no Id column: the store assigns one
+        }
+        appendRow(decoded[kCsvDescription], amount, toDayNumber(date), decoded[kCsvCategory], type, id);
+        ++rowsAdded;
+    }
+
+    const char* const consumedEnd = p;
+    tail_.offset += static_cast<uint64_t>(consumedEnd - base);
+    const char* const fingerprintStart = consumedEnd - std::min<size_t>(consumedEnd - buffer.data(), kFingerprintBytes);
+    tail_.fingerprint.assign(fingerprintStart, consumedEnd);
+    return true;
+}
+
+bool ExpenseManager::watchExpenses(const std::string& filename, ReloadCallback onReload) {
+    stopWatching();
+    // Watching the directory rather than the file also sees the file being
+    // created or renamed into place, which a watch on the old inode misses.
+    const std::string filepath = "data/" + filename;
+    const size_t slash = filepath.rfind('/');
+    const std::string directory = filepath.substr(0, slash);
+    const std::string name = filepath.substr(slash + 1);
+    const int inotifyFd = inotify_init1(IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        std::cerr << "Error: Could not start watching " << filepath << std::endl;
+        return false;
+    }
+    int stopPipe[2];
+    if (inotify_add_watch(inotifyFd, directory.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO) < 0 ||
+        pipe2(stopPipe, O_CLOEXEC) != 0) {
+        std::cerr << "Error: Could not start watching " << filepath << std::endl;
+        close(inotifyFd);
+        return false;
+    }
+    watch_stop_fd_ = stopPipe[1];
+    watch_thread_ = std::thread([this, inotifyFd, stopFd = stopPipe[0], filename, name, onReload] {
+        auto reload = [&] {
+            size_t added = 0;
+            const bool loaded = reloadExpenses(filename, &added);
+            if (onReload) {
+                onReload(loaded, added);
+            }
+        };
+        reload(); // Catch up with whatever happened before the watch started
+        alignas(inotify_event) char events[4096];
+        pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopFd, POLLIN, 0}};
+        for (;;) {
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "Error: Stopped watching " << name << " after a poll failure" << std::endl;
+                break;
+            }
+            if (fds[1].revents) {
+                break;
+            }
+            const ssize_t length = read(inotifyFd, events, sizeof(events));
+            // One reload per batch of events: a burst of appends is read in
+            // one go.
+            bool touched = false;
+            for (ssize_t offset = 0; offset < length;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(events + offset);
+                touched = touched || (event->len > 0 && name == event->name);
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+            if (touched) {
+                reload();
+            }
+        }
+        close(inotifyFd);
+        close(stopFd);
+    });
+    return true;
+}
+
+void ExpenseManager::stopWatching() {
+    if (!watch_thread_.joinable()) {
+        return;
+    }
+    const char wake = 0;
+    while (write(watch_stop_fd_, &wake, 1) < 0 && errno == EINTR) {
+    }
+    watch_thread_.join();
+    close(watch_stop_fd_);
+    watch_stop_fd_ = -1;
+}
+
+} // namespace expense_tracker
@@ -0,0 +1,150 @@
+#include "TextIndex.h"
+#include <algorithm>
+#include <mutex>
+
+namespace expense_tracker {
+
+namespace {
+
+// Stands in front of every description; a byte that does not occur in text.
+constexpr unsigned char kStartMarker = 0x01;
+
+uint32_t gramKey(unsigned char a, unsigned char b, unsigned char c) {
+    return (static_cast<uint32_t>(a) << 16) | (static_cast<uint32_t>(b) << 8) | c;
+}
+
+// Appends the grams of `text`, preceded by two start markers if `anchored`.
+void appendGrams(std::string_view text, bool anchored, std::vector<uint32_t>& grams) {
+    const auto byte = [&](size_t i) -> unsigned char {
+        if (anchored) {
+            return i < 2 ? kStartMarker : static_cast<unsigned char>(text[i - 2]);
+        }
+        return static_cast<unsigned char>(text[i]);
+    };
+    const size_t length = text.size() + (anchored ? 2 : 0);
+    for (size_t i = 0; i + 3 <= length; ++i) {
+        grams.push_back(gramKey(byte(i), byte(i + 1), byte(i + 2)));
+    }
+}
+
+} // namespace
+
+std::shared_ptr<TextIndex> TextIndex::build(const ExpenseStore& store) {
+    auto index = std::make_shared<TextIndex>();
+    for (size_t row = 0; row < store.size(); ++row) {
+        index->addLocked(static_cast<RowId>(row), store.descriptionAt(row));
+    }
+    return index;
+}
+
+void TextIndex::add(RowId row, std::string_view description) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    addLocked(row, description);
+}
+
+void TextIndex::addLocked(RowId row, std::string_view description) {
+    scratch_.clear();
+    appendGrams(description, true, scratch_);
+    // A gram repeated within one description is posted once.
+    std::sort(scratch_.begin(), scratch_.end());
+    scratch_.erase(std::unique(scratch_.begin(), scratch_.end()), scratch_.end());
+    for (uint32_t gram : scratch_) {
+        postings_[gram].push_back(row);
+    }
+}
+
+std::shared_ptr<TextIndex> TextIndex::compacted(const ExpenseStore& store) const {
+    // Live rows keep their order, so a row's new number is the count of live
+    // rows before it.
+    std::vector<RowId> newRows(store.size());
+    RowId next = 0;
+    for (size_t row = 0; row < store.size(); ++row) {
+        newRows[row] = next;
+        next += store.isLive(row) ? 1 : 0;
+    }
+    // Only the writer modifies an index, and it is the caller, so reading
+    // without the lock is safe.
+    auto index = std::make_shared<TextIndex>();
+    for (const auto& entry : postings_) {
+        Posting kept;
+        for (RowId row : entry.second) {
+            if (row < store.size() && store.isLive(row)) {
+                kept.push_back(newRows[row]);
+            }
+        }
+        if (!kept.empty()) {
+            kept.shrink_to_fit();
+            index->postings_.emplace(entry.first, std::move(kept));
+        }
+    }
+    return index;
+}
+
+bool TextIndex::candidates(const std::vector<std::string>& substrings, const std::vector<std::string>& prefixes,
+                           size_t rowLimit, std::vector<RowId>& rows) const {
+    std::vector<uint32_t> grams;
+    for (const std::string& text : substrings) {
+        appendGrams(text, false, grams);
+    }
+    for (const std::string& text : prefixes) {
+        if (!text.empty()) {
+            appendGrams(text, true, grams);
+        }
+    }
+    if (grams.empty()) {
+        return false;
+    }
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    // Each list cut at rowLimit, then intersected shortest first: the running
+    // result only shrinks, and every further list is probed by binary search
+    // from where the previous probe left off.
+    std::vector<std::pair<const RowId*, const RowId*>> lists;
+    for (uint32_t gram : grams) {
+        const auto it = postings_.find(gram);
+        if (it == postings_.end()) {
+            rows.clear();
+            return true;
+        }
+        const RowId* begin = it->second.data();
+        const RowId* end = std::lower_bound(begin, begin + it->second.size(), rowLimit);
+        if (begin == end) {
+            rows.clear();
+            return true;
+        }
+        lists.emplace_back(begin, end);
+    }
+    std::sort(lists.begin(), lists.end(), [](const auto& a, const auto& b) {
+        return a.second - a.first < b.second - b.first;
+    });
+    rows.assign(lists[0].first, lists[0].second);
+    for (size_t i = 1; i < lists.size() && !rows.empty(); ++i) {
+        const RowId* cursor = lists[i].first;
+        const RowId* const end = lists[i].second;
+        size_t kept = 0;
+        for (RowId row : rows) {
+            cursor = std::lower_bound(cursor, end, row);
+            if (cursor == end) {
+                break;
+            }
+            if (*cursor == row) {
+                rows[kept++] = row;
+            }
+        }
+        rows.resize(kept);
+    }
+    return true;
+}
+
+size_t TextIndex::memoryUsage() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    size_t bytes = postings_.bucket_count() * sizeof(void*);
+    for (const auto& entry : postings_) {
+        bytes += sizeof(entry) + entry.second.capacity() * sizeof(RowId);
+    }
+    return bytes;
+}
+
+} // namespace expense_tracker
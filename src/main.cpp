@@ -3,8 +3,11 @@
 #include <string>
 #include <limits> // Required for std::numeric_limits
 #include <cstdio> // For sscanf
+#include <chrono>
+#include <future>
 
 #include "ExpenseManager.h" // Assuming ExpenseManager.h is in include/
+#include "BatchMode.h"     // Non-interactive mode, used when arguments are given
 #include "Expense.h"        // Assuming Expense.h is in include/
 #include "fmt/core.h"       // For fmt::print (optional, can use iostream)
 
@@ -33,6 +36,18 @@ int getIntInput() {
     return choice;
 }
 
+// Helper to get a valid expense id
+expense_tracker::ExpenseId getIdInput() {
+    expense_tracker::ExpenseId id;
+    while (!(std::cin >> id)) {
+        fmt::print("Invalid input. Please enter an expense ID: ");
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // consume newline
+    return id;
+}
+
 // Helper to get valid double input
 double getDoubleInput() {
     double value;
@@ -45,26 +60,31 @@ double getDoubleInput() {
     return value;
 }
 
-// Helper function to print a collection of expenses
-void printExpenses(const std::vector<expense_tracker::Expense>& expenses, const std::string& header) {
+// Helper function to print a collection of expenses (a zero-copy view into the manager)
+void printExpenses(const expense_tracker::ExpenseView& expenses, const std::string& header) {
     if (expenses.empty()) {
         fmt::print("{}\nNo expenses found.\n", header);
         return;
     }
     fmt::print("{}\n", header);
     fmt::print("--------------------------------------------------------------------\n");
-    fmt::print("{:<4} | {:<10} | {:<20} | {:<10} | {:<10} | {:<10}\n", "Idx", "Date", "Description", "Amount", "Category", "Type");
+    fmt::print("{:<4} | {:<10} | {:<20} | {:<10} | {:<10} | {:<10}\n", "ID", "Date", "Description", "Amount", "Category", "Type");
     fmt::print("--------------------------------------------------------------------\n");
     for (size_t i = 0; i < expenses.size(); ++i) {
-        const auto& exp = expenses[i];
+        const expense_tracker::ExpenseRow exp = expenses[i];
         std::string dateStr = fmt::format("{}-{:02}-{:02}", exp.date.year, exp.date.month, exp.date.day);
         std::string typeStr = (exp.transaction_type == expense_tracker::TransactionType::CREDIT) ? "Credit" : "Cash";
         fmt::print("{:<4} | {:<10} | {:<20} | {:<10.2f} | {:<10} | {:<10}\n",
-                   i, dateStr, exp.description, exp.amount, exp.category, typeStr);
+                   exp.id, dateStr, exp.description, exp.amount, exp.category, typeStr);
     }
     fmt::print("--------------------------------------------------------------------\n");
 }
 
+// Prints a rollup total beneath a listing
+void printTotal(const expense_tracker::ExpenseTotal& total) {
+    fmt::print("Total: ${:.2f} across {} expense(s)\n", total.sum, total.count);
+}
+
 expense_tracker::Date getDateInput(const std::string& prompt) {
     std::string dateStr;
     int year = 0, month = 0, day = 0; // Initialize to invalid
@@ -72,8 +92,10 @@ expense_tracker::Date getDateInput(const std::string& prompt) {
         fmt::print(prompt);
         std::getline(std::cin, dateStr);
         if (sscanf(dateStr.c_str(), "%d-%d-%d", &year, &month, &day) == 3) {
-            // Basic validation, can be improved (e.g. using date library for validation)
-            if (year > 0 && month >= 1 && month <= 12 && day >= 1 && day <= 31) { // Simplified validation
+            // Reject dates that do not exist (2024-02-30) rather than letting them roll
+            // over, and years the four-digit ledger format cannot hold (0..9999)
+            if (expense_tracker::isValidCalendarDate(year, month, day) &&
+                expense_tracker::isStorableDate(expense_tracker::Date(year, month, day))) {
                 break;
             }
         }
@@ -84,9 +106,8 @@ expense_tracker::Date getDateInput(const std::string& prompt) {
 
 // Function to handle adding an expense
 void addExpenseUI(expense_tracker::ExpenseManager& manager) {
-    std::string description, category, dateStr, typeStr;
+    std::string description, category, typeStr;
     double amount;
-    int year, month, day;
 
     fmt::print("Enter description: ");
     std::getline(std::cin, description);
@@ -94,16 +115,7 @@ void addExpenseUI(expense_tracker::ExpenseManager& manager) {
     fmt::print("Enter amount: ");
     amount = getDoubleInput();
 
-    fmt::print("Enter date (YYYY-MM-DD): ");
-    std::getline(std::cin, dateStr);
-    // Basic parsing for YYYY-MM-DD, can be made more robust
-    // sscanf or manual parsing
-    if (sscanf(dateStr.c_str(), "%d-%d-%d", &year, &month, &day) != 3) {
-        fmt::print("Invalid date format. Expense not added.\n");
-        return; // Exit if date is bad
-    }
-    expense_tracker::Date date(year, month, day);
-
+    expense_tracker::Date date = getDateInput("Enter date (YYYY-MM-DD): ");
 
     fmt::print("Enter category: ");
     std::getline(std::cin, category);
@@ -114,30 +126,35 @@ void addExpenseUI(expense_tracker::ExpenseManager& manager) {
                                             expense_tracker::TransactionType::CREDIT :
                                             expense_tracker::TransactionType::CASH;
 
-    manager.addExpense(expense_tracker::Expense(description, amount, date, category, type));
+    if (manager.addExpense(expense_tracker::Expense(description, amount, date, category, type)) ==
+        expense_tracker::kNoExpenseId) {
+        fmt::print("Expense not added.\n");
+        return;
+    }
     fmt::print("Expense added.\n");
 }
 
 // Function to handle deleting an expense
 void deleteExpenseUI(expense_tracker::ExpenseManager& manager) {
-    manager.viewExpensesSummary(); // Show expenses with indices
+    manager.viewExpensesSummary(); // Show expenses with their IDs
     if (manager.getAllExpenses().empty()) {
         return;
     }
-    fmt::print("Enter index of expense to delete: ");
-    int index = getIntInput();
-    if (manager.deleteExpense(static_cast<size_t>(index))) {
+    fmt::print("Enter ID of expense to delete: ");
+    const expense_tracker::ExpenseId id = getIdInput();
+    if (manager.deleteExpenseById(id)) {
         fmt::print("Expense deleted.\n");
     } else {
-        fmt::print("Invalid index or expense not found.\n");
+        fmt::print("Invalid ID or expense not found.\n");
     }
 }
 
 void summarizeByDayUI(expense_tracker::ExpenseManager& manager) {
     fmt::print("--- Summarize by Day ---\n");
     expense_tracker::Date date = getDateInput("Enter date (YYYY-MM-DD): ");
-    std::vector<expense_tracker::Expense> expenses = manager.getExpensesByDay(date);
+    expense_tracker::ExpenseView expenses = manager.findExpensesByDay(date);
     printExpenses(expenses, fmt::format("--- Expenses for {} ---", fmt::format("{}-{:02}-{:02}", date.year, date.month, date.day)));
+    printTotal(manager.totalForDay(date));
 }
 
 void summarizeByMonthUI(expense_tracker::ExpenseManager& manager) {
@@ -150,16 +167,18 @@ void summarizeByMonthUI(expense_tracker::ExpenseManager& manager) {
         fmt::print("Invalid month. Aborting.\n");
         return;
     }
-    std::vector<expense_tracker::Expense> expenses = manager.getExpensesByMonth(month, year);
+    expense_tracker::ExpenseView expenses = manager.findExpensesByMonth(month, year);
     printExpenses(expenses, fmt::format("--- Expenses for {}-{:02} ---", year, month));
+    printTotal(manager.totalForMonth(month, year));
 }
 
 void summarizeByYearUI(expense_tracker::ExpenseManager& manager) {
     fmt::print("--- Summarize by Year ---\n");
     fmt::print("Enter year (YYYY): ");
     int year = getIntInput();
-    std::vector<expense_tracker::Expense> expenses = manager.getExpensesByYear(year);
+    expense_tracker::ExpenseView expenses = manager.findExpensesByYear(year);
     printExpenses(expenses, fmt::format("--- Expenses for {} ---", year));
+    printTotal(manager.totalForYear(year));
 }
 
 void summarizeByDateRangeUI(expense_tracker::ExpenseManager& manager) {
@@ -173,9 +192,26 @@ void summarizeByDateRangeUI(expense_tracker::ExpenseManager& manager) {
         fmt::print("Start date cannot be after end date. Aborting.\n");
         return;
     }
-    std::vector<expense_tracker::Expense> expenses = manager.getExpensesByDateRange(startDate, endDate);
+    expense_tracker::ExpenseView expenses = manager.findExpensesByDateRange(startDate, endDate);
     printExpenses(expenses, fmt::format("--- Expenses from {}-{:02}-{:02} to {}-{:02}-{:02} ---",
         startDate.year, startDate.month, startDate.day, endDate.year, endDate.month, endDate.day));
+    printTotal(manager.totalForDateRange(startDate, endDate));
+}
+
+void summarizeByCategoryUI(expense_tracker::ExpenseManager& manager) {
+    fmt::print("--- Totals by Category ---\n");
+    expense_tracker::Date startDate = getDateInput("Enter start date (YYYY-MM-DD): ");
+    expense_tracker::Date endDate = getDateInput("Enter end date (YYYY-MM-DD): ");
+    std::vector<expense_tracker::CategoryTotal> totals = manager.totalsByCategory(startDate, endDate);
+    if (totals.empty()) {
+        fmt::print("No expenses found.\n");
+        return;
+    }
+    fmt::print("{:<20} | {:<12} | {:<6}\n", "Category", "Total", "Count");
+    fmt::print("--------------------------------------------\n");
+    for (const auto& entry : totals) {
+        fmt::print("{:<20} | {:<12.2f} | {:<6}\n", entry.category, entry.total.sum, entry.total.count);
+    }
 }
 
 void displaySummarizationMenu() {
@@ -184,7 +220,8 @@ void displaySummarizationMenu() {
     fmt::print("2. Summarize by Month\n");
     fmt::print("3. Summarize by Year\n");
     fmt::print("4. Summarize by Date Range\n");
-    fmt::print("5. Back to Main Menu\n");
+    fmt::print("5. Totals by Category\n");
+    fmt::print("6. Back to Main Menu\n");
     fmt::print("Enter your choice: ");
 }
 
@@ -198,13 +235,37 @@ void handleSummarizationMenu(expense_tracker::ExpenseManager& manager) {
             case 2: summarizeByMonthUI(manager); break;
             case 3: summarizeByYearUI(manager); break;
             case 4: summarizeByDateRangeUI(manager); break;
-            case 5: fmt::print("Returning to main menu...\n"); break;
+            case 5: summarizeByCategoryUI(manager); break;
+            case 6: fmt::print("Returning to main menu...\n"); break;
             default: fmt::print("Invalid choice. Please try again.\n");
         }
-    } while (choice != 5);
+    } while (choice != 6);
+}
+
+// Reports background saves that have finished, from the menu thread rather
+// than the save thread, so the messages never interleave with a prompt.
+// With `wait`, blocks until every pending save is done.
+void reportSaves(std::vector<std::shared_future<bool>>& saves, const std::string& filename, bool wait) {
+    for (auto it = saves.begin(); it != saves.end();) {
+        if (!wait && it->wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            ++it;
+            continue;
+        }
+        if (it->get()) {
+            fmt::print("Expenses saved to {}\n", filename);
+        } else {
+            fmt::print("Failed to save expenses.\n");
+        }
+        it = saves.erase(it);
+    }
 }
 
-int main() {
+int main(int argc, char** argv) {
+    // Any argument (e.g. "expense_tracker --help") selects the headless batch mode.
+    if (argc > 1) {
+        return expense_tracker::runBatch(argc, argv);
+    }
+
     expense_tracker::ExpenseManager manager;
     std::string defaultFilename = "expenses.csv";
 
@@ -212,8 +273,10 @@ int main() {
     // manager.loadExpenses(defaultFilename); // This is handled in step 4, but good to note.
     // For now, user explicitly loads.
 
+    std::vector<std::shared_future<bool>> pendingSaves;
     int choice;
     do {
+        reportSaves(pendingSaves, defaultFilename, false);
         displayMenu();
         choice = getIntInput();
 
@@ -228,11 +291,10 @@ int main() {
                 deleteExpenseUI(manager);
                 break;
             case 4:
-                if (manager.saveExpenses(defaultFilename)) {
-                    fmt::print("Expenses saved to {}\n", defaultFilename);
-                } else {
-                    fmt::print("Failed to save expenses.\n");
-                }
+                // Written in the background; the menu is usable right away and
+                // the result is reported before the next menu once the file is in place.
+                fmt::print("Saving to {} in the background...\n", defaultFilename);
+                pendingSaves.push_back(manager.saveExpensesAsync(defaultFilename));
                 break;
             case 5:
                 if (manager.loadExpenses(defaultFilename)) {
@@ -245,6 +307,7 @@ int main() {
                 handleSummarizationMenu(manager); // New case
                 break;
             case 7:
+                reportSaves(pendingSaves, defaultFilename, true);
                 fmt::print("Exiting application.\n"); // Exit is now 7
                 break;
             default: